@@ -0,0 +1,520 @@
+/*
+ * bench/bench_server.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Benchmark stand-in for the CoAP server, built against the host libcoap.
+ *
+ * Unlike the stock coap-server, every resource is parameterised so one
+ * server covers all the client benchmarks:
+ *
+ *   /echo              GET: returns the query, POST/PUT/FETCH: the body
+ *   /size?n=<bytes>    GET: n bytes of a fixed pattern (block-wise)
+ *   /delay?ms=<ms>     GET: separate response after exactly ms
+ *   /observe?hz=<hz>   GET+Observe: a counter notified hz times a second
+ *   /sink              PUT/POST: accepts and discards any body
+ *
+ * It serves UDP and TCP on the given port and, with a certificate or a
+ * PSK, DTLS and TLS on port+1. OSCORE is available with -E. Timing is
+ * kept deterministic so runs can be compared between commits: payloads
+ * are fixed patterns, retransmissions use an ACK_RANDOM_FACTOR of 1.0,
+ * notifications follow an absolute schedule that does not drift, and
+ * nothing is logged per request unless asked for with -v.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <coap3/coap.h>
+
+/* Largest body served by /size */
+#define SIZE_MAX_BYTES (1024 * 1024)
+/* Fastest notification rate of /observe */
+#define OBSERVE_MAX_HZ 1000
+/* Longest delay accepted by /delay */
+#define DELAY_MAX_MS 60000
+
+enum bench_resource {
+    RES_ECHO,
+    RES_SIZE,
+    RES_DELAY,
+    RES_OBSERVE,
+    RES_SINK,
+    RES_COUNT,
+};
+
+static const char *const resource_names[RES_COUNT] = {
+    "echo", "size", "delay", "observe", "sink",
+};
+
+static uint8_t pattern[SIZE_MAX_BYTES];
+static uint64_t requests[RES_COUNT];
+static uint64_t bytes_out;
+static uint64_t bytes_sunk;
+static uint64_t sessions;
+
+static coap_resource_t *observe_resource;
+static uint32_t observe_period_ms;
+static uint64_t observe_counter;
+
+static volatile sig_atomic_t quit;
+
+static void handle_sigint(int signum) {
+    (void)signum;
+    quit = 1;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Value of name=<number> in the query, or def when missing or invalid */
+static long query_value(const coap_string_t *query, const char *name,
+                        long def) {
+    size_t name_len = strlen(name);
+    const char *p, *end;
+
+    if (!query) {
+        return def;
+    }
+    p = (const char *)query->s;
+    end = p + query->length;
+
+    while (p < end) {
+        const char *amp = memchr(p, '&', end - p);
+        const char *item_end = amp ? amp : end;
+
+        if ((size_t)(item_end - p) > name_len && !memcmp(p, name, name_len) &&
+            p[name_len] == '=') {
+            char buf[24];
+            size_t len = item_end - p - name_len - 1;
+            char *num_end;
+            long v;
+
+            if (len == 0 || len >= sizeof(buf)) {
+                return def;
+            }
+            memcpy(buf, p + name_len + 1, len);
+            buf[len] = '\0';
+            v = strtol(buf, &num_end, 10);
+            return *num_end || v < 0 ? def : v;
+        }
+        p = item_end + 1;
+    }
+    return def;
+}
+
+static void release_copy(coap_session_t *session, void *app_ptr) {
+    (void)session;
+    free(app_ptr);
+}
+
+static void hnd_echo(coap_resource_t *resource, coap_session_t *session,
+                     const coap_pdu_t *request, const coap_string_t *query,
+                     coap_pdu_t *response) {
+    const uint8_t *data = NULL;
+    size_t len = 0, offset, total;
+    uint8_t *copy;
+
+    requests[RES_ECHO]++;
+    if (coap_pdu_get_code(request) == COAP_REQUEST_CODE_GET) {
+        if (query) {
+            data = query->s;
+            len = query->length;
+        }
+    } else {
+        coap_get_data_large(request, &len, &data, &offset, &total);
+    }
+
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CONTENT);
+    if (!len) {
+        return;
+    }
+    /* The transfer may outlive the request, so it gets its own copy */
+    copy = malloc(len);
+    if (!copy) {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_INTERNAL_ERROR);
+        return;
+    }
+    memcpy(copy, data, len);
+    bytes_out += len;
+    coap_add_data_large_response(resource, session, request, response, query,
+                                 COAP_MEDIATYPE_APPLICATION_OCTET_STREAM, -1,
+                                 0, len, copy, release_copy, copy);
+}
+
+static void hnd_size(coap_resource_t *resource, coap_session_t *session,
+                     const coap_pdu_t *request, const coap_string_t *query,
+                     coap_pdu_t *response) {
+    long n = query_value(query, "n", -1);
+
+    requests[RES_SIZE]++;
+    if (n < 0 || n > SIZE_MAX_BYTES) {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_BAD_REQUEST);
+        return;
+    }
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CONTENT);
+    bytes_out += n;
+    /* Same query, same body: the ETag stays stable across requests */
+    coap_add_data_large_response(resource, session, request, response, query,
+                                 COAP_MEDIATYPE_APPLICATION_OCTET_STREAM, -1,
+                                 0, n, pattern, NULL, NULL);
+}
+
+static void hnd_delay(coap_resource_t *resource, coap_session_t *session,
+                      const coap_pdu_t *request, const coap_string_t *query,
+                      coap_pdu_t *response) {
+    long ms = query_value(query, "ms", -1);
+    coap_async_t *async;
+    char buf[24];
+    int len;
+
+    (void)resource;
+    if (ms < 0 || ms > DELAY_MAX_MS) {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_BAD_REQUEST);
+        return;
+    }
+
+    async = coap_find_async(session, coap_pdu_get_token(request));
+    if (!async) {
+        requests[RES_DELAY]++;
+        if (ms > 0) {
+            /* Empty ACK now, handler called again once the delay is over */
+            async = coap_register_async(session, request,
+                                        (coap_tick_t)ms *
+                                            COAP_TICKS_PER_SECOND / 1000);
+            if (!async) {
+                coap_pdu_set_code(response,
+                                  COAP_RESPONSE_CODE_SERVICE_UNAVAILABLE);
+            }
+            return;
+        }
+    }
+
+    len = snprintf(buf, sizeof(buf), "%ld", ms);
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CONTENT);
+    coap_add_data(response, len, (const uint8_t *)buf);
+    bytes_out += len;
+}
+
+static void hnd_observe(coap_resource_t *resource, coap_session_t *session,
+                        const coap_pdu_t *request, const coap_string_t *query,
+                        coap_pdu_t *response) {
+    long hz = query_value(query, "hz", 1);
+    coap_opt_iterator_t opt_iter;
+    char buf[24];
+    int len;
+
+    (void)resource;
+    (void)session;
+    requests[RES_OBSERVE]++;
+
+    /* A new registration sets the rate for all observers */
+    if (coap_check_option(request, COAP_OPTION_OBSERVE, &opt_iter) &&
+        hz > 0) {
+        observe_period_ms = 1000 / (hz > OBSERVE_MAX_HZ ? OBSERVE_MAX_HZ : hz);
+    }
+
+    len = snprintf(buf, sizeof(buf), "%llu", (unsigned long long)observe_counter);
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CONTENT);
+    coap_add_data(response, len, (const uint8_t *)buf);
+    bytes_out += len;
+}
+
+static void hnd_sink(coap_resource_t *resource, coap_session_t *session,
+                     const coap_pdu_t *request, const coap_string_t *query,
+                     coap_pdu_t *response) {
+    const uint8_t *data;
+    size_t len, offset, total;
+
+    (void)resource;
+    (void)session;
+    (void)query;
+    requests[RES_SINK]++;
+    if (coap_get_data_large(request, &len, &data, &offset, &total)) {
+        bytes_sunk += len;
+    }
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CHANGED);
+}
+
+static int event_handler(coap_session_t *session, const coap_event_t event) {
+    if (event == COAP_EVENT_SERVER_SESSION_NEW) {
+        /* Retransmit at exactly ACK_TIMEOUT, 2 x ACK_TIMEOUT, ... */
+        coap_fixed_point_t one = {1, 0};
+
+        coap_session_set_ack_random_factor(session, one);
+        sessions++;
+    }
+    return 0;
+}
+
+static void add_resources(coap_context_t *ctx) {
+    coap_resource_t *r;
+
+    r = coap_resource_init(coap_make_str_const("echo"), 0);
+    coap_register_request_handler(r, COAP_REQUEST_GET, hnd_echo);
+    coap_register_request_handler(r, COAP_REQUEST_POST, hnd_echo);
+    coap_register_request_handler(r, COAP_REQUEST_PUT, hnd_echo);
+    coap_register_request_handler(r, COAP_REQUEST_FETCH, hnd_echo);
+    coap_add_resource(ctx, r);
+
+    r = coap_resource_init(coap_make_str_const("size"), 0);
+    coap_register_request_handler(r, COAP_REQUEST_GET, hnd_size);
+    coap_add_resource(ctx, r);
+
+    r = coap_resource_init(coap_make_str_const("delay"), 0);
+    coap_register_request_handler(r, COAP_REQUEST_GET, hnd_delay);
+    coap_add_resource(ctx, r);
+
+    r = coap_resource_init(coap_make_str_const("observe"),
+                           COAP_RESOURCE_FLAGS_NOTIFY_NON);
+    coap_register_request_handler(r, COAP_REQUEST_GET, hnd_observe);
+    coap_resource_set_get_observable(r, 1);
+    coap_add_resource(ctx, r);
+    observe_resource = r;
+
+    r = coap_resource_init(coap_make_str_const("sink"), 0);
+    coap_register_request_handler(r, COAP_REQUEST_PUT, hnd_sink);
+    coap_register_request_handler(r, COAP_REQUEST_POST, hnd_sink);
+    coap_add_resource(ctx, r);
+}
+
+static int add_endpoint(coap_context_t *ctx, const char *host, uint16_t port,
+                        coap_proto_t proto, const char *name) {
+    coap_address_t addr;
+
+    coap_address_init(&addr);
+    if (strchr(host, ':')) {
+        addr.addr.sin6.sin6_family = AF_INET6;
+        addr.size = sizeof(addr.addr.sin6);
+        if (inet_pton(AF_INET6, host, &addr.addr.sin6.sin6_addr) != 1) {
+            return 0;
+        }
+    } else {
+        addr.addr.sin.sin_family = AF_INET;
+        addr.size = sizeof(addr.addr.sin);
+        if (inet_pton(AF_INET, host, &addr.addr.sin.sin_addr) != 1) {
+            return 0;
+        }
+    }
+    coap_address_set_port(&addr, port);
+
+    if (!coap_new_endpoint(ctx, &addr, proto)) {
+        fprintf(stderr, "Cannot listen on %s %s:%u\n", name, host, port);
+        return 0;
+    }
+    printf("Listening on %s %s:%u\n", name, host, port);
+    return 1;
+}
+
+static int setup_security(coap_context_t *ctx, const char *cert,
+                          const char *key, const char *psk) {
+    if (cert && key) {
+        static coap_dtls_pki_t pki;
+
+        memset(&pki, 0, sizeof(pki));
+        pki.version = COAP_DTLS_PKI_SETUP_VERSION;
+        /* Benchmark clients use self-signed or no certificates */
+        pki.verify_peer_cert = 0;
+        pki.allow_self_signed = 1;
+        pki.allow_expired_certs = 1;
+        pki.pki_key.key_type = COAP_PKI_KEY_PEM;
+        pki.pki_key.key.pem.public_cert = cert;
+        pki.pki_key.key.pem.private_key = key;
+        return coap_context_set_pki(ctx, &pki);
+    }
+    if (psk) {
+        static coap_dtls_spsk_t spsk;
+
+        memset(&spsk, 0, sizeof(spsk));
+        spsk.version = COAP_DTLS_SPSK_SETUP_VERSION;
+        spsk.psk_info.hint.s = (const uint8_t *)"bench";
+        spsk.psk_info.hint.length = 5;
+        spsk.psk_info.key.s = (const uint8_t *)psk;
+        spsk.psk_info.key.length = strlen(psk);
+        return coap_context_set_psk2(ctx, &spsk);
+    }
+    return 0;
+}
+
+static int setup_oscore(coap_context_t *ctx, const char *conf_file) {
+    static uint8_t conf_buf[4096];
+    coap_oscore_conf_t *conf;
+    coap_str_const_t conf_mem;
+    FILE *f;
+    size_t len;
+
+    if (!coap_oscore_is_supported()) {
+        fprintf(stderr, "libcoap was built without OSCORE\n");
+        return 0;
+    }
+    f = fopen(conf_file, "r");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s: %s\n", conf_file, strerror(errno));
+        return 0;
+    }
+    len = fread(conf_buf, 1, sizeof(conf_buf), f);
+    fclose(f);
+
+    conf_mem.s = conf_buf;
+    conf_mem.length = len;
+    conf = coap_new_oscore_conf(conf_mem, NULL, NULL, 0);
+    return conf && coap_context_oscore_server(ctx, conf);
+}
+
+static void report(void) {
+    printf("\n=== BENCH SERVER ===\n");
+    printf("Sessions: %llu\n", (unsigned long long)sessions);
+    for (int i = 0; i < RES_COUNT; i++) {
+        printf("/%-8s %llu requests\n", resource_names[i],
+               (unsigned long long)requests[i]);
+    }
+    printf("Bytes served: %llu, sunk: %llu\n", (unsigned long long)bytes_out,
+           (unsigned long long)bytes_sunk);
+    printf("=== END BENCH SERVER ===\n");
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("\n");
+    printf("  -A <addr>     Listen address (default: 0.0.0.0)\n");
+    printf("  -p <port>     UDP/TCP port, DTLS/TLS on port+1 (default: 5683)\n");
+    printf("  -c <file>     Server certificate (PEM) for DTLS/TLS\n");
+    printf("  -j <file>     Server private key (PEM) for DTLS/TLS\n");
+    printf("  -k <key>      Pre-shared key for DTLS/TLS (hint \"bench\")\n");
+    printf("  -n            Do not verify client certificates (always the case)\n");
+    printf("  -E <file>     OSCORE configuration (libcoap format)\n");
+    printf("  -N            No TCP/TLS endpoints\n");
+    printf("  -v <level>    libcoap log level (default: 3, errors only)\n");
+}
+
+int main(int argc, char **argv) {
+    const char *host = "0.0.0.0";
+    const char *cert = NULL, *key = NULL, *psk = NULL, *oscore = NULL;
+    uint16_t port = COAP_DEFAULT_PORT;
+    int use_tcp = 1;
+    int log_level = COAP_LOG_ERR;
+    coap_context_t *ctx;
+    uint64_t next_notify = 0;
+    int secure;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "A:p:c:j:k:nE:Nv:h")) != -1) {
+        switch (opt) {
+        case 'A':
+            host = optarg;
+            break;
+        case 'p':
+            port = (uint16_t)atoi(optarg);
+            break;
+        case 'c':
+            cert = optarg;
+            break;
+        case 'j':
+            key = optarg;
+            break;
+        case 'k':
+            psk = optarg;
+            break;
+        case 'n':
+            break;
+        case 'E':
+            oscore = optarg;
+            break;
+        case 'N':
+            use_tcp = 0;
+            break;
+        case 'v':
+            log_level = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = 'a' + i % 26;
+    }
+
+    coap_startup();
+    coap_set_log_level(log_level);
+
+    ctx = coap_new_context(NULL);
+    if (!ctx) {
+        fprintf(stderr, "Cannot create libcoap context\n");
+        return EXIT_FAILURE;
+    }
+    coap_context_set_block_mode(ctx, COAP_BLOCK_USE_LIBCOAP |
+                                         COAP_BLOCK_SINGLE_BODY);
+    coap_register_event_handler(ctx, event_handler);
+    add_resources(ctx);
+
+    secure = setup_security(ctx, cert, key, psk);
+    if (oscore && !setup_oscore(ctx, oscore)) {
+        fprintf(stderr, "Invalid OSCORE configuration %s\n", oscore);
+        goto fail;
+    }
+
+    if (!add_endpoint(ctx, host, port, COAP_PROTO_UDP, "UDP")) {
+        goto fail;
+    }
+    if (secure && coap_dtls_is_supported()) {
+        add_endpoint(ctx, host, port + 1, COAP_PROTO_DTLS, "DTLS");
+    }
+    if (use_tcp && coap_tcp_is_supported()) {
+        add_endpoint(ctx, host, port, COAP_PROTO_TCP, "TCP");
+        if (secure && coap_tls_is_supported()) {
+            add_endpoint(ctx, host, port + 1, COAP_PROTO_TLS, "TLS");
+        }
+    }
+    if (oscore) {
+        printf("OSCORE enabled (%s)\n", oscore);
+    }
+
+    signal(SIGINT, handle_sigint);
+    signal(SIGTERM, handle_sigint);
+
+    while (!quit) {
+        uint64_t now = now_ms();
+        uint32_t timeout = 1000;
+
+        if (observe_period_ms) {
+            if (!next_notify) {
+                next_notify = now + observe_period_ms;
+            }
+            if (now >= next_notify) {
+                observe_counter++;
+                coap_resource_notify_observers(observe_resource, NULL);
+                /* Absolute schedule, unless we fell a whole period behind */
+                next_notify += observe_period_ms;
+                if (next_notify <= now) {
+                    next_notify = now + observe_period_ms;
+                }
+            }
+            timeout = (uint32_t)(next_notify > now ? next_notify - now : 1);
+        }
+
+        if (coap_io_process(ctx, timeout) < 0) {
+            break;
+        }
+    }
+
+    report();
+    coap_free_context(ctx);
+    coap_cleanup();
+    return EXIT_SUCCESS;
+
+fail:
+    coap_free_context(ctx);
+    coap_cleanup();
+    return EXIT_FAILURE;
+}
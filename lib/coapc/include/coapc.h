@@ -0,0 +1,92 @@
+/*
+ * lib/coapc/include/coapc.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Asynchronous CoAP client library.
+ *
+ * Requests are submitted from any thread and completed by the library's
+ * own thread, which owns the libcoap context and is the only one that
+ * touches the network. Submitting never blocks: the request is pushed
+ * onto a lock-free MPSC queue and the thread is woken through an
+ * eventfd. Completion is reported through a callback, a k_poll signal,
+ * or both.
+ */
+
+#ifndef COAPC_H
+#define COAPC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/mpsc_lockfree.h>
+#include <zephyr/sys/slist.h>
+#include <coap3/coap.h>
+
+struct coapc_request;
+
+/* Called from the library thread once the request is complete; it must
+ * not block, as no other request makes progress meanwhile */
+typedef void (*coapc_done_t)(struct coapc_request *req);
+/* Payload produced when the request is sent rather than when it is
+ * submitted: fill at most size bytes of buf and return the length, or
+ * a negative errno to fail the request */
+typedef int (*coapc_payload_t)(struct coapc_request *req, uint8_t *buf,
+                               size_t size);
+
+struct coapc_request {
+    /* Set by the caller. The request, the URI and the buffers must stay
+     * valid until it completes. */
+    const char *uri;             /* coap[s][+tcp]://<IPv4>[:port]/path?query */
+    coap_pdu_code_t method;      /* 0 is GET */
+    bool has_content_format;     /* 0 (text/plain) is a format too */
+    uint16_t content_format;     /* Of the payload, if has_content_format */
+    const uint8_t *payload;      /* Payload from a buffer... */
+    size_t payload_len;
+    coapc_payload_t payload_fn;  /* ...or from the callback, if set */
+    uint32_t timeout_ms;         /* 0 is CONFIG_COAPC_DEFAULT_TIMEOUT_MS */
+    uint8_t priority;            /* 0 is the most urgent */
+    uint8_t *response;           /* Response body, truncated to fit */
+    size_t response_size;
+    coapc_done_t done;
+    struct k_poll_signal *signal; /* Raised with status as the result */
+    void *user_data;
+
+    /* Set on completion */
+    int status;                  /* 0, or a negative errno */
+    coap_pdu_code_t code;        /* Response code, 0 without a response */
+    size_t response_len;         /* Body bytes stored in response */
+    size_t response_total;       /* Whole body, more than response_size
+                                  * when truncated */
+
+    /* Library state */
+    atomic_t state;
+    struct mpsc_node node;
+    sys_snode_t pending;
+    int64_t deadline_ms;
+};
+
+/* Start the library thread with its own libcoap context. pki is used
+ * for coaps:// and coaps+tcp:// sessions; NULL accepts any server
+ * certificate, as the rest of this client does. */
+int coapc_init(const coap_dtls_pki_t *pki);
+
+/* Queue a request; any thread, never blocks on I/O. Returns -EBUSY if
+ * the request is still in progress, -EINVAL without a URI. Errors found
+ * later (bad URI, no session, timeout) complete the request with a
+ * negative status. */
+int coapc_submit(struct coapc_request *req);
+
+/* Complete every request not yet answered with -ECANCELED, close the
+ * sessions and end the thread; before coap_cleanup(). No submission may
+ * race with it. */
+void coapc_stop(void);
+
+/* Whether the request has completed, for callers that poll. It turns
+ * true only after the callback has returned and the signal is raised,
+ * so a thread they wake may still see it false for a moment. */
+bool coapc_done(const struct coapc_request *req);
+
+#endif /* COAPC_H */
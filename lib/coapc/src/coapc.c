@@ -0,0 +1,585 @@
+/*
+ * lib/coapc/src/coapc.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Asynchronous CoAP client library.
+ *
+ * One thread owns the libcoap context. Submitters push their requests
+ * onto a lock-free MPSC queue and write the eventfd that the thread
+ * waits on next to libcoap's sockets, so coapc_submit() costs a couple
+ * of atomics and never waits for the thread. The thread moves the queue
+ * into a list sorted by priority, starts requests while a slot is free,
+ * and completes each one on its response, its NACK or its deadline.
+ * Sessions are kept per server and transport and reused; one without
+ * requests in flight is closed when another server needs its entry.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/posix/sys/eventfd.h>
+#include <zephyr/posix/sys/select.h>
+#include <zephyr/posix/unistd.h>
+#include <coapc.h>
+
+LOG_MODULE_REGISTER(coapc, CONFIG_COAPC_LOG_LEVEL);
+
+enum {
+    COAPC_IDLE,    /* Never submitted */
+    COAPC_QUEUED,  /* Submitted, owned by the library thread */
+    COAPC_DONE,
+};
+
+/* Longest wait in the I/O loop without a deadline to wake up for */
+#define COAPC_IDLE_WAIT_MS 1000
+
+struct coapc_session {
+    coap_session_t *session;
+    coap_address_t addr;
+    coap_proto_t proto;
+    int inflight;
+    int failed;      /* Closed or failed; released once it is unused */
+    int64_t used_ms;
+};
+
+struct coapc_slot {
+    struct coapc_request *req;
+    struct coapc_session *entry;
+    uint8_t token[8];
+    size_t token_len;
+    int data_busy;   /* libcoap may still send blocks of payload */
+    uint8_t payload[CONFIG_COAPC_PAYLOAD_MAX];
+};
+
+static coap_context_t *ctx;
+static coap_dtls_pki_t pki_setup;
+static struct mpsc queue;
+static sys_slist_t pending;
+static int wake_fd = -1;
+static atomic_t running;
+
+static struct coapc_session sessions[CONFIG_COAPC_SESSIONS];
+static struct coapc_slot slots[CONFIG_COAPC_MAX_INFLIGHT];
+
+K_THREAD_STACK_DEFINE(coapc_stack, CONFIG_COAPC_THREAD_STACK_SIZE);
+static struct k_thread coapc_thread;
+
+static void complete(struct coapc_request *req, int status) {
+    coapc_done_t done = req->done;
+    struct k_poll_signal *signal = req->signal;
+
+    req->status = status;
+    if (done) {
+        done(req);
+    }
+    if (signal) {
+        k_poll_signal_raise(signal, status);
+    }
+    /* Last: the caller may reuse the request as soon as the state says so */
+    atomic_set(&req->state, COAPC_DONE);
+}
+
+static void finish(struct coapc_slot *slot, int status) {
+    struct coapc_request *req = slot->req;
+
+    slot->req = NULL;
+    slot->entry->inflight--;
+    slot->entry->used_ms = k_uptime_get();
+    complete(req, status);
+}
+
+/* Tokens are only unique per session, so the session has to match too */
+static struct coapc_slot *slot_of(const coap_session_t *session,
+                                  coap_bin_const_t token) {
+    for (int i = 0; i < CONFIG_COAPC_MAX_INFLIGHT; i++) {
+        struct coapc_slot *slot = &slots[i];
+
+        if (slot->req && slot->entry->session == session &&
+            slot->token_len == token.length &&
+            memcmp(slot->token, token.s, token.length) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static struct coapc_slot *free_slot(void) {
+    for (int i = 0; i < CONFIG_COAPC_MAX_INFLIGHT; i++) {
+        if (!slots[i].req && !slots[i].data_busy) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+static coap_response_t response_handler(coap_session_t *session,
+                                        const coap_pdu_t *sent,
+                                        const coap_pdu_t *received,
+                                        const coap_mid_t mid) {
+    struct coapc_slot *slot = slot_of(session, coap_pdu_get_token(received));
+    struct coapc_request *req;
+    const uint8_t *data;
+    size_t len;
+    size_t offset;
+    size_t total;
+
+    (void)sent;
+    (void)mid;
+
+    if (!slot) {
+        /* A late answer to a request that has timed out */
+        return COAP_RESPONSE_OK;
+    }
+    req = slot->req;
+    req->code = coap_pdu_get_code(received);
+    if (coap_get_data_large(received, &len, &data, &offset, &total)) {
+        req->response_total = total;
+        if (req->response && offset < req->response_size) {
+            len = MIN(len, req->response_size - offset);
+            memcpy(req->response + offset, data, len);
+            req->response_len = offset + len;
+        }
+    }
+    finish(slot, 0);
+    return COAP_RESPONSE_OK;
+}
+
+static void nack_handler(coap_session_t *session, const coap_pdu_t *sent,
+                         const coap_nack_reason_t reason,
+                         const coap_mid_t mid) {
+    struct coapc_slot *slot;
+    int status;
+
+    (void)mid;
+
+    slot = sent ? slot_of(session, coap_pdu_get_token(sent)) : NULL;
+    if (!slot) {
+        return;
+    }
+    switch (reason) {
+    case COAP_NACK_TOO_MANY_RETRIES:
+        status = -ETIMEDOUT;
+        break;
+    case COAP_NACK_RST:
+        status = -ECONNRESET;
+        break;
+    case COAP_NACK_TLS_FAILED:
+        status = -ECONNREFUSED;
+        break;
+    default:
+        status = -EIO;
+        break;
+    }
+    finish(slot, status);
+}
+
+static int event_handler(coap_session_t *session, const coap_event_t event) {
+    switch (event) {
+    case COAP_EVENT_DTLS_CLOSED:
+    case COAP_EVENT_DTLS_ERROR:
+    case COAP_EVENT_TCP_CLOSED:
+    case COAP_EVENT_TCP_FAILED:
+    case COAP_EVENT_SESSION_CLOSED:
+    case COAP_EVENT_SESSION_FAILED:
+        for (int i = 0; i < CONFIG_COAPC_SESSIONS; i++) {
+            if (sessions[i].session == session) {
+                sessions[i].failed = 1;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static void release_payload(coap_session_t *session, void *app_ptr) {
+    (void)session;
+
+    ((struct coapc_slot *)app_ptr)->data_busy = 0;
+}
+
+static void close_entry(struct coapc_session *entry) {
+    coap_session_release(entry->session);
+    entry->session = NULL;
+    entry->failed = 0;
+}
+
+/* The session to dst, opened if needed. -EAGAIN while every entry has
+ * requests in flight: the request waits for one to complete. */
+static int session_for(const coap_address_t *dst, coap_proto_t proto,
+                       struct coapc_session **out) {
+    struct coapc_session *unused = NULL;
+    struct coapc_session *idle = NULL;
+    struct coapc_session *entry;
+
+    for (int i = 0; i < CONFIG_COAPC_SESSIONS; i++) {
+        entry = &sessions[i];
+        if (!entry->session) {
+            unused = unused ? unused : entry;
+        } else if (entry->inflight == 0 &&
+                   (entry->failed || !idle ||
+                    entry->used_ms < idle->used_ms)) {
+            idle = entry;
+        }
+        if (entry->session && !entry->failed && entry->proto == proto &&
+            coap_address_equals(&entry->addr, dst)) {
+            *out = entry;
+            return 0;
+        }
+    }
+
+    entry = unused;
+    if (!entry && idle) {
+        /* Least recently used */
+        close_entry(idle);
+        entry = idle;
+    }
+    if (!entry) {
+        return -EAGAIN;
+    }
+
+    if (proto == COAP_PROTO_DTLS || proto == COAP_PROTO_TLS) {
+        entry->session = coap_new_client_session_pki(ctx, NULL, dst, proto,
+                                                     &pki_setup);
+    } else {
+        entry->session = coap_new_client_session(ctx, NULL, dst, proto);
+    }
+    if (!entry->session) {
+        return -ENOTCONN;
+    }
+    coap_address_copy(&entry->addr, dst);
+    entry->proto = proto;
+    entry->inflight = 0;
+    entry->failed = 0;
+    *out = entry;
+    return 0;
+}
+
+static coap_proto_t proto_of(coap_uri_scheme_t scheme) {
+    switch (scheme) {
+    case COAP_URI_SCHEME_COAPS:
+        return COAP_PROTO_DTLS;
+    case COAP_URI_SCHEME_COAP_TCP:
+        return COAP_PROTO_TCP;
+    case COAP_URI_SCHEME_COAPS_TCP:
+        return COAP_PROTO_TLS;
+    default:
+        return COAP_PROTO_UDP;
+    }
+}
+
+static int start(struct coapc_slot *slot, struct coapc_request *req) {
+    struct coapc_session *entry;
+    coap_optlist_t *optlist = NULL;
+    coap_address_t dst;
+    coap_uri_t uri;
+    coap_pdu_t *pdu;
+    uint8_t scratch[64];
+    uint8_t format[4];
+    char host[INET_ADDRSTRLEN];
+    int len;
+    int ret;
+
+    if (coap_split_uri((const uint8_t *)req->uri, strlen(req->uri),
+                       &uri) != 0 ||
+        uri.host.length >= sizeof(host)) {
+        return -EINVAL;
+    }
+    memcpy(host, uri.host.s, uri.host.length);
+    host[uri.host.length] = '\0';
+    coap_address_init(&dst);
+    dst.addr.sin.sin_family = AF_INET;
+    dst.addr.sin.sin_port = htons(uri.port);
+    dst.size = sizeof(struct sockaddr_in);
+    if (inet_pton(AF_INET, host, &dst.addr.sin.sin_addr) != 1) {
+        /* No resolver on this thread: it would block every request */
+        return -EINVAL;
+    }
+
+    ret = session_for(&dst, proto_of(uri.scheme), &entry);
+    if (ret) {
+        return ret;
+    }
+
+    pdu = coap_new_pdu(COAP_MESSAGE_CON,
+                       req->method ? req->method : COAP_REQUEST_CODE_GET,
+                       entry->session);
+    if (!pdu) {
+        return -ENOMEM;
+    }
+    coap_session_new_token(entry->session, &slot->token_len, slot->token);
+    coap_add_token(pdu, slot->token_len, slot->token);
+
+    if (coap_uri_into_options(&uri, &dst, &optlist, 1, scratch,
+                              sizeof(scratch)) != 0) {
+        coap_delete_pdu(pdu);
+        return -EINVAL;
+    }
+    if (req->has_content_format) {
+        coap_insert_optlist(&optlist,
+                            coap_new_optlist(COAP_OPTION_CONTENT_FORMAT,
+                                             coap_encode_var_safe(
+                                                 format, sizeof(format),
+                                                 req->content_format),
+                                             format));
+    }
+    if (optlist && coap_add_optlist_pdu(pdu, &optlist) != 1) {
+        coap_delete_optlist(optlist);
+        coap_delete_pdu(pdu);
+        return -ENOMEM;
+    }
+    coap_delete_optlist(optlist);
+
+    if (req->payload_fn) {
+        len = req->payload_fn(req, slot->payload, sizeof(slot->payload));
+    } else if (req->payload_len <= sizeof(slot->payload)) {
+        len = (int)req->payload_len;
+        if (len > 0) {
+            memcpy(slot->payload, req->payload, len);
+        }
+    } else {
+        len = -EMSGSIZE;
+    }
+    if (len < 0) {
+        coap_delete_pdu(pdu);
+        return len;
+    }
+    if (len > 0) {
+        /* The slot stays taken until libcoap has sent the last block */
+        slot->data_busy = 1;
+        if (!coap_add_data_large_request(entry->session, pdu, len,
+                                         slot->payload, release_payload,
+                                         slot)) {
+            coap_delete_pdu(pdu);
+            return -ENOMEM;
+        }
+    }
+
+    slot->req = req;
+    slot->entry = entry;
+    entry->inflight++;
+    entry->used_ms = k_uptime_get();
+    if (coap_send(entry->session, pdu) == COAP_INVALID_MID) {
+        slot->req = NULL;
+        entry->inflight--;
+        return -EIO;
+    }
+    return 0;
+}
+
+/* After requests of the same priority already waiting */
+static void enqueue(struct coapc_request *req) {
+    struct coapc_request *it;
+    sys_snode_t *prev = NULL;
+
+    SYS_SLIST_FOR_EACH_CONTAINER(&pending, it, pending) {
+        if (it->priority > req->priority) {
+            break;
+        }
+        prev = &it->pending;
+    }
+    if (prev) {
+        sys_slist_insert(&pending, prev, &req->pending);
+    } else {
+        sys_slist_prepend(&pending, &req->pending);
+    }
+}
+
+static void drain(void) {
+    struct mpsc_node *node;
+
+    while ((node = mpsc_pop(&queue)) != NULL) {
+        struct coapc_request *req =
+            CONTAINER_OF(node, struct coapc_request, node);
+
+        req->deadline_ms = k_uptime_get() +
+                           (req->timeout_ms ? req->timeout_ms
+                                            : CONFIG_COAPC_DEFAULT_TIMEOUT_MS);
+        enqueue(req);
+    }
+}
+
+static void dispatch(void) {
+    struct coapc_request *req;
+    struct coapc_slot *slot;
+    int ret;
+
+    while (!sys_slist_is_empty(&pending) && (slot = free_slot()) != NULL) {
+        req = SYS_SLIST_PEEK_HEAD_CONTAINER(&pending, req, pending);
+        ret = start(slot, req);
+        if (ret == -EAGAIN) {
+            /* Retried once a session has nothing in flight */
+            break;
+        }
+        sys_slist_get(&pending);
+        if (ret) {
+            LOG_DBG("%s: %d", req->uri, ret);
+            complete(req, ret);
+        }
+    }
+}
+
+static void expire(void) {
+    struct coapc_request *req;
+    struct coapc_request *next;
+    int64_t now = k_uptime_get();
+
+    for (int i = 0; i < CONFIG_COAPC_MAX_INFLIGHT; i++) {
+        if (slots[i].req && now >= slots[i].req->deadline_ms) {
+            finish(&slots[i], -ETIMEDOUT);
+        }
+    }
+    SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&pending, req, next, pending) {
+        if (now >= req->deadline_ms) {
+            sys_slist_find_and_remove(&pending, &req->pending);
+            complete(req, -ETIMEDOUT);
+        }
+    }
+    for (int i = 0; i < CONFIG_COAPC_SESSIONS; i++) {
+        if (sessions[i].session && sessions[i].failed &&
+            sessions[i].inflight == 0) {
+            close_entry(&sessions[i]);
+        }
+    }
+}
+
+/* Until the nearest deadline; libcoap shortens it for its own timers */
+static uint32_t wait_ms(void) {
+    struct coapc_request *req;
+    int64_t now = k_uptime_get();
+    int64_t next = now + COAPC_IDLE_WAIT_MS;
+
+    for (int i = 0; i < CONFIG_COAPC_MAX_INFLIGHT; i++) {
+        if (slots[i].req) {
+            next = MIN(next, slots[i].req->deadline_ms);
+        }
+    }
+    SYS_SLIST_FOR_EACH_CONTAINER(&pending, req, pending) {
+        next = MIN(next, req->deadline_ms);
+    }
+    /* A timeout of 0 would wait for traffic with no limit */
+    return (uint32_t)MAX(next - now, 1);
+}
+
+static void run(void *p1, void *p2, void *p3) {
+    fd_set readfds;
+    eventfd_t value;
+
+    (void)p1;
+    (void)p2;
+    (void)p3;
+
+    while (atomic_get(&running)) {
+        drain();
+        dispatch();
+        FD_ZERO(&readfds);
+        FD_SET(wake_fd, &readfds);
+        coap_io_process_with_fds(ctx, wait_ms(), wake_fd + 1, &readfds, NULL,
+                                 NULL);
+        if (FD_ISSET(wake_fd, &readfds)) {
+            eventfd_read(wake_fd, &value);
+        }
+        expire();
+    }
+
+    drain();
+    for (int i = 0; i < CONFIG_COAPC_MAX_INFLIGHT; i++) {
+        if (slots[i].req) {
+            finish(&slots[i], -ECANCELED);
+        }
+    }
+    while (!sys_slist_is_empty(&pending)) {
+        complete(CONTAINER_OF(sys_slist_get(&pending), struct coapc_request,
+                              pending),
+                 -ECANCELED);
+    }
+    for (int i = 0; i < CONFIG_COAPC_SESSIONS; i++) {
+        if (sessions[i].session) {
+            close_entry(&sessions[i]);
+        }
+    }
+    coap_free_context(ctx);
+    ctx = NULL;
+}
+
+int coapc_init(const coap_dtls_pki_t *pki) {
+    if (atomic_get(&running)) {
+        return -EALREADY;
+    }
+    coap_startup();
+
+    if (pki) {
+        pki_setup = *pki;
+    } else {
+        memset(&pki_setup, 0, sizeof(pki_setup));
+        pki_setup.version = COAP_DTLS_PKI_SETUP_VERSION;
+        pki_setup.verify_peer_cert = 0;
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (wake_fd < 0) {
+        LOG_ERR("Cannot create the wakeup eventfd: %d", errno);
+        return -errno;
+    }
+    ctx = coap_new_context(NULL);
+    if (!ctx) {
+        close(wake_fd);
+        wake_fd = -1;
+        return -ENOMEM;
+    }
+    coap_context_set_block_mode(ctx, COAP_BLOCK_USE_LIBCOAP |
+                                         COAP_BLOCK_SINGLE_BODY);
+    coap_register_response_handler(ctx, response_handler);
+    coap_register_nack_handler(ctx, nack_handler);
+    coap_register_event_handler(ctx, event_handler);
+
+    mpsc_init(&queue);
+    sys_slist_init(&pending);
+    atomic_set(&running, 1);
+
+    k_thread_create(&coapc_thread, coapc_stack,
+                    K_THREAD_STACK_SIZEOF(coapc_stack), run, NULL, NULL, NULL,
+                    CONFIG_COAPC_THREAD_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&coapc_thread, "coapc");
+    return 0;
+}
+
+int coapc_submit(struct coapc_request *req) {
+    if (!atomic_get(&running)) {
+        return -ENODEV;
+    }
+    if (!req->uri) {
+        return -EINVAL;
+    }
+    if (!atomic_cas(&req->state, COAPC_IDLE, COAPC_QUEUED) &&
+        !atomic_cas(&req->state, COAPC_DONE, COAPC_QUEUED)) {
+        return -EBUSY;
+    }
+    req->status = 0;
+    req->code = 0;
+    req->response_len = 0;
+    req->response_total = 0;
+
+    mpsc_push(&queue, &req->node);
+    /* Never blocks: the counter only saturates after 2^64 - 2 wakeups */
+    eventfd_write(wake_fd, 1);
+    return 0;
+}
+
+bool coapc_done(const struct coapc_request *req) {
+    return atomic_get(&req->state) == COAPC_DONE;
+}
+
+void coapc_stop(void) {
+    if (!atomic_cas(&running, 1, 0)) {
+        return;
+    }
+    eventfd_write(wake_fd, 1);
+    k_thread_join(&coapc_thread, K_FOREVER);
+    close(wake_fd);
+    wake_fd = -1;
+}
@@ -0,0 +1,22 @@
+/*
+ * mbedtls/include/async.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Requests through the asynchronous client library (lib/coapc)
+ */
+
+#ifndef ASYNC_H
+#define ASYNC_H
+
+/* Priorities the requests cycle through, 0 the most urgent */
+#define ASYNC_PRIORITIES 3
+/* Response body kept per request */
+#define ASYNC_BODY_SIZE 64
+
+/* Submit CONFIG_APP_ASYNC_REQUESTS requests of uri at once and wait for
+ * all of them; returns the number answered with 2.xx */
+int async_run(const char *uri);
+void async_report(void);
+
+#endif /* ASYNC_H */
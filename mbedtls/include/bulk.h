@@ -0,0 +1,42 @@
+/*
+ * mbedtls/include/bulk.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Bulk transfer goodput measurement over the client session
+ */
+
+#ifndef BULK_H
+#define BULK_H
+
+#include <coap3/coap.h>
+
+/* Transfers to run; when 0 the test runs for BULK_DURATION_S instead */
+#ifndef BULK_ROUNDS
+#define BULK_ROUNDS 0
+#endif
+#ifndef BULK_DURATION_S
+#define BULK_DURATION_S 10
+#endif
+
+/* Body of each Block1 upload (with BULK_UPLOAD) */
+#ifndef BULK_BODY_SIZE
+#define BULK_BODY_SIZE 8192
+#endif
+
+/* Block size exponent: 16 << SZX bytes. The default is 1024 bytes over
+ * UDP/DTLS and SZX 7, BERT (RFC 8323 section 6), over TCP/TLS, where a
+ * message carries several 1024 byte blocks once both sides signalled
+ * Block-Wise-Transfer in their CSM. */
+#define BULK_SZX_UDP 6
+#define BULK_SZX_BERT 7
+
+/* Time allowed for one complete body */
+#define BULK_TIMEOUT_MS 30000
+
+int bulk_run(coap_context_t *ctx, coap_session_t *session,
+             coap_optlist_t **optlist);
+int bulk_handle_response(const coap_pdu_t *received);
+void bulk_report(void);
+
+#endif /* BULK_H */
@@ -0,0 +1,27 @@
+/*
+ * mbedtls/include/coaplog.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * libcoap log output through Zephyr logging, and the opt-in PDU trace
+ */
+
+#ifndef COAPLOG_H
+#define COAPLOG_H
+
+#include <coap3/coap.h>
+
+/* Route libcoap's messages to the app_libcoap log module and set
+ * libcoap's level from it. Call before coap_startup(). */
+void coaplog_init(void);
+
+/* Dump of a sent or received PDU (CONFIG_APP_PDU_TRACE). coap_show_pdu()
+ * formats every option in the calling thread, which is the request path,
+ * so without the trace the call is not compiled in at all. */
+#ifdef CONFIG_APP_PDU_TRACE
+#define COAPLOG_PDU(pdu) coap_show_pdu(COAP_LOG_WARN, (pdu))
+#else
+#define COAPLOG_PDU(pdu) ((void)(pdu))
+#endif
+
+#endif /* COAPLOG_H */
@@ -101,4 +101,29 @@
 #endif /* ! MBEDTLS_MD_CAN_SHA256 */
 #endif /* MBEDTLS_MD_C */
 
+/* TLS heap of the client (src/heaps.c) instead of the
+ * CONFIG_MBEDTLS_HEAP_SIZE buffer, which overlay-heaps.conf turns off.
+ * The Wi-Fi supplicant shares this configuration, so its allocations
+ * go there as well. */
+#ifdef CONFIG_APP_HEAPS
+#include <stddef.h>
+void *heaps_tls_calloc(size_t n, size_t size);
+void heaps_tls_free(void *p);
+#ifndef MBEDTLS_PLATFORM_C
+#define MBEDTLS_PLATFORM_C
+#endif
+#define MBEDTLS_PLATFORM_MEMORY
+#define MBEDTLS_PLATFORM_CALLOC_MACRO heaps_tls_calloc
+#define MBEDTLS_PLATFORM_FREE_MACRO heaps_tls_free
+#endif /* CONFIG_APP_HEAPS */
+
+/* Reduced-stack mode: the bignum and signature buffers that live on the
+ * stack during the handshake are sized from the largest MPI, 1024 bytes
+ * by default. 256 still covers the RSA-2048 and P-256 keys of
+ * scripts/generate_certs.sh. */
+#ifdef CONFIG_APP_REDUCED_STACK
+#undef MBEDTLS_MPI_MAX_SIZE
+#define MBEDTLS_MPI_MAX_SIZE 256
+#endif /* CONFIG_APP_REDUCED_STACK */
+
 #endif /* CONFIG_MBEDTLS_LIBCOAP_H */
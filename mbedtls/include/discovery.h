@@ -0,0 +1,54 @@
+/*
+ * mbedtls/include/discovery.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * /.well-known/core discovery and link-format index for CoAP client
+ */
+
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <coap3/coap.h>
+
+/* Links kept in the index; further links in the document are skipped */
+#define DISCOVERY_MAX_ENTRIES 16
+/* Field sizes including the terminating NUL. Links whose target does not
+ * fit are dropped, overlong rt/if values are left empty. */
+#define DISCOVERY_PATH_MAX 32
+#define DISCOVERY_RT_MAX 24
+#define DISCOVERY_IF_MAX 16
+
+/* Lifetime of a fetched index when DISCOVERY_TTL_S is not overridden */
+#ifndef DISCOVERY_TTL_S
+#define DISCOVERY_TTL_S (24 * 60 * 60)
+#endif
+/* Lifetime every run uses up at least, however short: without an RTC
+ * the time the device was off is not known */
+#ifndef DISCOVERY_RUN_CHARGE_S
+#define DISCOVERY_RUN_CHARGE_S 60
+#endif
+/* Time allowed for the /.well-known/core exchange */
+#define DISCOVERY_TIMEOUT_MS 10000
+
+#define DISCOVERY_CT_NONE 0xFFFF
+
+struct discovery_entry {
+    char path[DISCOVERY_PATH_MAX];
+    char rt[DISCOVERY_RT_MAX];
+    char if_[DISCOVERY_IF_MAX];
+    uint16_t ct;
+    uint32_t sz;
+};
+
+void discovery_init(const char *server);
+int discovery_valid(void);
+int discovery_fetch(coap_context_t *ctx, coap_session_t *session);
+int discovery_handle_response(const coap_pdu_t *received);
+const struct discovery_entry *discovery_lookup_rt(const char *rt);
+void discovery_report(void);
+void discovery_save(void);
+/* Drop the index, also the saved one, e.g. when it lacks a resource */
+void discovery_invalidate(void);
+
+#endif /* DISCOVERY_H */
@@ -0,0 +1,43 @@
+/*
+ * mbedtls/include/failover.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Warm-standby backup session for CoAP client
+ */
+
+#ifndef FAILOVER_H
+#define FAILOVER_H
+
+#include <coap3/coap.h>
+
+/* Transmission parameters applied to the primary and standby sessions so
+ * that an unresponsive server is given up on quickly (RFC 7252 4.8) */
+#define FAILOVER_ACK_TIMEOUT_S 1
+#define FAILOVER_MAX_RETRANSMIT 2
+/* MAX_TRANSMIT_WAIT for the parameters above, incl. ACK_RANDOM_FACTOR 1.5:
+ * from the first transmission until the last retransmission times out */
+#define FAILOVER_TRANSMIT_WAIT_MS                                              \
+    (FAILOVER_ACK_TIMEOUT_S * 1000 *                                           \
+     ((1 << (FAILOVER_MAX_RETRANSMIT + 1)) - 1) * 3 / 2)
+
+/* Standby keepalive: keeps NAT bindings and the (D)TLS session warm */
+#define FAILOVER_KEEPALIVE_MS 15000
+/* A keepalive with no Pong/RST after this time is counted as missed */
+#define FAILOVER_KEEPALIVE_TIMEOUT_MS 3000
+/* Time allowed for the standby handshake at startup */
+#define FAILOVER_CONNECT_TIMEOUT_MS 10000
+
+int failover_init(coap_context_t *ctx, const char *backup,
+                  uint16_t default_port);
+void failover_arm(coap_session_t *primary);
+void failover_poll(void);
+int failover_handle_reply(coap_session_t *session, coap_mid_t mid);
+int failover_handle_nack(coap_session_t *session, const coap_pdu_t *sent,
+                         coap_nack_reason_t reason);
+void failover_handle_response(coap_session_t *session);
+int failover_exhausted(void);
+void failover_report(void);
+void failover_cleanup(void);
+
+#endif /* FAILOVER_H */
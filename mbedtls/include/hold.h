@@ -0,0 +1,31 @@
+/*
+ * mbedtls/include/hold.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Long-lived session: cache refreshes, RD refreshes and keepalives
+ */
+
+#ifndef HOLD_H
+#define HOLD_H
+
+#include <coap3/coap.h>
+
+/* Freshness of a response without Max-Age (RFC 7252, 5.10.5) */
+#define HOLD_DEFAULT_MAX_AGE_S 60
+/* Time allowed for one refetch, past libcoap's MAX_TRANSMIT_WAIT (93 s) */
+#define HOLD_TIMEOUT_MS 100000
+/* Longest single wait of the I/O loop, so the RD refresh and failover
+ * keepalives polled from it are not held back */
+#define HOLD_POLL_MS 10000
+
+/* The first response: its Max-Age starts the cache lifetime */
+void hold_cached(const coap_pdu_t *received);
+/* Keep the session for CONFIG_APP_HOLD_S, refetching the resource over
+ * it whenever the cached copy expires */
+int hold_run(coap_context_t *ctx, coap_session_t *session,
+             coap_optlist_t **optlist);
+int hold_handle_response(const coap_pdu_t *received);
+void hold_report(void);
+
+#endif /* HOLD_H */
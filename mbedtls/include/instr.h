@@ -0,0 +1,56 @@
+/*
+ * mbedtls/include/instr.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * CPU, network and heap counters for the CoAP client benchmarks
+ */
+
+#ifndef INSTR_H
+#define INSTR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Counters at one point in time. Fields whose Kconfig support is not
+ * built in (overlay-stats.conf) stay zero. */
+struct instr_sample {
+    int64_t uptime_ms;
+    uint64_t cpu_total;     /* Cycles of all threads, idle included */
+    uint64_t cpu_idle;      /* Cycles of the idle thread(s) */
+    uint64_t cpu_self;      /* Cycles of the calling thread */
+    uint32_t udp_sent;      /* Datagrams */
+    uint32_t udp_recv;
+    uint32_t tcp_sent;      /* Segments */
+    uint32_t tcp_rexmit;
+};
+
+void instr_sample(struct instr_sample *s);
+/* Busy share of the CPU and share used by the calling thread between two
+ * samples, in tenths of a percent */
+uint32_t instr_cpu_busy(const struct instr_sample *from,
+                        const struct instr_sample *to);
+uint32_t instr_cpu_self(const struct instr_sample *from,
+                        const struct instr_sample *to);
+/* Bytes in use on the malloc() heap, where libcoap and the (D)TLS library
+ * allocate from; 0 when the libc keeps no statistics */
+size_t instr_heap_used(void);
+/* Same heap, with its peak and the bytes still free (the arena size for
+ * newlib, which keeps no peak) */
+struct instr_heap {
+    size_t used;
+    size_t peak;
+    size_t free;
+};
+void instr_heap_get(struct instr_heap *heap);
+void instr_heap_report(void);
+
+/* Heap counters and the stack high-water mark at the phase boundaries of
+ * main(), printed as a table by instr_phase_report() */
+#ifndef INSTR_MAX_PHASES
+#define INSTR_MAX_PHASES 12
+#endif
+void instr_phase(const char *name);
+void instr_phase_report(void);
+
+#endif /* INSTR_H */
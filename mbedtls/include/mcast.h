@@ -0,0 +1,27 @@
+/*
+ * mbedtls/include/mcast.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Multicast response aggregation for CoAP client
+ */
+
+#ifndef MCAST_H
+#define MCAST_H
+
+#include <coap3/coap.h>
+
+/* Distinct responders kept per multicast request; further ones are counted */
+#define MCAST_MAX_RESPONDERS 16
+/* Leading payload bytes kept per responder (e.g. start of a link-format) */
+#define MCAST_DATA_MAX 64
+
+/* "All CoAP Nodes" IPv4 group (RFC 7252, section 12.8) */
+#define MCAST_ALL_COAP_NODES_IPV4 "224.0.1.187"
+
+void mcast_reset(void);
+void mcast_collect(coap_session_t *session, const coap_pdu_t *received);
+int mcast_responders(void);
+void mcast_report(void);
+
+#endif /* MCAST_H */
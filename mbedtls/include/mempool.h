@@ -0,0 +1,46 @@
+/*
+ * mbedtls/include/mempool.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Fixed-size memory pools behind libcoap's coap_malloc_type()
+ */
+
+#ifndef MEMPOOL_H
+#define MEMPOOL_H
+
+#include <coap3/coap.h>
+
+/* Block sizes per memory type. The structures are private to libcoap,
+ * so these are upper bounds for a 32-bit target, scaled with the pointer
+ * size. A larger request goes to the heap and is reported as oversize. */
+#ifndef MEMPOOL_SESSION_SIZE
+#define MEMPOOL_SESSION_SIZE (256 * sizeof(void *))
+#endif
+#ifndef MEMPOOL_DTLS_SESSION_SIZE
+#define MEMPOOL_DTLS_SESSION_SIZE (1024 * sizeof(void *))
+#endif
+#ifndef MEMPOOL_PDU_SIZE
+#define MEMPOOL_PDU_SIZE (32 * sizeof(void *))
+#endif
+/* Token, options and payload of one PDU: the MTU plus the largest header */
+#ifndef MEMPOOL_PDU_BUF_SIZE
+#define MEMPOOL_PDU_BUF_SIZE (COAP_DEFAULT_MTU + 16)
+#endif
+#ifndef MEMPOOL_NODE_SIZE
+#define MEMPOOL_NODE_SIZE (16 * sizeof(void *))
+#endif
+#ifndef MEMPOOL_LG_SIZE
+#define MEMPOOL_LG_SIZE (128 * sizeof(void *))
+#endif
+/* Option list entries carry their value inline */
+#ifndef MEMPOOL_OPTLIST_SIZE
+#define MEMPOOL_OPTLIST_SIZE (sizeof(coap_optlist_t) + 48)
+#endif
+#ifndef MEMPOOL_STRING_SIZE
+#define MEMPOOL_STRING_SIZE 64
+#endif
+
+void mempool_report(void);
+
+#endif /* MEMPOOL_H */
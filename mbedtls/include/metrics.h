@@ -0,0 +1,29 @@
+/*
+ * mbedtls/include/metrics.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Device metrics as an Observable CBOR resource at /metrics
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <coap3/coap.h>
+
+/* Serialised /metrics document: a few hundred bytes, plus 6 per
+ * non-empty histogram bucket */
+#ifndef METRICS_DOC_SIZE
+#define METRICS_DOC_SIZE 1024
+#endif
+
+/* The /metrics resource on ctx */
+void metrics_init(coap_context_t *ctx);
+/* From the context's event handler: handshakes */
+int metrics_event(coap_session_t *session, const coap_event_t event);
+/* Notify the observers once CONFIG_APP_METRICS_NOTIFY_S has passed;
+ * cheap enough for every turn of an I/O loop or every new sample */
+void metrics_poll(void);
+
+#endif /* METRICS_H */
@@ -0,0 +1,43 @@
+/*
+ * mbedtls/include/ping.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * coap-ping: RTT and loss measurement over the client session
+ */
+
+#ifndef PING_H
+#define PING_H
+
+#include <coap3/coap.h>
+
+/* Time between probes */
+#ifndef PING_INTERVAL_MS
+#define PING_INTERVAL_MS 1000
+#endif
+/* A probe not answered within this time is counted as lost */
+#ifndef PING_TIMEOUT_MS
+#define PING_TIMEOUT_MS 2000
+#endif
+/* Probes in flight at once over TCP/TLS, the oldest is given up when all
+ * are busy. Over UDP/DTLS there is one, see ping.c. */
+#define PING_MAX_OUTSTANDING 8
+/* Retransmissions of a UDP/DTLS probe, and the longest libcoap keeps one
+ * in flight with them: MAX_TRANSMIT_WAIT for ACK_TIMEOUT 2 s */
+#define PING_MAX_RETRANSMIT 1
+#define PING_RETRY_WAIT_MS                                                     \
+    (2000 * ((1 << (PING_MAX_RETRANSMIT + 1)) - 1) * 3 / 2)
+/* Loss burst histogram: runs of 1 .. PING_BURST_BUCKETS-1 lost probes,
+ * the last bucket collects longer runs */
+#define PING_BURST_BUCKETS 8
+/* Time allowed for a (D)TLS handshake or TCP connect before the first probe */
+#define PING_CONNECT_TIMEOUT_MS 10000
+
+int ping_run(coap_context_t *ctx, coap_session_t *session, int count,
+             const coap_uri_t *uri);
+int ping_handle_reply(coap_session_t *session, coap_mid_t mid);
+int ping_handle_response(const coap_pdu_t *received);
+void ping_handle_nack(coap_session_t *session, coap_mid_t mid);
+void ping_report(void);
+
+#endif /* PING_H */
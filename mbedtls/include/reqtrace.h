@@ -0,0 +1,27 @@
+/*
+ * mbedtls/include/reqtrace.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Request lifecycle events for Zephyr's tracing subsystem (CTF)
+ */
+
+#ifndef REQTRACE_H
+#define REQTRACE_H
+
+/* One named event with two arguments in the trace, next to the kernel's
+ * own events (thread switches, ISRs, semaphores). Names stay below the
+ * 20 characters a CTF named event keeps. Names ending in _begin and _end
+ * are paired into slices by scripts/ctf2perfetto.py. */
+#ifdef CONFIG_APP_TRACING
+#include <stdint.h>
+#include <zephyr/tracing/tracing.h>
+#define REQTRACE(name, arg0, arg1) \
+    sys_trace_named_event((name), (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define REQTRACE(name, arg0, arg1) \
+    do {                           \
+    } while (0)
+#endif
+
+#endif /* REQTRACE_H */
@@ -0,0 +1,24 @@
+/*
+ * mbedtls/include/simserver.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Server stand-in for runs in virtual time
+ */
+
+#ifndef SIMSERVER_H
+#define SIMSERVER_H
+
+#include <coap3/coap.h>
+
+/* Location-Path handed out for the one RD registration it keeps */
+#define SIMSERVER_RD_LOCATION "reg"
+/* Registration lifetime without lt= (RFC 9176) */
+#define SIMSERVER_RD_LIFETIME_S 90000
+
+/* Resources and the 127.0.0.1 endpoint on the client's own context, so
+ * they are served by the client's coap_io_process() calls */
+int simserver_init(coap_context_t *ctx);
+void simserver_report(void);
+
+#endif /* SIMSERVER_H */
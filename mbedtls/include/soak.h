@@ -0,0 +1,36 @@
+/*
+ * mbedtls/include/soak.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Soak test: many request cycles with heap growth and fragmentation checks
+ */
+
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <coap3/coap.h>
+
+/* Heap samples taken over the run, evenly spaced */
+#ifndef SOAK_SAMPLES
+#define SOAK_SAMPLES 64
+#endif
+/* Samples in the first part of the run (caches filling, first
+ * handshake) are left out of the verdict */
+#define SOAK_WARMUP_PCT 10
+/* Steady growth (or shrinking of the largest free block) beyond this
+ * over the run is reported as a leak (or as fragmentation) */
+#ifndef SOAK_LEAK_TOLERANCE
+#define SOAK_LEAK_TOLERANCE 512
+#endif
+/* Failed cycles allowed before the run fails on its own */
+#define SOAK_MAX_FAIL_PCT 1
+/* Time allowed for one cycle, handshake included */
+#define SOAK_TIMEOUT_MS 5000
+
+int soak_run(coap_context_t *ctx, const coap_address_t *dst,
+             const coap_uri_t *uri);
+int soak_handle_response(const coap_pdu_t *received);
+void soak_report(void);
+
+#endif /* SOAK_H */
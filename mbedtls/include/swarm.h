@@ -0,0 +1,42 @@
+/*
+ * mbedtls/include/swarm.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Swarm mode: many independent clients in one native_sim process
+ */
+
+#ifndef SWARM_H
+#define SWARM_H
+
+#include <coap3/coap.h>
+
+/* Time between two requests of the same client once connected. The
+ * clients are spread evenly over the interval. */
+#ifndef SWARM_INTERVAL_MS
+#define SWARM_INTERVAL_MS 1000
+#endif
+/* Length of the steady phase after the ramp */
+#ifndef SWARM_DURATION_S
+#define SWARM_DURATION_S 30
+#endif
+/* Heap each client may use, (D)TLS state included. A client is only
+ * admitted while the heap in use stays within the budget of the clients
+ * already admitted. */
+#ifndef SWARM_CLIENT_BUDGET
+#define SWARM_CLIENT_BUDGET 32768
+#endif
+/* Handshakes in flight at once during the ramp */
+#ifndef SWARM_CONCURRENT_HANDSHAKES
+#define SWARM_CONCURRENT_HANDSHAKES 16
+#endif
+/* Time allowed for a handshake and for a response */
+#define SWARM_CONNECT_TIMEOUT_MS 10000
+#define SWARM_TIMEOUT_MS 5000
+
+int swarm_run(coap_context_t *ctx, const coap_address_t *dst,
+              const coap_uri_t *uri);
+int swarm_handle_response(coap_session_t *session, const coap_pdu_t *received);
+void swarm_report(void);
+
+#endif /* SWARM_H */
@@ -18,4 +18,6 @@ int wifi_init(struct device *unused);
 int shell_cmd_scan(void);
 int wait_for_wifi_connection(void);
 int connect_to_wifi(void);
-void wifi_disconnect(void);
\ No newline at end of file
+void wifi_disconnect(void);
+/* Time associated with the access point so far, in ms */
+uint32_t wifi_radio_ms(void);
\ No newline at end of file
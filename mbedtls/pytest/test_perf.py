@@ -0,0 +1,36 @@
+# mbedtls/pytest/test_perf.py
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# pytest entry point of the performance gate:
+# scripts/perf_gate.py builds and runs its own configurations against a
+# local bench server and compares them with perf_baseline.json.
+
+import json
+import os
+import subprocess
+import sys
+
+import pytest
+
+APP_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+ROOT = os.path.dirname(APP_DIR)
+BACKEND = os.path.basename(APP_DIR)
+
+
+def test_perf_gate(tmp_path):
+    output = tmp_path / "perf.json"
+    gate = subprocess.run(
+        [sys.executable, os.path.join(ROOT, "scripts", "perf_gate.py"),
+         "--backend", BACKEND, "--output", str(output)],
+        capture_output=True, text=True)
+    if gate.returncode == 2:
+        # Nothing to compare against until a baseline is recorded with
+        # --update and committed
+        pytest.skip("no performance baseline for " + BACKEND)
+    assert output.exists(), gate.stderr
+    result = json.loads(output.read_text())
+    assert not result["failed"], result["failed"]
+    assert not result["regressions"], "\n" + gate.stderr
+    assert gate.returncode == 0, gate.stderr
@@ -0,0 +1,167 @@
+/*
+ * mbedtls/src/async.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Requests through the asynchronous client library.
+ *
+ * main() hands CONFIG_APP_ASYNC_REQUESTS GETs of the target URI to
+ * lib/coapc at once, cycling through ASYNC_PRIORITIES priorities. Half
+ * of them complete through a callback, the other half through a k_poll
+ * signal, and main() waits for both kinds in one k_poll() call, the way
+ * an application thread with other work would. The report gives the
+ * longest coapc_submit() call, which never waits for the network, and
+ * the latency per priority.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <coapc.h>
+#include "async.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+#define N CONFIG_APP_ASYNC_REQUESTS
+
+static struct coapc_request requests[N];
+static uint8_t bodies[N][ASYNC_BODY_SIZE];
+static struct k_poll_signal signals[N];
+static int64_t submitted_ms[N];
+static int64_t completed_ms[N];
+static bool observed[N];
+static K_SEM_DEFINE(callbacks, 0, N);
+
+static uint32_t submit_max_us;
+static uint32_t answered;
+static uint32_t failed;
+static int64_t elapsed_ms;
+
+static void request_done(struct coapc_request *req) {
+    completed_ms[req - requests] = k_uptime_get();
+    k_sem_give(&callbacks);
+}
+
+int async_run(const char *uri) {
+    struct k_poll_event events[N + 1];
+    int64_t start;
+    int remaining = N;
+    int ret;
+
+    ret = coapc_init(NULL);
+    if (ret) {
+        LOG_ERR("Cannot start the async client: %d", ret);
+        return 0;
+    }
+
+    for (int i = 0; i < N; i++) {
+        struct coapc_request *req = &requests[i];
+
+        req->uri = uri;
+        req->priority = i % ASYNC_PRIORITIES;
+        req->response = bodies[i];
+        req->response_size = sizeof(bodies[i]);
+        if (i % 2) {
+            k_poll_signal_init(&signals[i]);
+            req->signal = &signals[i];
+        } else {
+            req->done = request_done;
+        }
+    }
+
+    LOG_INF("Submitting %d requests of %s", N, uri);
+    start = k_uptime_get();
+    for (int i = 0; i < N; i++) {
+        uint32_t cycles = k_cycle_get_32();
+
+        submitted_ms[i] = k_uptime_get();
+        ret = coapc_submit(&requests[i]);
+        cycles = k_cycle_get_32() - cycles;
+        submit_max_us = MAX(submit_max_us, k_cyc_to_us_ceil32(cycles));
+        if (ret) {
+            LOG_ERR("Request %d not submitted: %d", i, ret);
+            observed[i] = true;
+            failed++;
+            remaining--;
+        }
+    }
+
+    /* The completions of both kinds in one wait */
+    while (remaining > 0) {
+        int count = 0;
+
+        for (int i = 1; i < N; i += 2) {
+            if (!observed[i]) {
+                k_poll_event_init(&events[count++], K_POLL_TYPE_SIGNAL,
+                                  K_POLL_MODE_NOTIFY_ONLY, &signals[i]);
+            }
+        }
+        k_poll_event_init(&events[count++], K_POLL_TYPE_SEM_AVAILABLE,
+                          K_POLL_MODE_NOTIFY_ONLY, &callbacks);
+        k_poll(events, count, K_FOREVER);
+
+        for (int i = 0; i < count - 1; i++) {
+            struct k_poll_signal *signal = events[i].signal;
+
+            if (events[i].state == K_POLL_STATE_SIGNALED) {
+                completed_ms[signal - signals] = k_uptime_get();
+                observed[signal - signals] = true;
+                remaining--;
+            }
+        }
+        while (k_sem_take(&callbacks, K_NO_WAIT) == 0) {
+            remaining--;
+        }
+    }
+    elapsed_ms = k_uptime_get() - start;
+    /* The thread publishes the state after the callback and the signal
+     * that woke this one; once it has ended, every state is final */
+    coapc_stop();
+
+    for (int i = 0; i < N; i++) {
+        if (!coapc_done(&requests[i])) {
+            continue;
+        }
+        if (requests[i].status == 0 &&
+            COAP_RESPONSE_CLASS(requests[i].code) == 2) {
+            answered++;
+        } else {
+            failed++;
+        }
+    }
+    return answered;
+}
+
+void async_report(void) {
+    printf("\n=== ASYNC ===\n");
+    printf("Requests: %d, %u answered, %u failed in %u ms\n", N,
+           (unsigned)answered, (unsigned)failed, (unsigned)elapsed_ms);
+    printf("Longest coapc_submit(): %u us\n", (unsigned)submit_max_us);
+    for (int p = 0; p < ASYNC_PRIORITIES; p++) {
+        int64_t sum = 0;
+        int64_t max = 0;
+        int count = 0;
+
+        for (int i = p; i < N; i += ASYNC_PRIORITIES) {
+            if (coapc_done(&requests[i]) && requests[i].status == 0) {
+                int64_t latency = completed_ms[i] - submitted_ms[i];
+
+                sum += latency;
+                max = MAX(max, latency);
+                count++;
+            }
+        }
+        if (count) {
+            printf("Priority %d: %d answered, avg %u ms, max %u ms\n", p,
+                   count, (unsigned)(sum / count), (unsigned)max);
+        }
+    }
+    for (int i = 0; i < N; i++) {
+        if (coapc_done(&requests[i]) && requests[i].status) {
+            printf("Request %d: %d\n", i, requests[i].status);
+        }
+    }
+    printf("=== END ASYNC ===\n");
+}
@@ -0,0 +1,52 @@
+/*
+ * mbedtls/src/coaplog.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * libcoap log output through Zephyr logging.
+ *
+ * libcoap formats its messages itself and hands each finished line to a
+ * log handler; by default that handler writes it to the console from the
+ * calling thread. This one passes the line on to the app_libcoap log
+ * module instead, so libcoap shares the deferred (or dictionary) backend
+ * and the timestamps of the rest of the client. libcoap's own level
+ * follows CONFIG_APP_LIBCOAP_LOG_LEVEL, so a message the module would
+ * drop is not formatted by libcoap in the first place.
+ */
+
+#include <string.h>
+#include <zephyr/logging/log.h>
+#include "coaplog.h"
+
+LOG_MODULE_REGISTER(app_libcoap, CONFIG_APP_LIBCOAP_LOG_LEVEL);
+
+static void log_handler(coap_log_t level, const char *message) {
+    int len = (int)strlen(message);
+
+    /* The log backend ends the line itself */
+    if (len > 0 && message[len - 1] == '\n') {
+        len--;
+    }
+    if (level <= COAP_LOG_ERR) {
+        LOG_ERR("%.*s", len, message);
+    } else if (level == COAP_LOG_WARN) {
+        LOG_WRN("%.*s", len, message);
+    } else if (level <= COAP_LOG_INFO) {
+        LOG_INF("%.*s", len, message);
+    } else {
+        LOG_DBG("%.*s", len, message);
+    }
+}
+
+void coaplog_init(void) {
+    static const coap_log_t levels[] = {
+        [LOG_LEVEL_NONE] = COAP_LOG_EMERG,
+        [LOG_LEVEL_ERR] = COAP_LOG_ERR,
+        [LOG_LEVEL_WRN] = COAP_LOG_WARN,
+        [LOG_LEVEL_INF] = COAP_LOG_INFO,
+        [LOG_LEVEL_DBG] = COAP_LOG_DEBUG,
+    };
+
+    coap_set_log_handler(log_handler);
+    coap_set_log_level(levels[CONFIG_APP_LIBCOAP_LOG_LEVEL]);
+}
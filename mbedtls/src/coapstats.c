@@ -0,0 +1,410 @@
+/*
+ * mbedtls/src/coapstats.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Per-session libcoap statistics, in the end-of-run report and as a
+ * JSON document at /stats.
+ *
+ * libcoap reports what happens to a session through its event handler
+ * (handshakes, connects and closes, DTLS errors, retransmissions, bad
+ * packets) and gives up on a request through the NACK handler; the
+ * client registered neither, so none of it was visible. Here both are
+ * counted per session, a session being its peer and transport. The send
+ * time of each request (coap_send() is wrapped, see reqtrace.c) is kept
+ * by token, so a response yields an RTT sample, or a duplicate when its
+ * token was answered already. Requests that were retransmitted give no
+ * sample (Karn's rule): libcoap does not say which request went out
+ * again, so a retransmission on a session disqualifies everything it has
+ * in flight. The same counters are served over CoAP from the client's
+ * own context (see serve_init() in main.c), so a device in the field can
+ * be asked without a console.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "coapstats.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+struct token {
+    uint8_t s[8];
+    uint8_t len;
+};
+
+struct pending {
+    struct token token;
+    uint32_t sent_cyc;
+    uint8_t active;
+    uint8_t retransmitted;
+};
+
+struct row {
+    int used;
+    coap_address_t peer;
+    coap_proto_t proto;
+    const char *state;
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t retransmits;
+    uint32_t nacks;
+    uint32_t timeouts;          /* NACK: too many retries */
+    uint32_t dtls_errors;
+    uint32_t duplicates;
+    uint32_t unmatched;         /* Token never sent or already evicted */
+    uint32_t bad_packets;
+    uint32_t block_failures;
+    uint32_t handshakes;
+    uint32_t connects;
+    uint32_t closes;
+    uint32_t failures;
+    uint32_t rtt_count;
+    uint32_t rtt_skipped;       /* Answers to retransmitted requests */
+    uint64_t rtt_sum_us;
+    uint32_t rtt_min_us;
+    uint32_t rtt_max_us;
+    uint32_t rtt_last_us;
+    struct pending pending[COAPSTATS_PENDING];
+    int pending_next;
+    struct token answered[COAPSTATS_ANSWERED];
+    int answered_next;
+};
+
+static struct row rows[COAPSTATS_SESSIONS];
+static uint32_t untracked;
+/* Rebuilt on every GET; a block-wise transfer in progress is served
+ * from it until the next one */
+static char doc[COAPSTATS_DOC_SIZE];
+
+static void set_token(struct token *t, coap_bin_const_t tok) {
+    t->len = (uint8_t)MIN(tok.length, sizeof(t->s));
+    memcpy(t->s, tok.s, t->len);
+}
+
+static int same_token(const struct token *t, coap_bin_const_t tok) {
+    return t->len == tok.length && !memcmp(t->s, tok.s, t->len);
+}
+
+static struct row *find_row(const coap_session_t *session) {
+    const coap_address_t *peer = coap_session_get_addr_remote(session);
+    coap_proto_t proto = coap_session_get_proto(session);
+
+    if (!peer) {
+        return NULL;
+    }
+    for (int i = 0; i < COAPSTATS_SESSIONS; i++) {
+        struct row *r = &rows[i];
+
+        if (!r->used) {
+            memset(r, 0, sizeof(*r));
+            r->used = 1;
+            memcpy(&r->peer, peer, sizeof(r->peer));
+            r->proto = proto;
+            r->state = "new";
+            r->rtt_min_us = UINT32_MAX;
+            return r;
+        }
+        if (r->proto == proto && coap_address_equals(&r->peer, peer)) {
+            return r;
+        }
+    }
+    untracked++;
+    return NULL;
+}
+
+int coapstats_event(coap_session_t *session, const coap_event_t event) {
+    struct row *r;
+
+    /* Sessions of clients asking for /stats are not ours to count */
+    if (coap_session_get_type(session) != COAP_SESSION_TYPE_CLIENT) {
+        return 0;
+    }
+    r = find_row(session);
+    if (!r) {
+        return 0;
+    }
+    switch (event) {
+    case COAP_EVENT_DTLS_CONNECTED:
+        r->handshakes++;
+        r->state = "connected";
+        break;
+    case COAP_EVENT_TCP_CONNECTED:
+    case COAP_EVENT_SESSION_CONNECTED:
+        r->connects++;
+        r->state = "connected";
+        break;
+    case COAP_EVENT_DTLS_CLOSED:
+    case COAP_EVENT_TCP_CLOSED:
+    case COAP_EVENT_SESSION_CLOSED:
+        r->closes++;
+        r->state = "closed";
+        break;
+    case COAP_EVENT_TCP_FAILED:
+    case COAP_EVENT_SESSION_FAILED:
+    case COAP_EVENT_KEEPALIVE_FAILURE:
+        r->failures++;
+        r->state = "failed";
+        break;
+    case COAP_EVENT_DTLS_ERROR:
+        r->dtls_errors++;
+        r->state = "DTLS error";
+        break;
+    case COAP_EVENT_BAD_PACKET:
+        r->bad_packets++;
+        break;
+    case COAP_EVENT_XMIT_BLOCK_FAIL:
+        r->block_failures++;
+        break;
+    case COAP_EVENT_MSG_RETRANSMITTED:
+        r->retransmits++;
+        for (int i = 0; i < COAPSTATS_PENDING; i++) {
+            r->pending[i].retransmitted = 1;
+        }
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+void coapstats_sent(coap_session_t *session, const coap_pdu_t *pdu) {
+    coap_pdu_code_t code = coap_pdu_get_code(pdu);
+    struct row *r;
+    struct pending *p;
+
+    /* Requests only: no pings (empty) or signals */
+    if (code == 0 || COAP_RESPONSE_CLASS(code) != 0) {
+        return;
+    }
+    r = find_row(session);
+    if (!r) {
+        return;
+    }
+    r->requests++;
+    /* The oldest entry makes room when all are in flight */
+    p = &r->pending[r->pending_next];
+    r->pending_next = (r->pending_next + 1) % COAPSTATS_PENDING;
+    set_token(&p->token, coap_pdu_get_token(pdu));
+    p->sent_cyc = k_cycle_get_32();
+    p->active = 1;
+    p->retransmitted = 0;
+}
+
+static struct pending *find_pending(struct row *r, coap_bin_const_t tok) {
+    for (int i = 0; i < COAPSTATS_PENDING; i++) {
+        if (r->pending[i].active && same_token(&r->pending[i].token, tok)) {
+            return &r->pending[i];
+        }
+    }
+    return NULL;
+}
+
+void coapstats_response(coap_session_t *session, const coap_pdu_t *received) {
+    uint32_t now = k_cycle_get_32();
+    coap_bin_const_t tok = coap_pdu_get_token(received);
+    coap_block_t block;
+    struct pending *p;
+    struct row *r;
+
+    /* Blocks handed over one by one: the request ends with the last */
+    if (coap_get_block(received, COAP_OPTION_BLOCK2, &block) && block.m) {
+        return;
+    }
+    r = find_row(session);
+    if (!r) {
+        return;
+    }
+    r->responses++;
+
+    p = find_pending(r, tok);
+    if (!p) {
+        int duplicate = 0;
+
+        for (int i = 0; i < COAPSTATS_ANSWERED; i++) {
+            duplicate |= same_token(&r->answered[i], tok);
+        }
+        if (duplicate) {
+            r->duplicates++;
+        } else {
+            r->unmatched++;
+        }
+        return;
+    }
+    p->active = 0;
+    r->answered[r->answered_next] = p->token;
+    r->answered_next = (r->answered_next + 1) % COAPSTATS_ANSWERED;
+
+    if (p->retransmitted) {
+        r->rtt_skipped++;
+    } else {
+        uint32_t us = k_cyc_to_us_floor32(now - p->sent_cyc);
+
+        r->rtt_count++;
+        r->rtt_sum_us += us;
+        r->rtt_last_us = us;
+        r->rtt_min_us = MIN(r->rtt_min_us, us);
+        r->rtt_max_us = MAX(r->rtt_max_us, us);
+    }
+}
+
+void coapstats_nack(coap_session_t *session, const coap_pdu_t *sent,
+                    coap_nack_reason_t reason) {
+    struct row *r = find_row(session);
+    struct pending *p;
+
+    if (!r) {
+        return;
+    }
+    r->nacks++;
+    if (reason == COAP_NACK_TOO_MANY_RETRIES) {
+        r->timeouts++;
+    }
+    /* Given up, so no answer is expected any more */
+    if (sent) {
+        p = find_pending(r, coap_pdu_get_token(sent));
+        if (p) {
+            p->active = 0;
+        }
+    }
+}
+
+static const char *proto_name(coap_proto_t proto) {
+    switch (proto) {
+    case COAP_PROTO_UDP:
+        return "udp";
+    case COAP_PROTO_DTLS:
+        return "dtls";
+    case COAP_PROTO_TCP:
+        return "tcp";
+    case COAP_PROTO_TLS:
+        return "tls";
+    default:
+        return "other";
+    }
+}
+
+static void peer_name(const struct row *r, char *buf, size_t size) {
+    size_t len = coap_print_addr(&r->peer, (unsigned char *)buf, size - 1);
+
+    buf[MIN(len, size - 1)] = '\0';
+}
+
+static uint32_t rtt_avg_us(const struct row *r) {
+    return r->rtt_count ? (uint32_t)(r->rtt_sum_us / r->rtt_count) : 0;
+}
+
+/* The rows as JSON into doc, cut short (but still closed) when full */
+static size_t serialise(void) {
+    /* The closing "]}" always has room after what APPEND writes */
+    const size_t room = sizeof(doc) - sizeof("]}");
+    size_t pos = 0;
+    size_t row = 0;
+    int first = 1;
+
+#define APPEND(...)                                                      \
+    do {                                                                 \
+        int n = snprintf(doc + pos, room - pos, __VA_ARGS__);            \
+        if (n < 0 || (size_t)n >= room - pos) {                          \
+            goto full;                                                   \
+        }                                                                \
+        pos += n;                                                        \
+    } while (0)
+
+    APPEND("{\"untracked\":%u,\"sessions\":[", (unsigned)untracked);
+    for (int i = 0; i < COAPSTATS_SESSIONS && rows[i].used; i++) {
+        const struct row *r = &rows[i];
+        char peer[48];
+
+        peer_name(r, peer, sizeof(peer));
+        /* Where the row starts, its comma included */
+        row = pos;
+        APPEND("%s{\"peer\":\"%s\",\"proto\":\"%s\",\"state\":\"%s\","
+               "\"requests\":%u,\"responses\":%u,\"retransmits\":%u,"
+               "\"nacks\":%u,\"timeouts\":%u,\"dtls_errors\":%u,"
+               "\"duplicates\":%u,\"unmatched\":%u,\"bad_packets\":%u,"
+               "\"block_failures\":%u,\"handshakes\":%u,\"connects\":%u,"
+               "\"closes\":%u,\"failures\":%u,",
+               first ? "" : ",", peer, proto_name(r->proto), r->state,
+               (unsigned)r->requests, (unsigned)r->responses,
+               (unsigned)r->retransmits, (unsigned)r->nacks,
+               (unsigned)r->timeouts, (unsigned)r->dtls_errors,
+               (unsigned)r->duplicates, (unsigned)r->unmatched,
+               (unsigned)r->bad_packets, (unsigned)r->block_failures,
+               (unsigned)r->handshakes, (unsigned)r->connects,
+               (unsigned)r->closes, (unsigned)r->failures);
+        APPEND("\"rtt_us\":{\"samples\":%u,\"skipped\":%u,\"min\":%u,"
+               "\"avg\":%u,\"max\":%u,\"last\":%u}}",
+               (unsigned)r->rtt_count, (unsigned)r->rtt_skipped,
+               r->rtt_count ? (unsigned)r->rtt_min_us : 0,
+               (unsigned)rtt_avg_us(r), (unsigned)r->rtt_max_us,
+               (unsigned)r->rtt_last_us);
+        first = 0;
+    }
+    row = pos;
+
+full:
+#undef APPEND
+    /* Drop an unfinished row, in whichever part it overflowed */
+    pos = row;
+    memcpy(doc + pos, "]}", sizeof("]}"));
+    return pos + 2;
+}
+
+static void stats_get(coap_resource_t *resource, coap_session_t *session,
+                      const coap_pdu_t *request, const coap_string_t *query,
+                      coap_pdu_t *response) {
+    size_t len = serialise();
+
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CONTENT);
+    coap_add_data_large_response(resource, session, request, response, query,
+                                 COAP_MEDIATYPE_APPLICATION_JSON, -1, 0, len,
+                                 (const uint8_t *)doc, NULL, NULL);
+}
+
+void coapstats_init(coap_context_t *ctx) {
+    coap_resource_t *resource;
+
+    resource = coap_resource_init(coap_make_str_const("stats"), 0);
+    if (!resource) {
+        LOG_ERR("Cannot create the /stats resource");
+        return;
+    }
+    coap_register_request_handler(resource, COAP_REQUEST_GET, stats_get);
+    coap_add_resource(ctx, resource);
+}
+
+void coapstats_report(void) {
+    printf("\n=== COAP STATS ===\n");
+    for (int i = 0; i < COAPSTATS_SESSIONS && rows[i].used; i++) {
+        const struct row *r = &rows[i];
+        char peer[48];
+
+        peer_name(r, peer, sizeof(peer));
+        printf("%s %s (%s): %u requests, %u responses, %u duplicates, "
+               "%u unmatched\n", proto_name(r->proto), peer, r->state,
+               (unsigned)r->requests, (unsigned)r->responses,
+               (unsigned)r->duplicates, (unsigned)r->unmatched);
+        printf("  retransmits %u, NACKs %u (%u timeouts), DTLS errors %u, "
+               "bad packets %u, block failures %u\n",
+               (unsigned)r->retransmits, (unsigned)r->nacks,
+               (unsigned)r->timeouts, (unsigned)r->dtls_errors,
+               (unsigned)r->bad_packets, (unsigned)r->block_failures);
+        printf("  handshakes %u, connects %u, closes %u, failures %u\n",
+               (unsigned)r->handshakes, (unsigned)r->connects,
+               (unsigned)r->closes, (unsigned)r->failures);
+        if (r->rtt_count) {
+            printf("  RTT min/avg/max/last %u/%u/%u/%u us over %u samples "
+                   "(%u skipped after retransmission)\n",
+                   (unsigned)r->rtt_min_us, (unsigned)rtt_avg_us(r),
+                   (unsigned)r->rtt_max_us, (unsigned)r->rtt_last_us,
+                   (unsigned)r->rtt_count, (unsigned)r->rtt_skipped);
+        }
+    }
+    if (untracked) {
+        printf("%u events of sessions beyond the %d tracked\n",
+               (unsigned)untracked, COAPSTATS_SESSIONS);
+    }
+    printf("=== END COAP STATS ===\n");
+}
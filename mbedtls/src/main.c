@@ -9,13 +9,92 @@
 #include <string.h>
 #include <zephyr/init.h>
 #include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/posix/unistd.h>
 #include <zephyr/sys/slist.h>
 #include <coap3/coap.h>
+#include "client.h"
+#include "coaplog.h"
+#include "hist.h"
+#include "instr.h"
+#include "mcast.h"
+#include "reqtrace.h"
+#ifdef CONFIG_WIFI
 #include "wifi.h"
+#endif
+#ifdef CONFIG_ARCH_POSIX
+#include "posix_board_if.h"
+#endif
+#ifdef COAP_SERVER_ENDPOINTS
+#include "endpoints.h"
+#endif
+#ifdef COAP_BACKUP_SERVER
+#include "failover.h"
+#endif
+#ifdef COAP_RESOURCE_TYPE
+#include "discovery.h"
+#endif
+#ifdef COAP_RD_EP
+#include "rd.h"
+#endif
+#ifdef COAP_BULK
+#include "bulk.h"
+#endif
+#ifdef COAP_PING_COUNT
+#include "ping.h"
+#endif
+#ifdef COAP_SWARM_CLIENTS
+#include "swarm.h"
+#endif
+#ifdef COAP_SOAK_CYCLES
+#include "soak.h"
+#endif
+#ifdef CONFIG_APP_COAP_POOLS
+#include "mempool.h"
+#endif
+#ifdef CONFIG_APP_COAP_STATS
+#include "coapstats.h"
+#endif
+#ifdef CONFIG_APP_METRICS
+#include "metrics.h"
+#endif
+#if CONFIG_APP_HOLD_S > 0
+#include "hold.h"
+#endif
+#ifdef CONFIG_APP_SIM_SERVER
+#include "simserver.h"
+#endif
+#ifdef CONFIG_APP_ASYNC
+#include "async.h"
+#endif
+#ifdef CONFIG_THREAD_ANALYZER
+#include <zephyr/debug/thread_analyzer.h>
+#endif
+
+LOG_MODULE_REGISTER(app, CONFIG_APP_LOG_LEVEL);
+
+/* The larger locals of main() move off the stack in reduced-stack mode;
+ * main() runs once, so static storage changes nothing else */
+#ifdef CONFIG_APP_REDUCED_STACK
+#define MAIN_LOCAL static
+#else
+#define MAIN_LOCAL
+#endif
 
 static int have_response = 0;
+static int is_mcast = 0;
+
+/* Time from coap_send() to the first response, printed once the wait
+ * is over so nothing in between formats text */
+static uint32_t sent_cycles;
+static uint32_t response_us;
+static int response_timed;
+
+/* Bytes of the response body copied into the log */
+#ifndef RESPONSE_LOG_BYTES
+#define RESPONSE_LOG_BYTES 64
+#endif
 
 #ifndef COAP_SERVER_IP
 #define COAP_SERVER_IP "134.102.218.18"
@@ -33,12 +112,28 @@ static int have_response = 0;
 #endif
 #endif
 
-#ifdef USE_DTLS
+#if defined(USE_TCP) && defined(USE_DTLS)
+#define COAP_CLIENT_URI "coaps+tcp://" COAP_SERVER_IP COAP_SERVER_PATH
+#elif defined(USE_TCP)
+#define COAP_CLIENT_URI "coap+tcp://" COAP_SERVER_IP COAP_SERVER_PATH
+#elif defined(USE_DTLS)
 #define COAP_CLIENT_URI "coaps://" COAP_SERVER_IP COAP_SERVER_PATH
 #else
 #define COAP_CLIENT_URI "coap://" COAP_SERVER_IP COAP_SERVER_PATH
 #endif
 
+#ifdef USE_TCP
+/* Idle time after which a Ping signal (7.02) checks the connection, so
+ * it stays open between requests */
+#ifndef COAP_TCP_KEEPALIVE_S
+#if CONFIG_APP_KEEPALIVE_S > 0
+#define COAP_TCP_KEEPALIVE_S CONFIG_APP_KEEPALIVE_S
+#else
+#define COAP_TCP_KEEPALIVE_S 30
+#endif
+#endif
+#endif
+
 void cleanup_resources(coap_context_t *ctx, coap_session_t *session,
                        coap_optlist_t *optlist) {
     if (optlist)
@@ -52,7 +147,7 @@ void cleanup_resources(coap_context_t *ctx, coap_session_t *session,
 
 int setup_destination_address(coap_address_t *dst, const char *host,
                               uint16_t port) {
-    printf("Setting up destination address: %s:%d\n", host, port);
+    LOG_INF("Setting up destination address: %s:%d", host, port);
 
     memset(dst, 0, sizeof(coap_address_t));
 
@@ -61,19 +156,47 @@ int setup_destination_address(coap_address_t *dst, const char *host,
     sin->sin_port = htons(port);
 
     if (inet_pton(AF_INET, host, &sin->sin_addr) <= 0) {
-        printf("Failed to convert IP address: %s\n", host);
+        LOG_ERR("Failed to convert IP address: %s", host);
         return 0;
     }
 
     dst->size = sizeof(struct sockaddr_in); // This is 8 bytes in Zephyr
     dst->addr.sa.sa_family = AF_INET;
 
-    printf("Address size set to: %u (sizeof(struct sockaddr_in))\n", dst->size);
-    printf("Address family: %d\n", dst->addr.sa.sa_family);
-    printf("Target: %s:%d\n", host, port);
+    LOG_DBG("Address size set to: %u (sizeof(struct sockaddr_in))", dst->size);
+    LOG_DBG("Address family: %d", dst->addr.sa.sa_family);
+    LOG_DBG("Target: %s:%d", host, port);
+
+    LOG_DBG("Verification - sin_family: %d, sin_port: 0x%x, sin_addr: 0x%x",
+            sin->sin_family, sin->sin_port, sin->sin_addr.s_addr);
 
-    printf("Verification - sin_family: %d, sin_port: 0x%x, sin_addr: 0x%x\n",
-           sin->sin_family, sin->sin_port, sin->sin_addr.s_addr);
+    return 1;
+}
+
+/* Split "ip[:port]" into a NUL-terminated host and a port number */
+int parse_host_port(const char *spec, size_t len, uint16_t default_port,
+                    char *host, size_t host_size, uint16_t *port) {
+    const char *colon = memchr(spec, ':', len);
+    size_t host_len = colon ? (size_t)(colon - spec) : len;
+
+    if (host_len == 0 || host_len >= host_size) {
+        return 0;
+    }
+    memcpy(host, spec, host_len);
+    host[host_len] = '\0';
+
+    *port = default_port;
+    if (colon) {
+        char port_str[6];
+        size_t port_len = len - host_len - 1;
+
+        if (port_len == 0 || port_len >= sizeof(port_str)) {
+            return 0;
+        }
+        memcpy(port_str, colon + 1, port_len);
+        port_str[port_len] = '\0';
+        *port = (uint16_t)atoi(port_str);
+    }
 
     return 1;
 }
@@ -86,65 +209,135 @@ static coap_response_t response_handler(coap_session_t *session,
     const uint8_t *databuf;
     size_t offset;
     size_t total;
+    coap_pdu_code_t code;
 
-    (void)session;
     (void)sent;
     (void)id;
 
+    REQTRACE("response", coap_pdu_get_mid(received),
+             coap_pdu_get_code(received));
+#ifdef CONFIG_APP_COAP_STATS
+    coapstats_response(session, received);
+#endif
+#ifdef COAP_SWARM_CLIENTS
+    if (swarm_handle_response(session, received)) {
+        return COAP_RESPONSE_OK;
+    }
+#endif
+#ifdef COAP_SOAK_CYCLES
+    if (soak_handle_response(received)) {
+        return COAP_RESPONSE_OK;
+    }
+#endif
+#ifdef COAP_PING_COUNT
+    if (ping_handle_response(received)) {
+        return COAP_RESPONSE_OK;
+    }
+#endif
+#ifdef COAP_RESOURCE_TYPE
+    if (discovery_handle_response(received)) {
+        return COAP_RESPONSE_OK;
+    }
+#endif
+#ifdef COAP_RD_EP
+    if (rd_handle_response(received)) {
+        return COAP_RESPONSE_OK;
+    }
+#endif
+#ifdef COAP_BULK
+    if (bulk_handle_response(received)) {
+        return COAP_RESPONSE_OK;
+    }
+#endif
+#if CONFIG_APP_HOLD_S > 0
+    if (hold_handle_response(received)) {
+        return COAP_RESPONSE_OK;
+    }
+#endif
+#ifdef COAP_BACKUP_SERVER
+    failover_handle_response(session);
+#endif
+    if (is_mcast) {
+        have_response = 1;
+        /* Summarised by mcast_report() once the leisure window is over */
+        mcast_collect(session, received);
+        return COAP_RESPONSE_OK;
+    }
+    if (!response_timed) {
+        response_us = k_cyc_to_us_floor32(k_cycle_get_32() - sent_cycles);
+        response_timed = 1;
+        HIST_RECORD(HIST_RESPONSE, response_us);
+    }
+    COAPLOG_PDU(received);
     have_response = 1;
-    printf("\n=== RESPONSE RECEIVED ===\n");
-    coap_show_pdu(COAP_LOG_WARN, received);
+#if CONFIG_APP_HOLD_S > 0
+    /* The copy the hold phase keeps fresh */
+    hold_cached(received);
+#endif
+    code = coap_pdu_get_code(received);
     if (coap_get_data_large(received, &len, &databuf, &offset, &total)) {
-        printf("Response data: ");
-        fwrite(databuf, 1, len, stdout);
-        printf("\n");
+        /* Arguments and body bytes are copied into the log message; the
+         * text is made by the log thread, or on the host */
+        LOG_INF("Response %d.%02d, %u of %u bytes at %u",
+                COAP_RESPONSE_CLASS(code), code & 0x1f, (unsigned)len,
+                (unsigned)total, (unsigned)offset);
+        LOG_HEXDUMP_INF(databuf, MIN(len, RESPONSE_LOG_BYTES),
+                        "Response data");
+        /* Without COAP_BLOCK_SINGLE_BODY every block arrives on its own */
+        if (offset + len < total) {
+            have_response = 0;
+        }
+    } else {
+        LOG_INF("Response %d.%02d, no payload", COAP_RESPONSE_CLASS(code),
+                code & 0x1f);
     }
-    printf("=== END RESPONSE ===\n");
     return COAP_RESPONSE_OK;
 }
 
+#ifdef CONFIG_APP_DIAGNOSTICS
 void verify_tls_backend(void) {
-    printf("\n=== TLS Backend Verification ===\n");
+    LOG_INF("=== TLS Backend Verification ===");
     
     coap_tls_version_t *tls_version = coap_get_tls_library_version();
     
     if (!tls_version) {
-        printf("Failed to get TLS library version\n");
+        LOG_ERR("Failed to get TLS library version");
         return;
     }
     
-    printf("TLS Library Type: %d\n", tls_version->type);
+    LOG_INF("TLS Library Type: %d", tls_version->type);
     
     switch (tls_version->type) {
         case COAP_TLS_LIBRARY_NOTLS:
-            printf("No TLS support\n");
+            LOG_INF("No TLS support");
             break;
         case COAP_TLS_LIBRARY_TINYDTLS:
-            printf("Using TinyDTLS backend\n");
+            LOG_INF("Using TinyDTLS backend");
             break;
         case COAP_TLS_LIBRARY_OPENSSL:
-            printf("Using OpenSSL backend\n");
+            LOG_INF("Using OpenSSL backend");
             break;
         case COAP_TLS_LIBRARY_GNUTLS:
-            printf("Using GnuTLS backend\n");
+            LOG_INF("Using GnuTLS backend");
             break;
         case COAP_TLS_LIBRARY_MBEDTLS:
-            printf("Using mbedTLS backend\n");
+            LOG_INF("Using mbedTLS backend");
             break;
         case COAP_TLS_LIBRARY_WOLFSSL:
-            printf("Using wolfSSL backend\n");
+            LOG_INF("Using wolfSSL backend");
             break;
         default:
-            printf("Unknown TLS backend (type: %d)\n", tls_version->type);
+            LOG_INF("Unknown TLS backend (type: %d)", tls_version->type);
             break;
     }
     
-    printf("DTLS supported: %s\n", coap_dtls_is_supported() ? "Yes" : "No");
-    printf("DTLS PSK supported: %s\n", coap_dtls_psk_is_supported() ? "Yes" : "No");
-    printf("DTLS PKI supported: %s\n", coap_dtls_pki_is_supported() ? "Yes" : "No");
+    LOG_INF("DTLS supported: %s", coap_dtls_is_supported() ? "Yes" : "No");
+    LOG_INF("DTLS PSK supported: %s", coap_dtls_psk_is_supported() ? "Yes" : "No");
+    LOG_INF("DTLS PKI supported: %s", coap_dtls_pki_is_supported() ? "Yes" : "No");
     
-    printf("=== End TLS Backend Verification ===\n\n");
+    LOG_INF("=== End TLS Backend Verification ===");
 }
+#endif
 
 #ifdef USE_DTLS
 /* Minimal PKI setup - disables certificate verification */
@@ -160,71 +353,294 @@ static coap_dtls_pki_t *setup_minimal_pki(void) {
 }
 #endif
 
+#if defined(USE_DTLS) && defined(CONFIG_APP_HISTOGRAMS)
+#define HAVE_HANDSHAKE_TIMES
+/* Sessions in their handshake and when they were opened, for the
+ * handshake histogram; more at once than this go unmeasured */
+#define HANDSHAKE_SLOTS 8
+static struct {
+    const coap_session_t *session;
+    uint32_t start_cyc;
+} handshakes[HANDSHAKE_SLOTS];
+
+/* libcoap starts the handshake as it creates the session */
+static coap_session_t *handshake_started(coap_session_t *session) {
+    for (int i = 0; session && i < HANDSHAKE_SLOTS; i++) {
+        if (!handshakes[i].session) {
+            handshakes[i].session = session;
+            handshakes[i].start_cyc = k_cycle_get_32();
+            break;
+        }
+    }
+    return session;
+}
+
+static void handshake_done(const coap_session_t *session, int connected) {
+    uint32_t now = k_cycle_get_32();
+
+    for (int i = 0; i < HANDSHAKE_SLOTS; i++) {
+        if (handshakes[i].session == session) {
+            if (connected) {
+                HIST_RECORD(HIST_HANDSHAKE,
+                            k_cyc_to_us_floor32(now - handshakes[i].start_cyc));
+            }
+            handshakes[i].session = NULL;
+        }
+    }
+}
+#else
+#define handshake_started(session) (session)
+#endif
+
+/* Create a client session towards dst. The scheme of the target URI is
+ * fixed at build time, so only the session setup of that transport is
+ * linked in. */
+coap_session_t *open_session(coap_context_t *ctx, const coap_address_t *dst) {
+#if defined(USE_TCP) && defined(USE_DTLS)
+    /* TLS over TCP with minimal PKI (no cert verification) */
+    return handshake_started(
+        coap_new_client_session_pki(ctx, NULL, dst, COAP_PROTO_TLS,
+                                    setup_minimal_pki()));
+#elif defined(USE_DTLS)
+    /* DTLS session with minimal PKI (no cert verification) */
+    return handshake_started(
+        coap_new_client_session_pki(ctx, NULL, dst, COAP_PROTO_DTLS,
+                                    setup_minimal_pki()));
+#elif defined(USE_TCP)
+    return coap_new_client_session(ctx, NULL, dst, COAP_PROTO_TCP);
+#else
+    return coap_new_client_session(ctx, NULL, dst, COAP_PROTO_UDP);
+#endif
+}
+
+#if defined(COAP_SERVER_ENDPOINTS) || defined(COAP_BACKUP_SERVER) || \
+    defined(COAP_PING_COUNT)
+#define HAVE_PING_REPLY
+/* Pong (or RST to an empty CON) for one of the probe/keepalive pings */
+static void ping_reply(coap_session_t *session, const coap_mid_t mid) {
+#ifdef COAP_PING_COUNT
+    if (ping_handle_reply(session, mid)) {
+        return;
+    }
+#endif
+#ifdef COAP_SERVER_ENDPOINTS
+    if (endpoints_handle_reply(session, mid)) {
+        return;
+    }
+#endif
+#ifdef COAP_BACKUP_SERVER
+    failover_handle_reply(session, mid);
+#endif
+}
+
+static void pong_handler(coap_session_t *session, const coap_pdu_t *received,
+                         const coap_mid_t mid) {
+    (void)received;
+
+    ping_reply(session, mid);
+}
+#endif
+
+#if defined(HAVE_PING_REPLY) || defined(CONFIG_APP_COAP_STATS)
+/* Over UDP the answer to a ping is a RST, which libcoap may report as a
+ * NACK rather than a Pong depending on its keepalive state */
+static void nack_handler(coap_session_t *session, const coap_pdu_t *sent,
+                         const coap_nack_reason_t reason, const coap_mid_t mid) {
+#ifdef CONFIG_APP_COAP_STATS
+    coapstats_nack(session, sent, reason);
+#endif
+#ifdef HAVE_PING_REPLY
+    if (reason == COAP_NACK_RST) {
+        ping_reply(session, mid);
+    }
+#ifdef COAP_PING_COUNT
+    /* libcoap gave up on a probe, which frees the session's CON slot */
+    ping_handle_nack(session, mid);
+#endif
+#else
+    (void)mid;
+#endif
+#ifdef COAP_BACKUP_SERVER
+    failover_handle_nack(session, sent, reason);
+#elif !defined(CONFIG_APP_COAP_STATS)
+    (void)sent;
+#endif
+}
+#endif
+
+int client_event(coap_session_t *session, const coap_event_t event) {
+#ifdef HAVE_HANDSHAKE_TIMES
+    /* Also for failures, so a freed session's slot can be reused */
+    if (event == COAP_EVENT_DTLS_CONNECTED || event == COAP_EVENT_DTLS_ERROR ||
+        event == COAP_EVENT_DTLS_CLOSED) {
+        handshake_done(session, event == COAP_EVENT_DTLS_CONNECTED);
+    }
+#endif
+#ifdef CONFIG_APP_COAP_STATS
+    coapstats_event(session, event);
+#endif
+#ifdef CONFIG_APP_METRICS
+    metrics_event(session, event);
+#endif
+    (void)session;
+    (void)event;
+    return 0;
+}
+
+#if defined(CONFIG_APP_COAP_STATS) || defined(CONFIG_APP_METRICS)
+#define HAVE_SERVE
+/* The client's own resources (/stats, /metrics) are served from its
+ * context, on an endpoint of their own next to the client sessions */
+static void serve_init(coap_context_t *ctx) {
+    coap_address_t listen;
+
+#ifdef CONFIG_APP_COAP_STATS
+    coapstats_init(ctx);
+#endif
+#ifdef CONFIG_APP_METRICS
+    metrics_init(ctx);
+#endif
+    coap_address_init(&listen);
+    listen.addr.sin.sin_family = AF_INET;
+    listen.addr.sin.sin_addr.s_addr = htonl(INADDR_ANY);
+    listen.addr.sin.sin_port = htons(CONFIG_APP_SERVE_PORT);
+    listen.size = sizeof(struct sockaddr_in);
+    if (!coap_new_endpoint(ctx, &listen, COAP_PROTO_UDP)) {
+        LOG_ERR("Cannot listen on port %d", CONFIG_APP_SERVE_PORT);
+    }
+}
+
+/* They are only answered while libcoap's I/O loop runs, so keep it
+ * running a while once the client is done */
+static void serve_linger(coap_context_t *ctx) {
+    int64_t end = k_uptime_get() + CONFIG_APP_SERVE_LINGER_S * 1000LL;
+    int64_t now;
+
+    if (!ctx || CONFIG_APP_SERVE_LINGER_S <= 0) {
+        return;
+    }
+    LOG_INF("Serving on port %d for %d s", CONFIG_APP_SERVE_PORT,
+            CONFIG_APP_SERVE_LINGER_S);
+    while ((now = k_uptime_get()) < end) {
+        coap_io_process(ctx, (uint32_t)MIN(end - now, 1000));
+#ifdef CONFIG_APP_METRICS
+        metrics_poll();
+#endif
+    }
+}
+#endif
+
 int main(void) {
     coap_context_t *ctx = NULL;
     coap_session_t *session = NULL;
     coap_optlist_t *optlist = NULL;
-    coap_address_t dst;
+    MAIN_LOCAL coap_address_t dst;
     coap_pdu_t *pdu = NULL;
     int result = EXIT_FAILURE;
     int len;
     int res;
     unsigned int wait_ms;
-    coap_uri_t uri;
+    MAIN_LOCAL coap_uri_t uri;
     const char *coap_uri = COAP_CLIENT_URI;
-    int is_mcast;
 #define BUFSIZE 100
-    unsigned char scratch[BUFSIZE];
+    MAIN_LOCAL unsigned char scratch[BUFSIZE];
 
-    printf("=== CoAP Client Configuration ===\n");
-    printf("Target URI: %s\n", coap_uri);
-    printf("Server IP: %s\n", COAP_SERVER_IP);
-    printf("Server Path: %s\n", COAP_SERVER_PATH);
-    printf("Server Port: %d\n", COAP_SERVER_PORT);
+#ifdef CONFIG_APP_DIAGNOSTICS
+    LOG_INF("=== CoAP Client Configuration ===");
+    LOG_INF("Target URI: %s", coap_uri);
+    LOG_INF("Server IP: %s", COAP_SERVER_IP);
+    LOG_INF("Server Path: %s", COAP_SERVER_PATH);
+    LOG_INF("Server Port: %d", COAP_SERVER_PORT);
+#ifdef COAP_SERVER_ENDPOINTS
+    LOG_INF("Endpoints: %s", COAP_SERVER_ENDPOINTS);
+#endif
+#ifdef COAP_BACKUP_SERVER
+    LOG_INF("Backup Server: %s", COAP_BACKUP_SERVER);
+#endif
+#ifdef COAP_RESOURCE_TYPE
+    LOG_INF("Resource Type: %s (path from /.well-known/core)",
+            COAP_RESOURCE_TYPE);
+#endif
+#ifdef COAP_RD_EP
+    LOG_INF("RD Endpoint: %s (lifetime %u s)", COAP_RD_EP,
+            (unsigned)RD_LIFETIME_S);
+#endif
+#ifdef USE_TCP
+    LOG_INF("Transport: TCP (keepalive %d s)", COAP_TCP_KEEPALIVE_S);
+#elif CONFIG_APP_KEEPALIVE_S > 0
+    LOG_INF("Keepalive: ping after %d s idle", CONFIG_APP_KEEPALIVE_S);
+#endif
+#if CONFIG_APP_HOLD_S > 0
+    LOG_INF("Hold: session kept %d s after the response", CONFIG_APP_HOLD_S);
+#endif
+#ifdef CONFIG_APP_SIM_SERVER
+    LOG_INF("Virtual time: server stand-in on 127.0.0.1:%d",
+            COAP_SERVER_PORT);
+#endif
+#ifdef COAP_BULK
+    LOG_INF("Bulk Transfer: %s after the first response",
+            IS_ENABLED(BULK_UPLOAD) ? "uploads" : "downloads");
+#endif
+#ifdef COAP_PING_COUNT
+    LOG_INF("Ping Mode: %d probes every %d ms", COAP_PING_COUNT,
+            PING_INTERVAL_MS);
+#endif
+#ifdef COAP_SWARM_CLIENTS
+    LOG_INF("Swarm Mode: %d clients", COAP_SWARM_CLIENTS);
+#endif
+#ifdef COAP_SOAK_CYCLES
+    LOG_INF("Soak Mode: %d cycles", COAP_SOAK_CYCLES);
+#endif
 #ifdef USE_DTLS
-    printf("DTLS Mode: ENABLED\n");
+    LOG_INF("DTLS Mode: ENABLED");
 #else
-    printf("DTLS Mode: DISABLED\n");
+    LOG_INF("DTLS Mode: DISABLED");
+#endif
+    LOG_INF("================================");
 #endif
-    printf("================================\n\n");
 
-    printf("Starting CoAP client......\n");
+    LOG_INF("Starting CoAP client......");
+
+    /* libcoap's messages go to the app_libcoap log module */
+    coaplog_init();
 
     /* Initialize libcoap library */
     coap_startup();
 
+#ifdef CONFIG_APP_DIAGNOSTICS
     /* Verify which TLS backend is being used */
     verify_tls_backend();
+#endif
 
-    /* Set logging level */
-    coap_set_log_level(COAP_LOG_WARN);
+    instr_phase("startup");
 
     /* Parse the URI */
     len = coap_split_uri((const unsigned char *)coap_uri, strlen(coap_uri), &uri);
     if (len != 0) {
-        coap_log_warn("Failed to parse uri %s\n", coap_uri);
+        LOG_ERR("Failed to parse uri %s", coap_uri);
         goto finish;
     } else {
-        printf("URI parsed successfully......\n");
-        printf("Parsed - Scheme: %d, Host: %.*s, Port: %d, Path: %.*s\n", 
-               uri.scheme, (int)uri.host.length, uri.host.s,
-               uri.port, (int)uri.path.length, uri.path.s);
+        LOG_INF("URI parsed successfully......");
+        LOG_DBG("Parsed - Scheme: %d, Host: %.*s, Port: %d, Path: %.*s",
+                uri.scheme, (int)uri.host.length, uri.host.s,
+                uri.port, (int)uri.path.length, uri.path.s);
     }
 
+#ifdef CONFIG_WIFI
     wifi_init(NULL);
 
     /* WiFi connection with retries */
     int wifi_connected = 0;
     for (int attempt = 1; attempt <= 3 && !wifi_connected; attempt++) {
         if (attempt > 1) {
-            printf("WiFi retry attempt %d/3...\n", attempt);
+            LOG_WRN("WiFi retry attempt %d/3...", attempt);
         }
         
         int ret = connect_to_wifi();
         if (ret >= 0 && wait_for_wifi_connection() >= 0) {
             wifi_connected = 1;
         } else {
-            printf("WiFi connection attempt %d failed\n", attempt);
+            LOG_WRN("WiFi connection attempt %d failed", attempt);
             if (attempt < 3) {
                 wifi_disconnect();
                 k_sleep(K_MSEC(2000)); // Wait 2 seconds before retry
@@ -233,112 +649,312 @@ int main(void) {
     }
 
     if (!wifi_connected) {
-        printf("Failed to connect to WiFi after 3 attempts\n");
+        LOG_ERR("Failed to connect to WiFi after 3 attempts");
         goto finish;
     }
 
     /* Add delay to ensure network stack is ready */
     k_sleep(K_MSEC(1000));
+#endif
+    instr_phase("network");
+
+#ifdef CONFIG_APP_ASYNC
+    /* Tool mode: the requests go through lib/coapc and its own context */
+    if (async_run(coap_uri) == CONFIG_APP_ASYNC_REQUESTS) {
+        result = EXIT_SUCCESS;
+    }
+    async_report();
+    goto finish;
+#endif
+
+    LOG_INF("CoAP creating new context....");
+    /* create CoAP context and a client session */
+    if (!(ctx = coap_new_context(NULL))) {
+        LOG_ERR("cannot create libcoap context");
+        goto finish;
+    } else {
+        LOG_INF("CoAP context created......");
+    }
+
+    /* Support large responses */
+#ifdef COAP_RESOURCE_TYPE
+    /* Blocks are handed over one by one so discovery can parse the
+     * link-format as it arrives */
+    coap_context_set_block_mode(ctx, COAP_BLOCK_USE_LIBCOAP);
+#else
+    coap_context_set_block_mode(ctx, COAP_BLOCK_USE_LIBCOAP |
+                                         COAP_BLOCK_SINGLE_BODY);
+#endif
+
+#ifdef USE_TCP
+    /* Keep the connection for follow-up requests instead of closing it
+     * once idle; libcoap answers the server's pings itself */
+    coap_context_set_keepalive(ctx, COAP_TCP_KEEPALIVE_S);
+#elif CONFIG_APP_KEEPALIVE_S > 0
+    /* Ping once the session has been idle this long, so the NAT binding
+     * and the server's session state outlive the gaps between requests */
+    coap_context_set_keepalive(ctx, CONFIG_APP_KEEPALIVE_S);
+#endif
+
+#ifdef HAVE_PING_REPLY
+    coap_register_pong_handler(ctx, pong_handler);
+#endif
+#if defined(HAVE_PING_REPLY) || defined(CONFIG_APP_COAP_STATS)
+    coap_register_nack_handler(ctx, nack_handler);
+#endif
+#if defined(HAVE_SERVE) || defined(HAVE_HANDSHAKE_TIMES)
+    /* Before any session, so none of their events is missed */
+    coap_register_event_handler(ctx, client_event);
+#endif
+#ifdef HAVE_SERVE
+    serve_init(ctx);
+#endif
+#ifdef CONFIG_APP_SIM_SERVER
+    /* Before any session, which would connect to it */
+    if (!simserver_init(ctx)) {
+        goto finish;
+    }
+#endif
+    instr_phase("context");
 
+#ifdef COAP_SERVER_ENDPOINTS
+    /* Probe every configured endpoint and reuse the session of the best */
+    if (endpoints_init(ctx, COAP_SERVER_ENDPOINTS, COAP_SERVER_PORT) <= 0) {
+        LOG_ERR("No usable endpoint");
+        goto finish;
+    }
+    int selected = endpoints_warmup(ctx, ENDPOINT_WARMUP_ROUNDS);
+    if (selected < 0) {
+        LOG_ERR("No endpoint answered the probes");
+        goto finish;
+    }
+    memcpy(&dst, endpoints_address(selected), sizeof(dst));
+    session = coap_session_reference(endpoints_session(selected));
+#else
     /* Extract host string from URI for address setup */
-    char host_str[64];
+    MAIN_LOCAL char host_str[64];
     if (uri.host.length < sizeof(host_str)) {
         memcpy(host_str, uri.host.s, uri.host.length);
         host_str[uri.host.length] = '\0';
     } else {
-        printf("Host string too long\n");
+        LOG_ERR("Host string too long");
         goto finish;
     }
 
     /* Setup destination address with correct size */
     uint16_t port = uri.port ? uri.port : COAP_SERVER_PORT;
     if (!setup_destination_address(&dst, host_str, port)) {
-        printf("Failed to setup destination address\n");
+        LOG_ERR("Failed to setup destination address");
         goto finish;
     } else {
-        printf("Address resolved......\n");
+        LOG_INF("Address resolved......");
     }
 
-    is_mcast = 0;
-    printf("CoAP creating new context....\n");
-    /* create CoAP context and a client session */
-    if (!(ctx = coap_new_context(NULL))) {
-        coap_log_emerg("cannot create libcoap context\n");
-        goto finish;
-    } else {
-        printf("CoAP context created......\n");
+    /* A group address turns the request into a NON multicast query */
+    is_mcast = coap_is_mcast(&dst);
+
+#ifdef COAP_SWARM_CLIENTS
+    /* Tool mode: many clients with a session each instead of this one */
+    coap_register_response_handler(ctx, response_handler);
+    if (swarm_run(ctx, &dst, &uri) > 0) {
+        result = EXIT_SUCCESS;
     }
+    swarm_report();
+    goto finish;
+#endif
 
-    /* Support large responses */
-    coap_context_set_block_mode(ctx, COAP_BLOCK_USE_LIBCOAP |
-                                         COAP_BLOCK_SINGLE_BODY);
+#ifdef COAP_SOAK_CYCLES
+    /* Tool mode: the request over and over, sessions opened by the run */
+    coap_register_response_handler(ctx, response_handler);
+    if (soak_run(ctx, &dst, &uri)) {
+        result = EXIT_SUCCESS;
+    }
+    soak_report();
+    goto finish;
+#endif
 
     /* Create session based on URI scheme */
-    if (uri.scheme == COAP_URI_SCHEME_COAP) {
-        session = coap_new_client_session(ctx, NULL, &dst, COAP_PROTO_UDP);
-    } else if (uri.scheme == COAP_URI_SCHEME_COAP_TCP) {
-        session = coap_new_client_session(ctx, NULL, &dst, COAP_PROTO_TCP);
-#ifdef USE_DTLS
-    } else if (uri.scheme == COAP_URI_SCHEME_COAPS) {
-        /* DTLS session with minimal PKI (no cert verification) */
-        coap_dtls_pki_t *dtls_pki = setup_minimal_pki();
-        session = coap_new_client_session_pki(ctx, NULL, &dst, COAP_PROTO_DTLS, dtls_pki);
+    session = open_session(ctx, &dst);
 #endif
-    }
     if (!session) {
-        coap_log_emerg("cannot create client session\n");
+        LOG_ERR("cannot create client session");
         goto finish;
     } else {
-        printf("CoAP session created......\n");
+        LOG_INF("CoAP session created......");
+    }
+    instr_phase("session");
+
+#ifdef COAP_BACKUP_SERVER
+    /* Warm up the standby before the request so failover skips the
+     * handshake */
+    if (!failover_init(ctx, COAP_BACKUP_SERVER, COAP_SERVER_PORT)) {
+        goto finish;
     }
+    failover_arm(session);
+#endif
 
     coap_register_response_handler(ctx, response_handler);
 
+#ifdef COAP_PING_COUNT
+    /* Tool mode: measure the path to the server instead of the request */
+    if (ping_run(ctx, session, COAP_PING_COUNT, &uri) > 0) {
+        result = EXIT_SUCCESS;
+    }
+    ping_report();
+    goto finish;
+#endif
+
+#ifdef COAP_RD_EP
+    /* Full registration only when no location is known, an empty update
+     * otherwise */
+    rd_init(COAP_RD_EP);
+    if (!rd_update(ctx, session)) {
+        LOG_WRN("RD registration not confirmed, continuing");
+    }
+#endif
+
+#ifdef COAP_RESOURCE_TYPE
+    /* Resolve the target path by resource type, from the cached index when
+     * it is still valid and from the server otherwise */
+    MAIN_LOCAL char index_key[24];
+    snprintf(index_key, sizeof(index_key), "%s:%u", COAP_SERVER_IP,
+             (unsigned)(uri.port ? uri.port : COAP_SERVER_PORT));
+    discovery_init(index_key);
+    int index_cached = discovery_valid();
+    if (index_cached) {
+        LOG_INF("Using cached discovery index");
+    } else if (!discovery_fetch(ctx, session)) {
+        goto finish;
+    }
+    discovery_report();
+
+    const struct discovery_entry *entry = discovery_lookup_rt(COAP_RESOURCE_TYPE);
+    if (!entry && index_cached) {
+        /* The resource may have moved or been added since the fetch */
+        LOG_INF("No rt=%s in the cached index, fetching it again",
+                COAP_RESOURCE_TYPE);
+        discovery_invalidate();
+        if (!discovery_fetch(ctx, session)) {
+            goto finish;
+        }
+        discovery_report();
+        entry = discovery_lookup_rt(COAP_RESOURCE_TYPE);
+    }
+    if (!entry) {
+        LOG_ERR("No resource with rt=%s", COAP_RESOURCE_TYPE);
+        goto finish;
+    }
+    LOG_INF("rt=%s resolved to %s", COAP_RESOURCE_TYPE, entry->path);
+    uri.path.s = (const uint8_t *)entry->path + 1;
+    uri.path.length = strlen(entry->path) - 1;
+#endif
+
+    if (is_mcast) {
+        LOG_INF("Multicast request: collecting responses");
+#ifdef COAP_MCAST_LEISURE_MS
+        coap_fixed_point_t leisure = {COAP_MCAST_LEISURE_MS / 1000,
+                                      COAP_MCAST_LEISURE_MS % 1000};
+        coap_session_set_default_leisure(session, leisure);
+#endif
+    }
+
     /* construct CoAP message */
+    REQTRACE("pdu_build_begin", 0, 0);
     pdu = coap_pdu_init(is_mcast ? COAP_MESSAGE_NON : COAP_MESSAGE_CON,
                         COAP_REQUEST_CODE_GET, coap_new_message_id(session),
                         coap_session_max_pdu_size(session));
     if (!pdu) {
-        coap_log_emerg("cannot create PDU\n");
+        LOG_ERR("cannot create PDU");
         goto finish;
     }
 
-    /* Add option list (which will be sorted) to the PDU */
+    /* Add option list (which will be sorted) to the PDU. With an endpoint
+     * list the URI host is not the server we talk to, so leave out
+     * Uri-Host/Uri-Port. */
+#ifdef COAP_SERVER_ENDPOINTS
+    len = coap_uri_into_options(&uri, &dst, &optlist, 0, scratch,
+                                sizeof(scratch));
+#else
     len = coap_uri_into_options(&uri, &dst, &optlist, 1, scratch,
                                 sizeof(scratch));
+#endif
     if (len) {
-        coap_log_warn("Failed to create options\n");
+        LOG_ERR("Failed to create options");
         goto finish;
     }
 
     if (optlist) {
         res = coap_add_optlist_pdu(pdu, &optlist);
         if (res != 1) {
-            coap_log_warn("Failed to add options to PDU\n");
+            LOG_ERR("Failed to add options to PDU");
             goto finish;
         }
     }
 
-    coap_show_pdu(COAP_LOG_WARN, pdu);
+    REQTRACE("pdu_build_end", coap_pdu_get_mid(pdu), 0);
+    COAPLOG_PDU(pdu);
+
+    if (is_mcast) {
+        mcast_reset();
+    }
 
-    printf("About to send CoAP packet...\n");
+    LOG_DBG("About to send CoAP packet...");
     /* and send the PDU */
+    sent_cycles = k_cycle_get_32();
     if (coap_send(session, pdu) == COAP_INVALID_MID) {
-        coap_log_err("cannot send CoAP pdu\n");
+        LOG_ERR("cannot send CoAP pdu");
         goto finish;
     } else {
-        printf("CoAP packet sent successfully!\n");
+        LOG_DBG("CoAP packet sent successfully!");
     }
+    instr_phase("request");
 
     wait_ms = (coap_session_get_default_leisure(session).integer_part + 1) * 1000;
+    if (is_mcast) {
+        /* Answers are spread over the leisure window, no extra second */
+        coap_fixed_point_t leisure = coap_session_get_default_leisure(session);
+        wait_ms = leisure.integer_part * 1000 + leisure.fractional_part;
+    }
+#ifdef COAP_BACKUP_SERVER
+    /* Let the primary exhaust its retransmissions and the standby retry */
+    wait_ms += 2 * FAILOVER_TRANSMIT_WAIT_MS;
+#endif
 
-    printf("Waiting for response...\n");
+    LOG_DBG("Waiting for response...");
     while (have_response == 0 || is_mcast) {
         res = coap_io_process(ctx, 500);
+#ifdef CONFIG_APP_METRICS
+        metrics_poll();
+#endif
+#ifdef COAP_SERVER_ENDPOINTS
+        endpoints_poll();
+#endif
+#ifdef COAP_RD_EP
+        rd_poll(session);
+#endif
+#ifdef COAP_MCAST_EXPECTED
+        /* Discovery fast path: stop once every expected node answered */
+        if (is_mcast && mcast_responders() >= COAP_MCAST_EXPECTED) {
+            LOG_INF("All %d expected responders answered",
+                    COAP_MCAST_EXPECTED);
+            break;
+        }
+#endif
+#ifdef COAP_BACKUP_SERVER
+        failover_poll();
+        if (failover_exhausted()) {
+            LOG_WRN("Standby gave up as well");
+            break;
+        }
+#endif
         if (res >= 0) {
             if (wait_ms > 0) {
                 if ((unsigned)res >= wait_ms) {
-                    printf("TIMEOUT: No response received\n");
+                    if (is_mcast) {
+                        LOG_INF("Leisure window over");
+                    } else {
+                        LOG_ERR("TIMEOUT: No response received");
+                    }
                     break;
                 } else {
                     wait_ms -= res;
@@ -347,20 +963,91 @@ int main(void) {
         }
     }
 
+    if (is_mcast) {
+        mcast_report();
+    }
+    instr_phase("response");
+
     if (have_response != 0) {
-        printf("SUCCESS: Response received!\n");
+        LOG_INF("SUCCESS: Response received!");
+        if (!is_mcast) {
+            LOG_INF("Send to response: %u us", (unsigned)response_us);
+        }
+#ifdef COAP_SERVER_ENDPOINTS
+        /* Follow-up requests go to the endpoint selected now: the probes
+         * of the wait may have moved it */
+        if (endpoints_session(endpoints_select()) != session) {
+            coap_session_release(session);
+            session = coap_session_reference(
+                endpoints_session(endpoints_select()));
+        }
+#endif
+#ifdef COAP_BULK
+        /* Same resource again over the open session */
+        bulk_run(ctx, session, &optlist);
+        bulk_report();
+#endif
+#if CONFIG_APP_HOLD_S > 0
+        hold_run(ctx, session, &optlist);
+        hold_report();
+#endif
         result = EXIT_SUCCESS;
         goto finish;
     } else {
-        printf("FAILED: No response received\n");
+        LOG_ERR("FAILED: No response received");
     }
 
     result = EXIT_SUCCESS;
 finish:
-    printf("Cleaning up resources...\n");
+    instr_phase("finish");
+#ifdef HAVE_SERVE
+    serve_linger(ctx);
+#endif
+#ifdef CONFIG_APP_COAP_STATS
+    coapstats_report();
+#endif
+#ifdef CONFIG_APP_SIM_SERVER
+    simserver_report();
+#endif
+#ifdef CONFIG_APP_HISTOGRAMS
+    hist_report();
+#endif
+    LOG_INF("Cleaning up resources...");
+#ifdef COAP_SERVER_ENDPOINTS
+    endpoints_report();
+    endpoints_cleanup();
+#endif
+#ifdef COAP_BACKUP_SERVER
+    failover_report();
+    failover_cleanup();
+#endif
+#ifdef COAP_RESOURCE_TYPE
+    discovery_save();
+#endif
+#ifdef COAP_RD_EP
+    rd_report();
+#endif
     cleanup_resources(ctx, session, optlist);
+    instr_phase("cleanup");
+    instr_phase_report();
+#ifdef CONFIG_THREAD_ANALYZER
+    /* The other threads: system workqueue, network and Wi-Fi */
+    thread_analyzer_print(0);
+#endif
+#ifdef CONFIG_APP_COAP_POOLS
+    /* After cleanup, so blocks still in use are leaks */
+    mempool_report();
+#endif
+#ifdef CONFIG_WIFI
     wifi_disconnect();
+#endif
     printf("CLIENT FINISHED.\n");
 
+#ifdef CONFIG_ARCH_POSIX
+    /* Write out the messages still queued for the log thread, then stop:
+     * native_sim keeps running after main() returns */
+    LOG_PANIC();
+    posix_exit(result);
+#endif
     return result;
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+/*
+ * mbedtls/src/mcast.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Multicast response aggregation for CoAP client.
+ *
+ * A NON request to a multicast group is answered by every server in it
+ * within the leisure window. Printing each answer over the UART as it
+ * arrives would stall the receive path, so responses are only recorded
+ * here, one slot per source address, and summarised once the window is
+ * over.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include "mcast.h"
+
+struct responder {
+    coap_address_t addr;
+    uint32_t latency_ms;
+    coap_pdu_code_t code;
+    uint16_t count;
+    uint16_t total_len;
+    uint8_t data_len;
+    uint8_t data[MCAST_DATA_MAX];
+};
+
+static struct responder responders[MCAST_MAX_RESPONDERS];
+static int responder_count;
+static uint32_t overflow;
+static int64_t start_ms;
+
+void mcast_reset(void) {
+    memset(responders, 0, sizeof(responders));
+    responder_count = 0;
+    overflow = 0;
+    start_ms = k_uptime_get();
+}
+
+void mcast_collect(coap_session_t *session, const coap_pdu_t *received) {
+    const coap_address_t *remote = coap_session_get_addr_remote(session);
+    struct responder *r = NULL;
+    const uint8_t *databuf;
+    size_t len, offset, total;
+
+    for (int i = 0; i < responder_count; i++) {
+        if (coap_address_equals(&responders[i].addr, remote)) {
+            r = &responders[i];
+            break;
+        }
+    }
+
+    if (r) {
+        /* Retransmitted or repeated answer from a known server */
+        if (r->count < UINT16_MAX) {
+            r->count++;
+        }
+        return;
+    }
+
+    if (responder_count == MCAST_MAX_RESPONDERS) {
+        overflow++;
+        return;
+    }
+
+    r = &responders[responder_count++];
+    coap_address_copy(&r->addr, remote);
+    r->latency_ms = (uint32_t)(k_uptime_get() - start_ms);
+    r->code = coap_pdu_get_code(received);
+    r->count = 1;
+
+    if (coap_get_data_large(received, &len, &databuf, &offset, &total)) {
+        r->total_len = total > UINT16_MAX ? UINT16_MAX : (uint16_t)total;
+        r->data_len = len > MCAST_DATA_MAX ? MCAST_DATA_MAX : (uint8_t)len;
+        memcpy(r->data, databuf, r->data_len);
+    }
+}
+
+int mcast_responders(void) {
+    return responder_count;
+}
+
+void mcast_report(void) {
+    printf("\n=== MULTICAST RESPONSES ===\n");
+    printf("%-3s | %-21s | %-4s | %-7s | %-5s | %-5s | %s\n", "Num", "Source",
+           "Code", "Time ms", "Count", "Bytes", "Data");
+
+    for (int i = 0; i < responder_count; i++) {
+        const struct responder *r = &responders[i];
+        unsigned char addr_str[64];
+        size_t addr_len;
+
+        addr_len = coap_print_addr(&r->addr, addr_str, sizeof(addr_str) - 1);
+        addr_str[addr_len] = '\0';
+
+        printf("%-3d | %-21s | %d.%02d | %-7u | %-5u | %-5u | ", i + 1,
+               addr_str, COAP_RESPONSE_CLASS(r->code), r->code & 0x1F,
+               (unsigned)r->latency_ms, r->count, r->total_len);
+        for (int j = 0; j < r->data_len; j++) {
+            putchar(r->data[j] >= 0x20 && r->data[j] < 0x7f ? r->data[j]
+                                                            : '.');
+        }
+        printf("%s\n", r->data_len < r->total_len ? "..." : "");
+    }
+
+    if (overflow) {
+        printf("(%u more responders not recorded)\n", (unsigned)overflow);
+    }
+    printf("Responders: %d\n", responder_count);
+    printf("=== END MULTICAST RESPONSES ===\n");
+}
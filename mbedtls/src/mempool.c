@@ -0,0 +1,237 @@
+/*
+ * mbedtls/src/mempool.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Fixed-size memory pools behind libcoap's coap_malloc_type().
+ *
+ * libcoap tags every allocation with its memory type. With
+ * CONFIG_APP_COAP_POOLS the linker redirects coap_malloc_type(),
+ * coap_realloc_type() and coap_free_type() here (--wrap), and the types
+ * that churn with traffic (sessions, PDUs and their buffers, queue
+ * nodes, block-wise state, option lists, strings) come from one
+ * k_mem_slab each, sized from the configured number of sessions. Those
+ * allocations are O(1), cannot fragment the heap, and when a pool runs
+ * dry the failure is counted against that pool instead of showing up
+ * later as an unrelated heap failure. Types allocated once at startup
+ * (context, endpoints, DTLS context) stay on the heap, which is libcoap's
+ * own heap with CONFIG_APP_HEAPS.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "mempool.h"
+#ifdef CONFIG_APP_HEAPS
+#include "heaps.h"
+#endif
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+#define SESSIONS CONFIG_APP_COAP_POOL_SESSIONS
+#define PDUS (SESSIONS * CONFIG_APP_COAP_POOL_PDUS)
+
+struct pool {
+    const char *name;
+    struct k_mem_slab slab;
+    char *buffer;
+    size_t block_size;
+    uint32_t num_blocks;
+    uint32_t used;
+    uint32_t peak;
+    uint32_t failures;
+    uint32_t oversize;
+};
+
+enum {
+    POOL_SESSION,
+    POOL_DTLS_SESSION,
+    POOL_PDU,
+    POOL_PDU_BUF,
+    POOL_NODE,
+    POOL_LG,
+    POOL_OPTLIST,
+    POOL_STRING,
+    POOL_COUNT,
+};
+
+#define POOL_BUFFER(name, size, count) \
+    static char __aligned(8) name##_buffer[ROUND_UP(size, 8) * (count)]
+
+#define POOL(label, buf, size, count)                                    \
+    {                                                                    \
+        .name = label, .buffer = buf##_buffer,                           \
+        .block_size = ROUND_UP(size, 8), .num_blocks = (count)           \
+    }
+
+POOL_BUFFER(session, MEMPOOL_SESSION_SIZE, SESSIONS);
+POOL_BUFFER(dtls_session, MEMPOOL_DTLS_SESSION_SIZE, SESSIONS);
+POOL_BUFFER(pdu, MEMPOOL_PDU_SIZE, PDUS);
+POOL_BUFFER(pdu_buf, MEMPOOL_PDU_BUF_SIZE, PDUS);
+POOL_BUFFER(node, MEMPOOL_NODE_SIZE, PDUS);
+/* One block-wise transfer in each direction per session */
+POOL_BUFFER(lg, MEMPOOL_LG_SIZE, 2 * SESSIONS);
+POOL_BUFFER(optlist, MEMPOOL_OPTLIST_SIZE, CONFIG_APP_COAP_POOL_OPTIONS);
+POOL_BUFFER(string, MEMPOOL_STRING_SIZE, CONFIG_APP_COAP_POOL_STRINGS);
+
+static struct pool pools[POOL_COUNT] = {
+    [POOL_SESSION] = POOL("session", session, MEMPOOL_SESSION_SIZE, SESSIONS),
+    [POOL_DTLS_SESSION] = POOL("dtls", dtls_session,
+                               MEMPOOL_DTLS_SESSION_SIZE, SESSIONS),
+    [POOL_PDU] = POOL("pdu", pdu, MEMPOOL_PDU_SIZE, PDUS),
+    [POOL_PDU_BUF] = POOL("pdu buffer", pdu_buf, MEMPOOL_PDU_BUF_SIZE, PDUS),
+    [POOL_NODE] = POOL("queue node", node, MEMPOOL_NODE_SIZE, PDUS),
+    [POOL_LG] = POOL("block-wise", lg, MEMPOOL_LG_SIZE, 2 * SESSIONS),
+    [POOL_OPTLIST] = POOL("option", optlist, MEMPOOL_OPTLIST_SIZE,
+                          CONFIG_APP_COAP_POOL_OPTIONS),
+    [POOL_STRING] = POOL("string", string, MEMPOOL_STRING_SIZE,
+                         CONFIG_APP_COAP_POOL_STRINGS),
+};
+
+#ifdef CONFIG_APP_HEAPS
+#define heap_malloc(type, size) heaps_coap_malloc(size)
+#define heap_realloc(type, p, size) heaps_coap_realloc(p, size)
+#define heap_free(type, p) heaps_coap_free(p)
+#else
+/* libcoap's own implementations, for the types left on the heap */
+void *__real_coap_malloc_type(coap_memory_tag_t type, size_t size);
+void *__real_coap_realloc_type(coap_memory_tag_t type, void *p, size_t size);
+void __real_coap_free_type(coap_memory_tag_t type, void *p);
+
+#define heap_malloc __real_coap_malloc_type
+#define heap_realloc __real_coap_realloc_type
+#define heap_free __real_coap_free_type
+#endif
+
+static struct pool *pool_of_type(coap_memory_tag_t type) {
+    switch (type) {
+    case COAP_SESSION:
+        return &pools[POOL_SESSION];
+    case COAP_DTLS_SESSION:
+        return &pools[POOL_DTLS_SESSION];
+    case COAP_PDU:
+        return &pools[POOL_PDU];
+    case COAP_PDU_BUF:
+        return &pools[POOL_PDU_BUF];
+    case COAP_NODE:
+        return &pools[POOL_NODE];
+    case COAP_LG_XMIT:
+    case COAP_LG_CRCV:
+        return &pools[POOL_LG];
+    case COAP_OPTLIST:
+        return &pools[POOL_OPTLIST];
+    case COAP_STRING:
+        return &pools[POOL_STRING];
+    default:
+        return NULL;
+    }
+}
+
+/* Oversize requests live on the heap, so the pool is found by address */
+static struct pool *pool_of_block(const void *p) {
+    for (int i = 0; i < POOL_COUNT; i++) {
+        const char *start = pools[i].buffer;
+
+        if ((const char *)p >= start &&
+            (const char *)p < start + pools[i].block_size * pools[i].num_blocks) {
+            return &pools[i];
+        }
+    }
+    return NULL;
+}
+
+void *__wrap_coap_malloc_type(coap_memory_tag_t type, size_t size) {
+    struct pool *pool = pool_of_type(type);
+    void *block;
+
+    if (!pool) {
+        return heap_malloc(type, size);
+    }
+    if (size > pool->block_size) {
+        if (!pool->oversize++) {
+            LOG_WRN("Pool %s: %u bytes requested, blocks are %u, using the "
+                    "heap", pool->name, (unsigned)size,
+                    (unsigned)pool->block_size);
+        }
+        return heap_malloc(type, size);
+    }
+    if (k_mem_slab_alloc(&pool->slab, &block, K_NO_WAIT) != 0) {
+        if (!pool->failures++) {
+            LOG_WRN("Pool %s: all %u blocks in use", pool->name,
+                    (unsigned)pool->num_blocks);
+        }
+        return NULL;
+    }
+    if (++pool->used > pool->peak) {
+        pool->peak = pool->used;
+    }
+    return block;
+}
+
+void __wrap_coap_free_type(coap_memory_tag_t type, void *p) {
+    struct pool *pool = p ? pool_of_block(p) : NULL;
+
+    if (!pool) {
+        heap_free(type, p);
+        return;
+    }
+    k_mem_slab_free(&pool->slab, p);
+    pool->used--;
+}
+
+/* PDU buffers grow as options and payload are added */
+void *__wrap_coap_realloc_type(coap_memory_tag_t type, void *p, size_t size) {
+    struct pool *pool = p ? pool_of_block(p) : NULL;
+    void *moved;
+
+    if (!p) {
+        return __wrap_coap_malloc_type(type, size);
+    }
+    if (!pool) {
+        return heap_realloc(type, p, size);
+    }
+    if (size == 0) {
+        __wrap_coap_free_type(type, p);
+        return NULL;
+    }
+    if (size <= pool->block_size) {
+        return p;
+    }
+    moved = __wrap_coap_malloc_type(type, size);
+    if (moved) {
+        memcpy(moved, p, pool->block_size);
+        __wrap_coap_free_type(type, p);
+    }
+    return moved;
+}
+
+static int mempool_init(void) {
+    for (int i = 0; i < POOL_COUNT; i++) {
+        k_mem_slab_init(&pools[i].slab, pools[i].buffer, pools[i].block_size,
+                        pools[i].num_blocks);
+    }
+    return 0;
+}
+
+SYS_INIT(mempool_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+void mempool_report(void) {
+    size_t reserved = 0;
+
+    printf("\n=== MEMORY POOLS ===\n");
+    for (int i = 0; i < POOL_COUNT; i++) {
+        const struct pool *pool = &pools[i];
+
+        reserved += pool->block_size * pool->num_blocks;
+        printf("%-10s %4u x %4u bytes: %u in use, peak %u, %u failed, "
+               "%u oversize\n", pool->name, (unsigned)pool->num_blocks,
+               (unsigned)pool->block_size, (unsigned)pool->used,
+               (unsigned)pool->peak, (unsigned)pool->failures,
+               (unsigned)pool->oversize);
+    }
+    printf("Reserved: %u bytes for %d sessions\n", (unsigned)reserved,
+           SESSIONS);
+    printf("=== END MEMORY POOLS ===\n");
+}
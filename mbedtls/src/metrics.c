@@ -0,0 +1,196 @@
+/*
+ * mbedtls/src/metrics.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Device metrics as an Observable CBOR resource at /metrics.
+ *
+ * Monitoring pulls from the device, so the client serves its own
+ * numbers from its libcoap context (see serve_init() in main.c): the
+ * latency histograms of hist.c, the malloc() heap (and the libcoap/TLS
+ * heaps with CONFIG_APP_HEAPS), DTLS/TLS handshakes and the Wi-Fi
+ * association time, the closest the Wi-Fi driver gets to radio-on time.
+ * Recording is a counter increment; the document is only encoded
+ * (zcbor) when a GET or a notification asks for it, into a static
+ * buffer, so nothing is allocated and nothing is done on the request
+ * path that a scrape could make slower. Observers get a notification at
+ * most every CONFIG_APP_METRICS_NOTIFY_S seconds.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zcbor_encode.h>
+#include "hist.h"
+#include "instr.h"
+#include "metrics.h"
+#ifdef CONFIG_APP_HEAPS
+#include "heaps.h"
+#endif
+#ifdef CONFIG_WIFI
+#include "wifi.h"
+#endif
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+static uint32_t handshakes;
+static uint32_t handshake_failures;
+
+static coap_resource_t *resource;
+static int64_t notified_ms;
+/* Rebuilt for every GET and notification */
+static uint8_t doc[METRICS_DOC_SIZE];
+
+int metrics_event(coap_session_t *session, const coap_event_t event) {
+    /* Not the sessions of whoever is scraping */
+    if (coap_session_get_type(session) != COAP_SESSION_TYPE_CLIENT) {
+        return 0;
+    }
+    switch (event) {
+    case COAP_EVENT_DTLS_CONNECTED:
+        handshakes++;
+        break;
+    case COAP_EVENT_DTLS_ERROR:
+        handshake_failures++;
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+void metrics_poll(void) {
+    int64_t now = k_uptime_get();
+
+    if (resource &&
+        now - notified_ms >= CONFIG_APP_METRICS_NOTIFY_S * 1000LL) {
+        notified_ms = now;
+        /* Only marks the resource; libcoap sends from coap_io_process() */
+        coap_resource_notify_observers(resource, NULL);
+    }
+}
+
+/* Percentiles to read at a glance, and the snapshot (see hist.h) for
+ * merging the histograms of many devices */
+static bool encode_latency(zcbor_state_t *zs) {
+    static uint8_t snap[HIST_SNAPSHOT_MAX];
+    bool ok;
+
+    ok = zcbor_tstr_put_lit(zs, "latency_us") &&
+         zcbor_map_start_encode(zs, HIST_COUNT);
+    for (int id = 0; ok && id < HIST_COUNT; id++) {
+        const struct hist *h = hist_get(id);
+        size_t len;
+
+        if (!h->count) {
+            continue;
+        }
+        len = hist_snapshot(id, snap, sizeof(snap));
+        ok = zcbor_tstr_put_term(zs, hist_name(id), 16) &&
+             zcbor_map_start_encode(zs, 6) &&
+             zcbor_tstr_put_lit(zs, "count") &&
+             zcbor_uint32_put(zs, h->count) &&
+             zcbor_tstr_put_lit(zs, "p50") &&
+             zcbor_uint32_put(zs, hist_percentile(h, 500)) &&
+             zcbor_tstr_put_lit(zs, "p90") &&
+             zcbor_uint32_put(zs, hist_percentile(h, 900)) &&
+             zcbor_tstr_put_lit(zs, "p99") &&
+             zcbor_uint32_put(zs, hist_percentile(h, 990)) &&
+             zcbor_tstr_put_lit(zs, "max") &&
+             zcbor_uint32_put(zs, h->max) &&
+             zcbor_tstr_put_lit(zs, "hist") &&
+             zcbor_bstr_encode_ptr(zs, (const char *)snap, len) &&
+             zcbor_map_end_encode(zs, 6);
+    }
+    return ok && zcbor_map_end_encode(zs, HIST_COUNT);
+}
+
+static bool encode_heap(zcbor_state_t *zs) {
+    struct instr_heap heap;
+    bool ok;
+
+    instr_heap_get(&heap);
+    ok = zcbor_tstr_put_lit(zs, "heap") &&
+         zcbor_map_start_encode(zs, 3) &&
+         zcbor_tstr_put_lit(zs, "used") &&
+         zcbor_uint32_put(zs, heap.used) &&
+         zcbor_tstr_put_lit(zs, "peak") &&
+         zcbor_uint32_put(zs, heap.peak) &&
+         zcbor_tstr_put_lit(zs, "free") &&
+         zcbor_uint32_put(zs, heap.free) &&
+         zcbor_map_end_encode(zs, 3);
+#ifdef CONFIG_APP_HEAPS
+    ok = ok && zcbor_tstr_put_lit(zs, "heaps") &&
+         zcbor_map_start_encode(zs, HEAPS_COUNT);
+    for (int h = 0; ok && h < HEAPS_COUNT; h++) {
+        struct heaps_counters c;
+
+        heaps_get(h, &c);
+        ok = zcbor_tstr_put_term(zs, heaps_name(h), 16) &&
+             zcbor_map_start_encode(zs, 4) &&
+             zcbor_tstr_put_lit(zs, "used") &&
+             zcbor_uint32_put(zs, c.current) &&
+             zcbor_tstr_put_lit(zs, "peak") &&
+             zcbor_uint32_put(zs, c.peak) &&
+             zcbor_tstr_put_lit(zs, "size") &&
+             zcbor_uint32_put(zs, c.size) &&
+             zcbor_tstr_put_lit(zs, "failures") &&
+             zcbor_uint32_put(zs, c.failures) &&
+             zcbor_map_end_encode(zs, 4);
+    }
+    ok = ok && zcbor_map_end_encode(zs, HEAPS_COUNT);
+#endif
+    return ok;
+}
+
+/* The document into doc; 0 when it does not fit */
+static size_t serialise(void) {
+    ZCBOR_STATE_E(zs, 4, doc, sizeof(doc), 1);
+    bool ok;
+
+    ok = zcbor_map_start_encode(zs, 6) &&
+         zcbor_tstr_put_lit(zs, "uptime_ms") &&
+         zcbor_uint64_put(zs, k_uptime_get()) &&
+         encode_latency(zs) &&
+         encode_heap(zs) &&
+         zcbor_tstr_put_lit(zs, "handshakes") &&
+         zcbor_map_start_encode(zs, 2) &&
+         zcbor_tstr_put_lit(zs, "ok") &&
+         zcbor_uint32_put(zs, handshakes) &&
+         zcbor_tstr_put_lit(zs, "failed") &&
+         zcbor_uint32_put(zs, handshake_failures) &&
+         zcbor_map_end_encode(zs, 2);
+#ifdef CONFIG_WIFI
+    ok = ok && zcbor_tstr_put_lit(zs, "radio_ms") &&
+         zcbor_uint32_put(zs, wifi_radio_ms());
+#endif
+    ok = ok && zcbor_map_end_encode(zs, 6);
+    return ok ? (size_t)(zs->payload - doc) : 0;
+}
+
+static void metrics_get(coap_resource_t *r, coap_session_t *session,
+                        const coap_pdu_t *request, const coap_string_t *query,
+                        coap_pdu_t *response) {
+    size_t len = serialise();
+
+    if (!len) {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_INTERNAL_ERROR);
+        return;
+    }
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CONTENT);
+    coap_add_data_large_response(r, session, request, response, query,
+                                 COAP_MEDIATYPE_APPLICATION_CBOR, -1, 0, len,
+                                 doc, NULL, NULL);
+}
+
+void metrics_init(coap_context_t *ctx) {
+    resource = coap_resource_init(coap_make_str_const("metrics"), 0);
+    if (!resource) {
+        LOG_ERR("Cannot create the /metrics resource");
+        return;
+    }
+    coap_register_request_handler(resource, COAP_REQUEST_GET, metrics_get);
+    coap_resource_set_get_observable(resource, 1);
+    coap_add_resource(ctx, resource);
+    notified_ms = k_uptime_get();
+}
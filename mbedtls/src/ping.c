@@ -0,0 +1,363 @@
+/*
+ * mbedtls/src/ping.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * coap-ping: RTT and loss measurement over the client session.
+ *
+ * Probes are CoAP pings (an empty CON answered with RST over UDP/DTLS, a
+ * Ping signal answered with Pong over TCP/TLS) or, with PING_USE_GET,
+ * GETs of the target path so that server processing is included. They go
+ * out at a fixed interval like ping(8), and RTTs are taken from the cycle
+ * counter since uptime only has tick resolution. Over TCP/TLS several
+ * are in flight at once. Over UDP/DTLS libcoap holds back every CON after
+ * the first until it is answered (NSTART 1), which would add its queueing
+ * time to the RTT. A probe there waits until the previous one is answered
+ * and, when that one was counted as lost, until libcoap has given up
+ * retransmitting it as well, so it is timed from when it is really sent.
+ * The ping session retransmits once to keep that wait short.
+ *
+ * The default timeout equals libcoap's ACK_TIMEOUT of 2 s, the shortest
+ * wait before a retransmission once ACK_RANDOM_FACTOR is applied, so a
+ * probe is counted as lost no later than libcoap would retransmit it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "hist.h"
+#include "ping.h"
+#ifdef CONFIG_APP_METRICS
+#include "metrics.h"
+#endif
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+struct probe {
+    int seq;
+    int active;
+    coap_mid_t mid;
+    uint8_t token[8];
+    size_t token_len;
+    uint32_t sent_cyc;
+    int64_t sent_ms;
+};
+
+static struct probe probes[PING_MAX_OUTSTANDING];
+/* A lost probe libcoap may still retransmit over UDP/DTLS, holding the
+ * session's one CON slot */
+static coap_mid_t retrying_mid = COAP_INVALID_MID;
+static int64_t retrying_until_ms;
+static coap_session_t *ping_session;
+static coap_optlist_t *get_optlist;
+static int reliable;
+
+static uint32_t transmitted;
+static uint32_t received;
+static uint32_t lost;
+static uint64_t sum_us;
+static uint64_t sum_sq_us;
+static uint32_t min_us = UINT32_MAX;
+static uint32_t max_us;
+static uint32_t run_length;
+static uint32_t bursts[PING_BURST_BUCKETS];
+static uint32_t elapsed_ms;
+
+static void print_ms(const char *prefix, uint32_t us) {
+    printf("%s%u.%03u", prefix, (unsigned)(us / 1000), (unsigned)(us % 1000));
+}
+
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t r = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+static void close_run(void) {
+    if (run_length) {
+        bursts[MIN(run_length, PING_BURST_BUCKETS) - 1]++;
+        run_length = 0;
+    }
+}
+
+static void probe_lost(struct probe *p) {
+    if (!reliable && p->mid != COAP_INVALID_MID) {
+        retrying_mid = p->mid;
+        retrying_until_ms = p->sent_ms + PING_RETRY_WAIT_MS;
+    }
+    p->active = 0;
+    lost++;
+    run_length++;
+    LOG_INF("seq=%d lost", p->seq);
+}
+
+static void probe_answered(struct probe *p) {
+    uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - p->sent_cyc);
+
+    p->active = 0;
+    received++;
+    sum_us += us;
+    sum_sq_us += (uint64_t)us * us;
+    if (us < min_us) {
+        min_us = us;
+    }
+    if (us > max_us) {
+        max_us = us;
+    }
+    HIST_RECORD(HIST_RESPONSE, us);
+#ifdef CONFIG_APP_METRICS
+    metrics_poll();
+#endif
+    close_run();
+    LOG_INF("seq=%d time=%u.%03u ms", p->seq, (unsigned)(us / 1000),
+            (unsigned)(us % 1000));
+}
+
+static struct probe *oldest_active(void) {
+    struct probe *oldest = NULL;
+
+    for (int i = 0; i < PING_MAX_OUTSTANDING; i++) {
+        if (probes[i].active && (!oldest || probes[i].seq < oldest->seq)) {
+            oldest = &probes[i];
+        }
+    }
+    return oldest;
+}
+
+int ping_handle_reply(coap_session_t *session, coap_mid_t mid) {
+    struct probe *p = NULL;
+
+    if (session != ping_session) {
+        return 0;
+    }
+    if (mid == retrying_mid) {
+        /* A retransmission of a lost probe got through after all */
+        retrying_mid = COAP_INVALID_MID;
+        return 1;
+    }
+    if (get_optlist) {
+        return 0;
+    }
+    if (reliable) {
+        /* Pongs come back in order on the stream and carry no MID */
+        p = oldest_active();
+    } else {
+        for (int i = 0; i < PING_MAX_OUTSTANDING; i++) {
+            if (probes[i].active && probes[i].mid == mid) {
+                p = &probes[i];
+                break;
+            }
+        }
+    }
+    if (!p) {
+        return 0;
+    }
+    probe_answered(p);
+    return 1;
+}
+
+int ping_handle_response(const coap_pdu_t *pdu) {
+    coap_bin_const_t tok = coap_pdu_get_token(pdu);
+
+    if (!get_optlist) {
+        return 0;
+    }
+    if (coap_pdu_get_mid(pdu) == retrying_mid) {
+        retrying_mid = COAP_INVALID_MID;
+    }
+    for (int i = 0; i < PING_MAX_OUTSTANDING; i++) {
+        struct probe *p = &probes[i];
+
+        if (p->active && tok.length == p->token_len &&
+            !memcmp(tok.s, p->token, p->token_len)) {
+            probe_answered(p);
+            return 1;
+        }
+    }
+    /* Late answer to a probe already counted as lost */
+    return 0;
+}
+
+void ping_handle_nack(coap_session_t *session, coap_mid_t mid) {
+    if (session == ping_session && mid == retrying_mid) {
+        retrying_mid = COAP_INVALID_MID;
+    }
+}
+
+/* Whether libcoap would queue a probe sent now instead of sending it */
+static int probe_held(int64_t now) {
+    if (reliable) {
+        return 0;
+    }
+    if (retrying_mid != COAP_INVALID_MID && now >= retrying_until_ms) {
+        /* Acknowledged without an answer we saw, or given up on */
+        retrying_mid = COAP_INVALID_MID;
+    }
+    return oldest_active() || retrying_mid != COAP_INVALID_MID;
+}
+
+static void send_probe(int seq) {
+    struct probe *p = NULL;
+
+    for (int i = 0; i < PING_MAX_OUTSTANDING; i++) {
+        if (!probes[i].active) {
+            p = &probes[i];
+            break;
+        }
+    }
+    if (!p) {
+        p = oldest_active();
+        probe_lost(p);
+    }
+
+    memset(p, 0, sizeof(*p));
+    p->seq = seq;
+    p->sent_ms = k_uptime_get();
+    p->sent_cyc = k_cycle_get_32();
+    transmitted++;
+
+    if (get_optlist) {
+        coap_pdu_t *pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET,
+                                       ping_session);
+
+        if (pdu) {
+            coap_session_new_token(ping_session, &p->token_len, p->token);
+            coap_add_token(pdu, p->token_len, p->token);
+            if (coap_add_optlist_pdu(pdu, &get_optlist) == 1) {
+                p->mid = coap_send(ping_session, pdu);
+            } else {
+                coap_delete_pdu(pdu);
+                p->mid = COAP_INVALID_MID;
+            }
+        } else {
+            p->mid = COAP_INVALID_MID;
+        }
+    } else {
+        p->mid = coap_session_send_ping(ping_session);
+    }
+
+    if (p->mid == COAP_INVALID_MID) {
+        LOG_WRN("seq=%d send failed", seq);
+        probe_lost(p);
+        return;
+    }
+    p->active = 1;
+}
+
+static void expire_probes(int64_t now) {
+    for (int i = 0; i < PING_MAX_OUTSTANDING; i++) {
+        if (probes[i].active && now - probes[i].sent_ms >= PING_TIMEOUT_MS) {
+            probe_lost(&probes[i]);
+        }
+    }
+}
+
+int ping_run(coap_context_t *ctx, coap_session_t *session, int count,
+             const coap_uri_t *uri) {
+    int64_t start = k_uptime_get();
+    int64_t next_ms;
+    int seq = 0;
+
+    ping_session = session;
+    reliable = COAP_PROTO_RELIABLE(coap_session_get_proto(session));
+    if (!reliable) {
+        coap_session_set_max_retransmit(session, PING_MAX_RETRANSMIT);
+    }
+#ifdef PING_USE_GET
+    if (!coap_path_into_optlist(uri->path.s, uri->path.length,
+                                COAP_OPTION_URI_PATH, &get_optlist) ||
+        !get_optlist) {
+        LOG_ERR("Cannot build ping GET options");
+        return 0;
+    }
+#else
+    (void)uri;
+#endif
+
+    /* Keep the handshake out of the first RTT */
+    while (coap_session_get_state(session) != COAP_SESSION_STATE_ESTABLISHED) {
+        if (k_uptime_get() - start >= PING_CONNECT_TIMEOUT_MS) {
+            LOG_ERR("Session not established, cannot ping");
+            return 0;
+        }
+        coap_io_process(ctx, 50);
+    }
+
+    LOG_INF("coap-ping: %d probes (%s), interval %d ms, timeout %d ms",
+            count, get_optlist ? "GET" : "empty CON", PING_INTERVAL_MS,
+            PING_TIMEOUT_MS);
+
+    start = k_uptime_get();
+    next_ms = start;
+    while (seq < count || oldest_active()) {
+        int64_t now = k_uptime_get();
+        int64_t wait = 50;
+        int held = probe_held(now);
+
+        if (seq < count && now >= next_ms && !held) {
+            send_probe(seq++);
+            /* A probe held back past its slot restarts the schedule */
+            next_ms = MAX(next_ms + PING_INTERVAL_MS, now);
+        }
+        expire_probes(now);
+
+        if (seq < count && !held) {
+            wait = next_ms - now;
+        }
+        coap_io_process(ctx, (uint32_t)CLAMP(wait, 1, 50));
+    }
+    close_run();
+    elapsed_ms = (uint32_t)(k_uptime_get() - start);
+
+    if (get_optlist) {
+        coap_delete_optlist(get_optlist);
+        get_optlist = NULL;
+    }
+    return (int)received;
+}
+
+void ping_report(void) {
+    printf("\n--- coap-ping statistics ---\n");
+    printf("%u probes transmitted, %u received, %u%% loss, time %u ms\n",
+           (unsigned)transmitted, (unsigned)received,
+           (unsigned)(transmitted ? lost * 100 / transmitted : 0),
+           (unsigned)elapsed_ms);
+
+    if (received) {
+        uint32_t avg = (uint32_t)(sum_us / received);
+        uint64_t mean_sq = sum_sq_us / received;
+        uint64_t sq_mean = (uint64_t)avg * avg;
+
+        print_ms("rtt min/avg/max/mdev = ", min_us);
+        print_ms("/", avg);
+        print_ms("/", max_us);
+        print_ms("/", isqrt64(mean_sq > sq_mean ? mean_sq - sq_mean : 0));
+        printf(" ms\n");
+    }
+
+    if (lost) {
+        printf("loss bursts:");
+        for (int i = 0; i < PING_BURST_BUCKETS; i++) {
+            if (!bursts[i]) {
+                continue;
+            }
+            printf(" %d%s:%u", i + 1, i == PING_BURST_BUCKETS - 1 ? "+" : "",
+                   (unsigned)bursts[i]);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,198 @@
+/*
+ * mbedtls/src/simserver.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Server stand-in for runs in virtual time.
+ *
+ * With overlay-virtual-time.conf native_sim no longer slows down to real
+ * time: its clock jumps ahead whenever every thread waits, so a day of
+ * keepalives, cache refreshes and RD re-registrations passes in seconds.
+ * A server in another process would still answer in host time and see
+ * the client's timers race past. This one lives on the client's own
+ * libcoap context, on 127.0.0.1 over Zephyr's loopback interface, and is
+ * run by the same coap_io_process() calls as the client, so both sides
+ * share one clock and advance in lockstep. It answers GETs of the
+ * client's target path with CONFIG_APP_SIM_MAX_AGE_S as Max-Age, counts
+ * the keepalive pings, and keeps one Resource Directory registration
+ * that expires after its lifetime, as a real directory's would.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+#include "simserver.h"
+#ifdef COAP_RD_EP
+#include "rd.h"
+#endif
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+static char target_path[64];
+
+static uint32_t gets;
+static uint32_t pings;
+
+#ifdef COAP_RD_EP
+static int registered;
+static uint32_t lifetime_s;
+static int64_t expires_ms;
+static uint32_t registrations;
+static uint32_t refreshes;
+static uint32_t expired;
+#endif
+
+static void target_get(coap_resource_t *resource, coap_session_t *session,
+                       const coap_pdu_t *request, const coap_string_t *query,
+                       coap_pdu_t *response) {
+    char body[32];
+    int len;
+
+    gets++;
+    /* The time the copy was made, so a stale one shows */
+    len = snprintf(body, sizeof(body), "uptime %u s",
+                   (unsigned)(k_uptime_get() / 1000));
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CONTENT);
+    coap_add_data_large_response(resource, session, request, response, query,
+                                 COAP_MEDIATYPE_TEXT_PLAIN,
+                                 CONFIG_APP_SIM_MAX_AGE_S, 0, len,
+                                 (const uint8_t *)body, NULL, NULL);
+}
+
+static void ping_handler(coap_session_t *session, const coap_pdu_t *received,
+                         const coap_mid_t mid) {
+    (void)session;
+    (void)received;
+    (void)mid;
+
+    pings++;
+}
+
+#ifdef COAP_RD_EP
+/* lt=<seconds> among the query arguments, or fallback */
+static uint32_t lifetime_of(const coap_string_t *query, uint32_t fallback) {
+    char args[64];
+    char *arg;
+    char *save;
+
+    if (!query || query->length >= sizeof(args)) {
+        return fallback;
+    }
+    memcpy(args, query->s, query->length);
+    args[query->length] = '\0';
+    for (arg = strtok_r(args, "&", &save); arg;
+         arg = strtok_r(NULL, "&", &save)) {
+        if (strncmp(arg, "lt=", 3) == 0) {
+            return (uint32_t)strtoul(arg + 3, NULL, 10);
+        }
+    }
+    return fallback;
+}
+
+static void rd_register(coap_resource_t *resource, coap_session_t *session,
+                        const coap_pdu_t *request, const coap_string_t *query,
+                        coap_pdu_t *response) {
+    (void)resource;
+    (void)session;
+    (void)request;
+
+    registrations++;
+    registered = 1;
+    lifetime_s = lifetime_of(query, SIMSERVER_RD_LIFETIME_S);
+    expires_ms = k_uptime_get() + lifetime_s * 1000LL;
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CREATED);
+    coap_add_option(response, COAP_OPTION_LOCATION_PATH,
+                    strlen(SIMSERVER_RD_LOCATION),
+                    (const uint8_t *)SIMSERVER_RD_LOCATION);
+}
+
+static void rd_refresh(coap_resource_t *resource, coap_session_t *session,
+                       const coap_pdu_t *request, const coap_string_t *query,
+                       coap_pdu_t *response) {
+    (void)resource;
+    (void)session;
+    (void)request;
+
+    /* A directory drops a registration once its lifetime has passed */
+    if (registered && k_uptime_get() > expires_ms) {
+        registered = 0;
+        expired++;
+    }
+    if (!registered) {
+        coap_pdu_set_code(response, COAP_RESPONSE_CODE_NOT_FOUND);
+        return;
+    }
+    refreshes++;
+    lifetime_s = lifetime_of(query, lifetime_s);
+    expires_ms = k_uptime_get() + lifetime_s * 1000LL;
+    coap_pdu_set_code(response, COAP_RESPONSE_CODE_CHANGED);
+}
+#endif
+
+static int add_resource(coap_context_t *ctx, const char *path,
+                        coap_request_t method, coap_method_handler_t handler) {
+    coap_resource_t *resource;
+
+    resource = coap_resource_init(coap_make_str_const(path), 0);
+    if (!resource) {
+        LOG_ERR("Cannot create the simulated /%s resource", path);
+        return 0;
+    }
+    coap_register_request_handler(resource, method, handler);
+    coap_add_resource(ctx, resource);
+    return 1;
+}
+
+int simserver_init(coap_context_t *ctx) {
+    coap_address_t listen;
+    const char *query;
+
+    /* The client's path without its leading slash and query */
+    snprintf(target_path, sizeof(target_path), "%s", COAP_SERVER_PATH + 1);
+    query = strchr(target_path, '?');
+    if (query) {
+        target_path[query - target_path] = '\0';
+    }
+    if (!add_resource(ctx, target_path, COAP_REQUEST_GET, target_get)) {
+        return 0;
+    }
+#ifdef COAP_RD_EP
+    if (!add_resource(ctx, RD_PATH, COAP_REQUEST_POST, rd_register) ||
+        !add_resource(ctx, SIMSERVER_RD_LOCATION, COAP_REQUEST_POST,
+                      rd_refresh)) {
+        return 0;
+    }
+#endif
+    coap_register_ping_handler(ctx, ping_handler);
+
+    coap_address_init(&listen);
+    listen.addr.sin.sin_family = AF_INET;
+    listen.addr.sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listen.addr.sin.sin_port = htons(COAP_SERVER_PORT);
+    listen.size = sizeof(struct sockaddr_in);
+#ifdef USE_TCP
+    if (!coap_new_endpoint(ctx, &listen, COAP_PROTO_TCP)) {
+#else
+    if (!coap_new_endpoint(ctx, &listen, COAP_PROTO_UDP)) {
+#endif
+        LOG_ERR("Cannot listen on 127.0.0.1:%d", COAP_SERVER_PORT);
+        return 0;
+    }
+    return 1;
+}
+
+void simserver_report(void) {
+    printf("\n=== SIM SERVER ===\n");
+    printf("Uptime: %u s of simulated time\n",
+           (unsigned)(k_uptime_get() / 1000));
+    printf("GET /%s: %u, pings: %u\n", target_path, (unsigned)gets,
+           (unsigned)pings);
+#ifdef COAP_RD_EP
+    printf("RD: %u registrations, %u refreshes, %u expired\n",
+           (unsigned)registrations, (unsigned)refreshes, (unsigned)expired);
+#endif
+    printf("=== END SIM SERVER ===\n");
+}
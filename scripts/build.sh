@@ -16,9 +16,56 @@ BACKEND=""
 COAP_IP="134.102.218.18"
 COAP_PATH="/hello"
 COAP_PORT="5683"
+COAP_ENDPOINTS=""
+COAP_BACKUP=""
+COAP_MCAST_LEISURE=""
+COAP_MCAST_EXPECTED=""
+DO_DISCOVER=false
+COAP_RT=""
+COAP_DISCOVERY_TTL=""
+COAP_RD_EP=""
+COAP_RD_LIFETIME=""
+COAP_RD_PATH=""
+EXTRA_CONF_FILES=()
 WIFI_SSID=""
 WIFI_PASS=""
 USE_DTLS=false
+USE_TCP=false
+COAP_BULK_ROUNDS=""
+COAP_BULK_DURATION=""
+COAP_BULK_UPLOAD=""
+COAP_BULK_SZX=""
+COAP_BULK_SIZE=""
+COAP_PING_COUNT=""
+COAP_PING_INTERVAL=""
+COAP_PING_GET=""
+COAP_SWARM=""
+COAP_SWARM_INTERVAL=""
+COAP_SWARM_DURATION=""
+COAP_SWARM_BUDGET=""
+COAP_SOAK=""
+COAP_SOAK_PERSISTENT=""
+USE_MEM_POOLS=false
+USE_HEAPS=false
+USE_STACK_REPORT=false
+USE_REDUCED_STACK=false
+MAIN_STACK=""
+DO_FOOTPRINT=false
+FOOTPRINT_MISSING_OK=OFF
+USE_MINIMAL=false
+LOG_MODE="deferred"
+USE_PDU_TRACE=false
+USE_TRACING=false
+USE_COAP_STATS=false
+USE_METRICS=false
+USE_HISTOGRAMS=false
+USE_PROFILE=false
+SERVE_LINGER=""
+USE_VIRTUAL_TIME=false
+HOLD_S=""
+ASYNC_REQUESTS=""
+KEEPALIVE_S=""
+POOL_SESSIONS=""
 DO_CLEAN=false
 DO_INIT=false
 
@@ -34,7 +81,71 @@ usage() {
     echo "  --coap-ip <ip>               CoAP server IP (default: 134.102.218.18)"
     echo "  --coap-path <path>           CoAP server path (default: /hello)"
     echo "  --coap-port <port>           CoAP server port (default: 5683)"
+    echo "  --coap-endpoints <list>      Probe \"ip[:port],...\" and use the fastest"
+    echo "  --coap-backup <ip[:port]>    Keep a warm standby session for failover"
+    echo "  --coap-rt <type>             Resolve the path by rt via /.well-known/core"
+    echo "  --discovery-ttl <seconds>    Lifetime of the cached index (default: 86400)"
+    echo "  --rd-ep <name>               Register with the Resource Directory as <name>"
+    echo "  --rd-lifetime <seconds>      RD registration lifetime (default: 90000)"
+    echo "  --rd-path <path>             RD registration resource (default: /rd)"
+    echo "  --board <target>             Zephyr board (default: esp32_devkitc/esp32/procpu,"
+    echo "                               native_sim runs on this host without Wi-Fi)"
     echo "  --use-dtls                   Enable DTLS (default: disabled)"
+    echo "  --use-tcp                    CoAP over TCP (TLS together with --use-dtls)"
+    echo "  --bulk-rounds <n>            Fetch the resource n more times and report goodput"
+    echo "  --bulk-duration <seconds>    Same, for a fixed time instead of n transfers"
+    echo "  --bulk-upload                Block1 PUT uploads instead of Block2 downloads"
+    echo "  --bulk-szx <0-7>             Block size 16 << szx (default: 6, 7 = BERT over TCP)"
+    echo "  --bulk-size <bytes>          Upload body size (default: 8192)"
+    echo "  --ping <count>               coap-ping mode: send count probes, report RTT and loss"
+    echo "  --ping-interval <ms>         Time between probes (default: 1000)"
+    echo "  --ping-get                   Probe with GETs of --coap-path instead of empty CONs"
+    echo "  --swarm <n>                  native_sim only: n clients with a session each, report"
+    echo "                               handshakes/s and sessions per GB"
+    echo "  --swarm-interval <ms>        Time between requests of one client (default: 1000)"
+    echo "  --swarm-duration <seconds>   Steady phase after the ramp (default: 30)"
+    echo "  --swarm-budget <bytes>       Heap per client before admission stops (default: 32768)"
+    echo "  --soak <cycles>              native_sim only: run request cycles on a new session"
+    echo "                               each, fail on heap growth or fragmentation"
+    echo "  --soak-persistent            Soak on one session instead of one per cycle"
+    echo "  --mem-pools                  libcoap allocations from fixed-size pools, sized"
+    echo "                               for the sessions this build opens"
+    echo "  --heaps                      Separate libcoap and TLS heaps, report usage per phase"
+    echo "  --stack-report               Per-function stack usage files and stack high-water"
+    echo "                               marks (see scripts/stack_usage.sh)"
+    echo "  --reduced-stack              Main thread locals and TLS temporaries off the stack"
+    echo "  --main-stack <bytes>         Main thread stack size (default: 8192)"
+    echo "  --minimal                    Only link what this build's scheme uses: no unused"
+    echo "                               libcoap features or startup diagnostics, and no"
+    echo "                               TLS library for coap:// on native_sim"
+    echo "  --log-mode <mode>            deferred (default), immediate (formatted in the"
+    echo "                               calling thread) or dictionary (binary, decoded"
+    echo "                               on the host; not on native_sim)"
+    echo "  --pdu-trace                  Dump the request and response PDUs"
+    echo "  --trace                      CTF trace of the request lifecycle"
+    echo "                               (see scripts/ctf2perfetto.py)"
+    echo "  --coap-stats                 Per-session libcoap statistics in the report and"
+    echo "                               at coap://<device>/stats"
+    echo "  --histograms                 Latency histograms in the report, merged on the"
+    echo "                               host by scripts/hist.py"
+    echo "  --metrics                    Observable CBOR metrics at coap://<device>/metrics"
+    echo "  --serve-linger <s>           Keep serving /stats and /metrics this long after"
+    echo "                               the run"
+    echo "  --profile                    native_sim only: frame pointers and symbols for perf"
+    echo "                               (see scripts/profile.sh)"
+    echo "  --hold <s>                   Keep the session this long after the response,"
+    echo "                               refetching on Max-Age expiry"
+    echo "  --keepalive <s>              Ping the server after this long idle"
+    echo "  --virtual-time               native_sim only: simulated time as fast as the host"
+    echo "                               allows, against an in-image server on 127.0.0.1"
+    echo "  --async <n>                  Submit n requests at once through the asynchronous"
+    echo "                               client library (lib/coapc)"
+    echo "  --footprint                  Check flash/RAM per module against the budget"
+    echo "                               (<backend>/footprint_budget.json) after the build"
+    echo "  --footprint-missing-ok       --footprint, only warning when the board has no budget"
+    echo "  --discover                   Multicast GET /.well-known/core to 224.0.1.187"
+    echo "  --mcast-leisure <ms>         Multicast response window (default: 5000)"
+    echo "  --mcast-expected <n>         Stop collecting after n responders"
     echo "  --clean                      Clean build directory"
     echo "  --init                       Initialize workspace"
     echo ""
@@ -62,6 +173,14 @@ while [[ $# -gt 0 ]]; do
             COAP_PORT="$2"
             shift 2
             ;;
+        --coap-endpoints)
+            COAP_ENDPOINTS="$2"
+            shift 2
+            ;;
+        --coap-backup)
+            COAP_BACKUP="$2"
+            shift 2
+            ;;
         --wifi-ssid)
             WIFI_SSID="$2"
             shift 2
@@ -70,10 +189,187 @@ while [[ $# -gt 0 ]]; do
             WIFI_PASS="$2"
             shift 2
             ;;
+        --coap-rt)
+            COAP_RT="$2"
+            shift 2
+            ;;
+        --discovery-ttl)
+            COAP_DISCOVERY_TTL="$2"
+            shift 2
+            ;;
+        --rd-ep)
+            COAP_RD_EP="$2"
+            shift 2
+            ;;
+        --rd-lifetime)
+            COAP_RD_LIFETIME="$2"
+            shift 2
+            ;;
+        --rd-path)
+            COAP_RD_PATH="$2"
+            shift 2
+            ;;
+        --board)
+            BOARD_TARGET="$2"
+            shift 2
+            ;;
         --use-dtls)
             USE_DTLS=true
             shift
             ;;
+        --use-tcp)
+            USE_TCP=true
+            shift
+            ;;
+        --bulk-rounds)
+            COAP_BULK_ROUNDS="$2"
+            shift 2
+            ;;
+        --bulk-duration)
+            COAP_BULK_DURATION="$2"
+            shift 2
+            ;;
+        --bulk-upload)
+            COAP_BULK_UPLOAD=1
+            shift
+            ;;
+        --bulk-szx)
+            COAP_BULK_SZX="$2"
+            shift 2
+            ;;
+        --bulk-size)
+            COAP_BULK_SIZE="$2"
+            shift 2
+            ;;
+        --ping)
+            COAP_PING_COUNT="$2"
+            shift 2
+            ;;
+        --ping-interval)
+            COAP_PING_INTERVAL="$2"
+            shift 2
+            ;;
+        --ping-get)
+            COAP_PING_GET=1
+            shift
+            ;;
+        --swarm)
+            COAP_SWARM="$2"
+            shift 2
+            ;;
+        --swarm-interval)
+            COAP_SWARM_INTERVAL="$2"
+            shift 2
+            ;;
+        --swarm-duration)
+            COAP_SWARM_DURATION="$2"
+            shift 2
+            ;;
+        --swarm-budget)
+            COAP_SWARM_BUDGET="$2"
+            shift 2
+            ;;
+        --soak)
+            COAP_SOAK="$2"
+            shift 2
+            ;;
+        --soak-persistent)
+            COAP_SOAK_PERSISTENT=1
+            shift
+            ;;
+        --mem-pools)
+            USE_MEM_POOLS=true
+            shift
+            ;;
+        --heaps)
+            USE_HEAPS=true
+            shift
+            ;;
+        --stack-report)
+            USE_STACK_REPORT=true
+            shift
+            ;;
+        --reduced-stack)
+            USE_REDUCED_STACK=true
+            shift
+            ;;
+        --main-stack)
+            MAIN_STACK="$2"
+            shift 2
+            ;;
+        --minimal)
+            USE_MINIMAL=true
+            shift
+            ;;
+        --log-mode)
+            LOG_MODE="$2"
+            shift 2
+            ;;
+        --pdu-trace)
+            USE_PDU_TRACE=true
+            shift
+            ;;
+        --trace)
+            USE_TRACING=true
+            shift
+            ;;
+        --coap-stats)
+            USE_COAP_STATS=true
+            shift
+            ;;
+        --histograms)
+            USE_HISTOGRAMS=true
+            shift
+            ;;
+        --metrics)
+            USE_METRICS=true
+            shift
+            ;;
+        --serve-linger)
+            SERVE_LINGER="$2"
+            shift 2
+            ;;
+        --profile)
+            USE_PROFILE=true
+            shift
+            ;;
+        --hold)
+            HOLD_S="$2"
+            shift 2
+            ;;
+        --keepalive)
+            KEEPALIVE_S="$2"
+            shift 2
+            ;;
+        --virtual-time)
+            USE_VIRTUAL_TIME=true
+            shift
+            ;;
+        --async)
+            ASYNC_REQUESTS="$2"
+            shift 2
+            ;;
+        --footprint)
+            DO_FOOTPRINT=true
+            shift
+            ;;
+        --footprint-missing-ok)
+            DO_FOOTPRINT=true
+            FOOTPRINT_MISSING_OK=ON
+            shift
+            ;;
+        --discover)
+            DO_DISCOVER=true
+            shift
+            ;;
+        --mcast-leisure)
+            COAP_MCAST_LEISURE="$2"
+            shift 2
+            ;;
+        --mcast-expected)
+            COAP_MCAST_EXPECTED="$2"
+            shift 2
+            ;;
         --clean)
             DO_CLEAN=true
             shift
@@ -106,12 +402,174 @@ if [[ "$BACKEND" != "wolfssl" && "$BACKEND" != "mbedtls" ]]; then
     exit 1
 fi
 
-if [[ -z "$WIFI_SSID" || -z "$WIFI_PASS" ]]; then
+IS_NATIVE_SIM=false
+if [[ "$BOARD_TARGET" == native_sim* ]]; then
+    IS_NATIVE_SIM=true
+fi
+
+if [[ "$IS_NATIVE_SIM" = false && ( -z "$WIFI_SSID" || -z "$WIFI_PASS" ) ]]; then
     echo "ERROR: --wifi-ssid and --wifi-pass are required"
     usage
     exit 1
 fi
 
+# Hundreds of sockets and a large heap only make sense on the host
+if [ -n "$COAP_SWARM" ] && [ "$IS_NATIVE_SIM" = false ]; then
+    echo "ERROR: --swarm requires --board native_sim"
+    exit 1
+fi
+# perf samples the client as a host process
+if [ "$USE_PROFILE" = true ] && [ "$IS_NATIVE_SIM" = false ]; then
+    echo "ERROR: --profile requires --board native_sim"
+    exit 1
+fi
+# The server stand-in shares the simulated clock, a real server would not
+if [ "$USE_VIRTUAL_TIME" = true ]; then
+    if [ "$IS_NATIVE_SIM" = false ]; then
+        echo "ERROR: --virtual-time requires --board native_sim"
+        exit 1
+    fi
+    # It has no certificate to offer
+    if [ "$USE_DTLS" = true ]; then
+        echo "ERROR: --virtual-time cannot be combined with --use-dtls"
+        exit 1
+    fi
+    COAP_IP="127.0.0.1"
+fi
+# lib/coapc has a context of its own, the stand-in and the swarm are on
+# the client's
+if [ -n "$ASYNC_REQUESTS" ]; then
+    if [ "$USE_VIRTUAL_TIME" = true ] || [ -n "$COAP_SWARM" ]; then
+        echo "ERROR: --async cannot be combined with --virtual-time or --swarm"
+        exit 1
+    fi
+fi
+if [ -n "$SERVE_LINGER" ] && [ "$USE_COAP_STATS" = false ] && \
+   [ "$USE_METRICS" = false ]; then
+    echo "ERROR: --serve-linger needs --coap-stats or --metrics"
+    exit 1
+fi
+if [ -n "$COAP_SOAK" ]; then
+    if [ "$IS_NATIVE_SIM" = false ]; then
+        echo "ERROR: --soak requires --board native_sim"
+        exit 1
+    fi
+    # The verdict is taken on the subsystem heaps
+    USE_HEAPS=true
+fi
+
+case $LOG_MODE in
+    deferred|immediate)
+        ;;
+    dictionary)
+        # The dictionary output is for the UART; native_sim logs to stdout
+        if [ "$IS_NATIVE_SIM" = true ]; then
+            echo "ERROR: --log-mode dictionary needs a board with a UART console"
+            exit 1
+        fi
+        ;;
+    *)
+        echo "ERROR: --log-mode must be 'deferred', 'immediate' or 'dictionary'"
+        exit 1
+        ;;
+esac
+
+# Local-network discovery: fan out to all CoAP nodes with a short window
+if [ "$DO_DISCOVER" = true ]; then
+    if [ "$USE_DTLS" = true ] || [ "$USE_TCP" = true ]; then
+        echo "ERROR: --discover cannot be combined with --use-dtls or --use-tcp"
+        exit 1
+    fi
+    COAP_IP="224.0.1.187"
+    COAP_PATH="/.well-known/core"
+    COAP_MCAST_LEISURE="${COAP_MCAST_LEISURE:-1000}"
+fi
+# A group address (224.0.0.0/4 or ff00::/8) is a NON query over plain
+# UDP: (D)TLS and TCP sessions have a single peer
+if [[ "${COAP_IP%%.*}" =~ ^(22[4-9]|23[0-9])$ || "$COAP_IP" =~ ^[fF][fF] ]]; then
+    if [ "$USE_DTLS" = true ] || [ "$USE_TCP" = true ]; then
+        echo "ERROR: multicast --coap-ip cannot be combined with --use-dtls or --use-tcp"
+        exit 1
+    fi
+fi
+
+# prj.conf brings the TLS library. Only a minimal plain build on
+# native_sim goes without: on the ESP32, Wi-Fi needs mbedTLS even when
+# CoAP does not.
+if [ "$USE_MINIMAL" = true ] && [ "$USE_DTLS" = false ] && \
+   [ "$IS_NATIVE_SIM" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-no-tls.conf")
+fi
+if [ "$USE_MINIMAL" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-minimal.conf")
+fi
+if [ -n "$COAP_RT" ] || [ -n "$COAP_RD_EP" ]; then
+    EXTRA_CONF_FILES+=("overlay-settings.conf")
+fi
+if [ "$USE_TCP" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-tcp.conf")
+fi
+if [ -n "$COAP_BULK_ROUNDS" ] || [ -n "$COAP_BULK_DURATION" ] || \
+   [ -n "$COAP_SWARM" ] || [ "$USE_HEAPS" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-stats.conf")
+fi
+if [ -n "$COAP_SWARM" ]; then
+    EXTRA_CONF_FILES+=("overlay-swarm.conf")
+fi
+if [ "$USE_HEAPS" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-heaps.conf")
+fi
+if [ "$USE_STACK_REPORT" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-stack.conf")
+fi
+if [ "$LOG_MODE" = dictionary ]; then
+    EXTRA_CONF_FILES+=("overlay-log-dict.conf")
+fi
+if [ "$USE_TRACING" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-tracing.conf")
+    # No file system on the ESP32: the trace stays in RAM
+    if [ "$IS_NATIVE_SIM" = false ]; then
+        EXTRA_CONF_FILES+=("overlay-tracing-ram.conf")
+    fi
+fi
+if [ "$USE_PROFILE" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-profile.conf")
+fi
+if [ -n "$ASYNC_REQUESTS" ]; then
+    EXTRA_CONF_FILES+=("overlay-async.conf")
+fi
+# After overlay-minimal.conf as well: the server stand-in runs on
+# libcoap's server side, which a minimal build must not take away
+if [ "$USE_VIRTUAL_TIME" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-virtual-time.conf")
+fi
+# After overlay-minimal.conf, which turns the server support off
+if [ "$USE_COAP_STATS" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-coapstats.conf")
+fi
+if [ "$USE_METRICS" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-metrics.conf")
+fi
+if [ "$USE_MEM_POOLS" = true ]; then
+    EXTRA_CONF_FILES+=("overlay-pools.conf")
+    # Sessions open at once: one per probed endpoint plus the standby, or
+    # one per swarm client
+    POOL_SESSIONS=1
+    if [ -n "$COAP_ENDPOINTS" ]; then
+        POOL_SESSIONS=$(echo "$COAP_ENDPOINTS" | tr ',' '\n' | wc -l)
+    fi
+    if [ -n "$COAP_BACKUP" ]; then
+        POOL_SESSIONS=$((POOL_SESSIONS + 1))
+    fi
+    if [ -n "$COAP_SWARM" ]; then
+        POOL_SESSIONS="$COAP_SWARM"
+    fi
+    # And one for whoever asks for /stats or /metrics
+    if [ "$USE_COAP_STATS" = true ] || [ "$USE_METRICS" = true ]; then
+        POOL_SESSIONS=$((POOL_SESSIONS + 1))
+    fi
+fi
+
 # Set backend-specific directory
 cd "$PROJECT_ROOT/$BACKEND"
 
@@ -171,19 +629,109 @@ if [ "$USE_DTLS" = true ]; then
         COAP_PORT="5684"  # Default DTLS port
     fi
 fi
+if [ "$USE_TCP" = true ]; then
+    PROTOCOL="${PROTOCOL}+tcp"
+fi
 
 echo "Building ${BACKEND} CoAP client"
 echo "Target: ${PROTOCOL}://${COAP_IP}:${COAP_PORT}${COAP_PATH}"
+if [ -n "$COAP_ENDPOINTS" ]; then
+    echo "Endpoints: ${COAP_ENDPOINTS}"
+fi
+if [ -n "$COAP_BACKUP" ]; then
+    echo "Backup: ${COAP_BACKUP}"
+fi
 
 # Export environment variables for CMake
-export COAP_IP COAP_PATH COAP_PORT WIFI_SSID WIFI_PASS
+export COAP_IP COAP_PATH COAP_PORT COAP_ENDPOINTS COAP_BACKUP WIFI_SSID WIFI_PASS
+export COAP_MCAST_LEISURE COAP_MCAST_EXPECTED COAP_RT COAP_DISCOVERY_TTL
+export COAP_RD_EP COAP_RD_LIFETIME COAP_RD_PATH COAP_BULK_ROUNDS
+export COAP_PING_COUNT COAP_PING_INTERVAL COAP_PING_GET
+export COAP_SWARM COAP_SWARM_INTERVAL COAP_SWARM_DURATION COAP_SWARM_BUDGET
+export COAP_SOAK COAP_SOAK_PERSISTENT
+export COAP_BULK_DURATION COAP_BULK_UPLOAD COAP_BULK_SZX COAP_BULK_SIZE
 if [ "$USE_DTLS" = true ]; then
     export USE_DTLS=1
 fi
+if [ "$USE_TCP" = true ]; then
+    export USE_TCP=1
+fi
 
-west build -p auto -b "$BOARD_TARGET" .
+CMAKE_ARGS=()
+if [ ${#EXTRA_CONF_FILES[@]} -gt 0 ]; then
+    EXTRA_CONF=$(IFS=';'; echo "${EXTRA_CONF_FILES[*]}")
+    echo "Extra Kconfig fragments: ${EXTRA_CONF}"
+    CMAKE_ARGS+=(-DEXTRA_CONF_FILE="${EXTRA_CONF}")
+fi
+if [ -n "$POOL_SESSIONS" ]; then
+    echo "libcoap memory pools sized for ${POOL_SESSIONS} sessions"
+    CMAKE_ARGS+=(-DCONFIG_APP_COAP_POOL_SESSIONS="${POOL_SESSIONS}")
+fi
+if [ "$USE_REDUCED_STACK" = true ]; then
+    CMAKE_ARGS+=(-DCONFIG_APP_REDUCED_STACK=y)
+fi
+if [ "$LOG_MODE" = immediate ]; then
+    echo "Log mode: immediate"
+    CMAKE_ARGS+=(-DCONFIG_LOG_MODE_IMMEDIATE=y)
+fi
+if [ "$USE_PDU_TRACE" = true ]; then
+    CMAKE_ARGS+=(-DCONFIG_APP_PDU_TRACE=y)
+fi
+if [ "$USE_TRACING" = true ] && [ "$IS_NATIVE_SIM" = true ]; then
+    CMAKE_ARGS+=(-DCONFIG_TRACING_BACKEND_POSIX=y)
+fi
+if [ "$USE_HISTOGRAMS" = true ]; then
+    CMAKE_ARGS+=(-DCONFIG_APP_HISTOGRAMS=y)
+fi
+if [ -n "$SERVE_LINGER" ]; then
+    CMAKE_ARGS+=(-DCONFIG_APP_SERVE_LINGER_S="${SERVE_LINGER}")
+fi
+if [ -n "$HOLD_S" ]; then
+    CMAKE_ARGS+=(-DCONFIG_APP_HOLD_S="${HOLD_S}")
+fi
+if [ -n "$KEEPALIVE_S" ]; then
+    CMAKE_ARGS+=(-DCONFIG_APP_KEEPALIVE_S="${KEEPALIVE_S}")
+fi
+if [ -n "$ASYNC_REQUESTS" ]; then
+    CMAKE_ARGS+=(-DCONFIG_APP_ASYNC_REQUESTS="${ASYNC_REQUESTS}")
+fi
+if [ -n "$MAIN_STACK" ]; then
+    echo "Main thread stack: ${MAIN_STACK} bytes"
+    CMAKE_ARGS+=(-DCONFIG_MAIN_STACK_SIZE="${MAIN_STACK}")
+fi
+
+if [ "$DO_FOOTPRINT" = true ]; then
+    # Passed every time, as the cache would keep it for the next build
+    CMAKE_ARGS+=(-DFOOTPRINT_MISSING_OK="${FOOTPRINT_MISSING_OK}")
+fi
+
+west build -p auto -b "$BOARD_TARGET" . -- "${CMAKE_ARGS[@]}"
+
+if [ "$USE_TRACING" = true ]; then
+    # Where the run below writes its trace
+    mkdir -p build/trace
+fi
+
+if [ "$DO_FOOTPRINT" = true ]; then
+    # Fails the build when a module is over its budget, or the board has
+    # none without --footprint-missing-ok
+    west build -t footprint
+    echo "Footprint: build/footprint.json"
+fi
 
 echo ""
 echo "Build complete!"
-echo "Flash: west flash"
-echo "Monitor: west espressif monitor"
\ No newline at end of file
+if [ "$USE_TRACING" = true ] && [ "$IS_NATIVE_SIM" = true ]; then
+    echo "Run: ./build/zephyr/zephyr.exe -trace-file=build/trace/channel0_0"
+    echo "Then: ./scripts/ctf2perfetto.py $BACKEND/build/trace"
+elif [ "$USE_TRACING" = true ]; then
+    echo "Flash: west flash"
+    echo "Debug: west debug, then after the run, in gdb:"
+    echo "  dump binary memory build/trace/channel0_0 ram_tracing ram_tracing+'tracing_backend_ram.c'::pos"
+    echo "Then: ./scripts/ctf2perfetto.py $BACKEND/build/trace"
+elif [ "$IS_NATIVE_SIM" = true ]; then
+    echo "Run: ./build/zephyr/zephyr.exe"
+else
+    echo "Flash: west flash"
+    echo "Monitor: west espressif monitor"
+fi
\ No newline at end of file
@@ -0,0 +1,70 @@
+#!/bin/bash
+# ./scripts/build_bench_server.sh
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Build the benchmark server (bench/bench_server.c) against the host
+# libcoap installed by scripts/build_libcoap.sh
+
+set -e
+
+PROJECT_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+LIBCOAP_DIR="${LIBCOAP_DIR:-$PROJECT_ROOT/libcoap/build}"
+OUTPUT="$PROJECT_ROOT/bench/build/bench-server"
+
+usage() {
+    echo "Usage: $0 [options]"
+    echo ""
+    echo "Optional:"
+    echo "  --libcoap-dir <dir>          libcoap install prefix (default: ./libcoap/build)"
+    echo "  --output <file>              Output binary (default: bench/build/bench-server)"
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --libcoap-dir)
+            LIBCOAP_DIR="$2"
+            shift 2
+            ;;
+        --output)
+            OUTPUT="$2"
+            shift 2
+            ;;
+        -h|--help)
+            usage
+            exit 0
+            ;;
+        *)
+            echo "Unknown option: $1"
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+export PKG_CONFIG_PATH="$LIBCOAP_DIR/lib/pkgconfig${PKG_CONFIG_PATH:+:$PKG_CONFIG_PATH}"
+
+# Whichever (D)TLS flavour of libcoap was installed
+PKG=""
+for candidate in libcoap-3-openssl libcoap-3-wolfssl libcoap-3-gnutls \
+                 libcoap-3-mbedtls libcoap-3-notls libcoap-3; do
+    if pkg-config --exists "$candidate"; then
+        PKG="$candidate"
+        break
+    fi
+done
+
+if [ -z "$PKG" ]; then
+    echo "ERROR: libcoap not found under $LIBCOAP_DIR"
+    echo "Build it first with ./scripts/build_libcoap.sh"
+    exit 1
+fi
+
+mkdir -p "$(dirname "$OUTPUT")"
+# -O2 and no sanitizers: the server must not be the bottleneck it measures
+gcc -std=gnu11 -O2 -Wall -o "$OUTPUT" "$PROJECT_ROOT/bench/bench_server.c" \
+    $(pkg-config --cflags --libs "$PKG") \
+    -Wl,-rpath,"$(pkg-config --variable=libdir "$PKG")"
+
+echo "Built $OUTPUT against $PKG"
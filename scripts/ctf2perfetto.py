@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+# ./scripts/ctf2perfetto.py
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Turn the CTF trace of a --trace build into a timeline. Adds Zephyr's
+# CTF metadata to the trace directory, which is all TraceCompass needs to
+# open it, and converts the trace to the Chrome JSON format Perfetto
+# (ui.perfetto.dev) loads: a track per thread with the time it ran, the
+# request lifecycle events as instants on the thread that emitted them,
+# and <x>_begin/<x>_end pairs as slices. Needs the babeltrace2 Python
+# bindings (python3-bt2).
+
+import argparse
+import json
+import os
+import shutil
+import sys
+
+try:
+    import bt2
+except ImportError:
+    sys.exit("ERROR: babeltrace2 Python bindings not found, install python3-bt2")
+
+
+def text(field):
+    """A CTF string, or a bounded string stored as a char array"""
+    if isinstance(field, str):
+        return field
+    try:
+        return bytes(int(c) for c in field).split(b"\0")[0].decode()
+    except TypeError:
+        return str(field)
+
+
+def add_metadata(trace_dir, zephyr_base):
+    target = os.path.join(trace_dir, "metadata")
+    if os.path.exists(target):
+        return
+    source = os.path.join(zephyr_base, "subsys", "tracing", "ctf", "tsdl",
+                          "metadata")
+    if not os.path.exists(source):
+        sys.exit("ERROR: no CTF metadata at %s, set --zephyr-base" % source)
+    shutil.copy(source, target)
+
+
+def convert(trace_dir):
+    events = []
+    names = {}
+    running = None
+    start = None
+
+    def us(ns):
+        return (ns - start) / 1000.0
+
+    for msg in bt2.TraceCollectionMessageIterator(trace_dir):
+        if type(msg) is not bt2._EventMessageConst:
+            continue
+        ns = msg.default_clock_snapshot.ns_from_origin
+        if start is None:
+            start = ns
+        event = msg.event
+        payload = event.payload_field
+
+        if event.name == "thread_switched_in":
+            running = int(payload["thread_id"])
+            names[running] = text(payload["name"]) or hex(running)
+            events.append({"name": names[running], "ph": "B", "pid": 0,
+                           "tid": running, "ts": us(ns)})
+        elif event.name == "thread_switched_out":
+            thread = int(payload["thread_id"])
+            events.append({"name": names.get(thread, hex(thread)),
+                           "ph": "E", "pid": 0, "tid": thread, "ts": us(ns)})
+            if thread == running:
+                running = None
+        elif event.name == "named_event":
+            name = text(payload["name"])
+            args = {"arg0": int(payload["arg0"]), "arg1": int(payload["arg1"])}
+            tid = running if running is not None else 0
+            # Slices on their own track, so they cannot straddle the
+            # thread slices
+            if name.endswith("_begin"):
+                events.append({"name": name[:-len("_begin")], "ph": "B",
+                               "pid": 1, "tid": tid, "ts": us(ns),
+                               "args": args})
+            elif name.endswith("_end"):
+                events.append({"name": name[:-len("_end")], "ph": "E",
+                               "pid": 1, "tid": tid, "ts": us(ns),
+                               "args": args})
+            else:
+                events.append({"name": name, "ph": "i", "s": "t", "pid": 1,
+                               "tid": tid, "ts": us(ns), "args": args})
+
+    meta = [{"name": "process_name", "ph": "M", "pid": 0,
+             "args": {"name": "threads"}},
+            {"name": "process_name", "ph": "M", "pid": 1,
+             "args": {"name": "request lifecycle"}}]
+    for tid, name in names.items():
+        for pid in (0, 1):
+            meta.append({"name": "thread_name", "ph": "M", "pid": pid,
+                         "tid": tid, "args": {"name": name}})
+    return meta + events
+
+
+def main():
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(
+        description="CTF trace of the client for TraceCompass and Perfetto")
+    parser.add_argument("trace_dir",
+                        help="directory with the trace (channel0_0)")
+    parser.add_argument("-o", "--output",
+                        help="Chrome JSON output (default: "
+                             "<trace_dir>/trace.json)")
+    parser.add_argument("--zephyr-base",
+                        default=os.environ.get("ZEPHYR_BASE",
+                                               os.path.join(root, "zephyr")),
+                        help="Zephyr tree with the CTF metadata "
+                             "(default: $ZEPHYR_BASE or ./zephyr)")
+    args = parser.parse_args()
+
+    add_metadata(args.trace_dir, args.zephyr_base)
+    events = convert(args.trace_dir)
+    output = args.output or os.path.join(args.trace_dir, "trace.json")
+    with open(output, "w") as f:
+        json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, f)
+
+    lifecycle = sum(1 for e in events if e.get("pid") == 1 and e["ph"] != "M")
+    print("%d events, %d of the request lifecycle" % (len(events), lifecycle))
+    print("TraceCompass: open %s as a CTF trace" % args.trace_dir)
+    print("Perfetto: load %s in ui.perfetto.dev" % output)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
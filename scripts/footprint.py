@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+# ./scripts/footprint.py
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Flash and RAM footprint per module, checked against a budget. Reads the
+# rom.json and ram.json trees that Zephyr's rom_report and ram_report
+# targets write, attributes every file to app, libcoap, tls, wifi, net,
+# kernel or other, and prints the result as JSON. Exits with status 1 when
+# a module is over its budget for the board, 2 when the board has no
+# budget yet (--update records one), or 0 then with --missing-ok.
+
+import argparse
+import json
+import math
+import os
+import sys
+
+MODULES = ["app", "libcoap", "tls", "wifi", "net", "kernel", "other"]
+
+
+# Path prefixes in the report tree, most specific first. mbedTLS is the
+# TLS module of the mbedtls backend; with wolfSSL for CoAP it is only
+# there for Wi-Fi.
+RULES = [
+    ("ZEPHYR_BASE/subsys/net/l2/wifi", "wifi"),
+    ("ZEPHYR_BASE/drivers/wifi", "wifi"),
+    ("ZEPHYR_BASE/subsys/net", "net"),
+    ("WORKSPACE/modules/lib/libcoap", "libcoap"),
+    ("WORKSPACE/modules/crypto/wolfssl", "tls"),
+    ("WORKSPACE/modules/crypto/mbedtls", {"mbedtls": "tls",
+                                          "wolfssl": "wifi"}),
+    ("WORKSPACE/modules/hal/espressif", "wifi"),
+    ("WORKSPACE/modules/lib/hostap", "wifi"),
+    ("WORKSPACE/modules/lib/picolibc", "kernel"),
+    # Libraries of this repository count with the application
+    ("WORKSPACE/lib", "app"),
+    # Generated code: devicetree, syscalls, linker sections
+    ("OUTPUT_DIR", "kernel"),
+    ("ZEPHYR_BASE", "kernel"),
+]
+
+
+def classify(path, backend):
+    """Module of a path in the report tree, None if a deeper level decides"""
+    rules = RULES + [("WORKSPACE/" + backend, "app")]
+    for prefix, module in rules:
+        if prefix.startswith(path + "/"):
+            return None
+    for prefix, module in rules:
+        if path == prefix or path.startswith(prefix + "/"):
+            return module[backend] if isinstance(module, dict) else module
+    return "other"
+
+
+def attribute(node, parts, backend, sizes):
+    module = classify("/".join(parts), backend) if parts else None
+    children = node.get("children", [])
+    if module is None and not children:
+        module = "other"
+    if module is not None:
+        sizes[module] += node.get("size", 0)
+        return
+    for child in children:
+        attribute(child, parts + [child["name"]], backend, sizes)
+
+
+def load_report(build_dir, name):
+    for path in (os.path.join(build_dir, name),
+                 os.path.join(build_dir, "zephyr", name)):
+        if os.path.exists(path):
+            with open(path) as f:
+                return json.load(f)
+    sys.exit("ERROR: no %s in %s, run the rom_report and ram_report targets"
+             % (name, build_dir))
+
+
+def board_of(build_dir):
+    with open(os.path.join(build_dir, "CMakeCache.txt")) as f:
+        for line in f:
+            if line.startswith("BOARD:"):
+                return line.split("=", 1)[1].strip()
+    return "unknown"
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Flash and RAM footprint per module against a budget")
+    parser.add_argument("--backend", required=True,
+                        choices=["mbedtls", "wolfssl"])
+    parser.add_argument("--build-dir", help="default: <backend>/build")
+    parser.add_argument("--budget",
+                        help="default: <backend>/footprint_budget.json")
+    parser.add_argument("--output", help="also write the JSON result here")
+    parser.add_argument("--update", action="store_true",
+                        help="record the current sizes plus the margin as "
+                             "this board's budget")
+    parser.add_argument("--missing-ok", action="store_true",
+                        help="only warn when the board has no budget")
+    args = parser.parse_args()
+
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    build_dir = args.build_dir or os.path.join(root, args.backend, "build")
+    budget_path = args.budget or os.path.join(root, args.backend,
+                                              "footprint_budget.json")
+    board = board_of(build_dir)
+
+    result = {"backend": args.backend, "board": board}
+    for region in ("rom", "ram"):
+        report = load_report(build_dir, region + ".json")
+        sizes = dict.fromkeys(MODULES, 0)
+        attribute(report["symbols"], [], args.backend, sizes)
+        result[region] = {"total": report.get("total_size",
+                                              sum(sizes.values())),
+                          "modules": sizes}
+
+    with open(budget_path) as f:
+        budget = json.load(f)
+    margin = budget.get("margin_pct", 5)
+
+    if args.update:
+        # Whole KiB above the measured size plus the margin
+        budget.setdefault("boards", {})[board] = {
+            region: {m: int(math.ceil(size * (100 + margin) / 100 / 1024)) *
+                     1024 for m, size in result[region]["modules"].items()}
+            for region in ("rom", "ram")
+        }
+        with open(budget_path, "w") as f:
+            json.dump(budget, f, indent=2, sort_keys=True)
+            f.write("\n")
+
+    limits = budget.get("boards", {}).get(board)
+    over = []
+    if limits:
+        for region in ("rom", "ram"):
+            for module, size in result[region]["modules"].items():
+                limit = limits.get(region, {}).get(module)
+                if limit is not None and size > limit:
+                    over.append({"region": region, "module": module,
+                                 "size": size, "budget": limit})
+    result["budget"] = limits
+    result["over_budget"] = over
+    result["pass"] = bool(limits) and not over
+
+    text = json.dumps(result, indent=2)
+    print(text)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+
+    if not limits:
+        print("No footprint budget for %s in %s, record one with --update"
+              % (board, budget_path), file=sys.stderr)
+        return 0 if args.missing_ok else 2
+    for o in over:
+        print("%s %s: %d bytes, budget %d" % (o["region"].upper(),
+              o["module"], o["size"], o["budget"]), file=sys.stderr)
+    return 1 if over else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+# ./scripts/hist.py
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Decode and merge the latency histograms of client runs. A client built
+# with CONFIG_APP_HISTOGRAMS prints a "hist <name> <hex>" line per
+# histogram in its report (see mbedtls/include/hist.h for the format).
+# The histograms of the same name from all the given logs, several runs
+# or several devices, are merged bucket by bucket and printed as
+# percentiles, or as JSON for other scripts.
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+HEADER = struct.Struct("<4sBBBBIIIQH")
+BUCKET = struct.Struct("<HI")
+LINE = re.compile(r"\bhist (\w+) ([0-9a-f]+)\s*$")
+PERCENTILES = (50.0, 90.0, 99.0, 99.9)
+
+
+class Hist:
+    def __init__(self, sub_bits, max_bits):
+        self.sub_bits = sub_bits
+        self.max_bits = max_bits
+        self.count = 0
+        self.min = None
+        self.max = 0
+        self.sum = 0
+        self.buckets = {}
+
+    def bucket_top(self, i):
+        """Largest value of bucket i, as bucket_top() in hist.c"""
+        sub = 1 << self.sub_bits
+        if i < sub:
+            return i
+        shift = (i >> self.sub_bits) - 1
+        return (((i & (sub - 1)) | sub) << shift) + (1 << shift) - 1
+
+    def merge(self, other):
+        if (other.sub_bits, other.max_bits) != (self.sub_bits, self.max_bits):
+            raise ValueError("histograms of different geometry")
+        if not other.count:
+            return
+        self.min = other.min if self.min is None else min(self.min, other.min)
+        self.max = max(self.max, other.max)
+        self.count += other.count
+        self.sum += other.sum
+        for i, n in other.buckets.items():
+            self.buckets[i] = self.buckets.get(i, 0) + n
+
+    def percentile(self, pct):
+        if not self.count:
+            return 0
+        target = max(-(-self.count * pct // 100), 1)
+        seen = 0
+        for i in sorted(self.buckets):
+            seen += self.buckets[i]
+            if seen >= target:
+                return min(self.bucket_top(i), self.max)
+        return self.max
+
+    def summary(self):
+        result = {"count": self.count, "min": self.min or 0, "max": self.max,
+                  "mean": self.sum / self.count if self.count else 0}
+        for pct in PERCENTILES:
+            result["p%g" % pct] = self.percentile(pct)
+        return result
+
+
+def decode(data):
+    (magic, sub_bits, max_bits, _, _, count, lo, hi, total,
+     used) = HEADER.unpack_from(data)
+    if magic != b"HST1":
+        raise ValueError("not a histogram snapshot")
+    h = Hist(sub_bits, max_bits)
+    h.count, h.min, h.max, h.sum = count, lo, hi, total
+    for k in range(used):
+        i, n = BUCKET.unpack_from(data, HEADER.size + k * BUCKET.size)
+        h.buckets[i] = n
+    return h
+
+
+def collect(paths):
+    merged = {}
+    for path in paths:
+        f = sys.stdin if path == "-" else open(path, errors="replace")
+        with f:
+            for line in f:
+                m = LINE.search(line)
+                if not m:
+                    continue
+                h = decode(bytes.fromhex(m.group(2)))
+                if m.group(1) in merged:
+                    merged[m.group(1)].merge(h)
+                else:
+                    merged[m.group(1)] = h
+    return merged
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Merge the latency histograms of client runs")
+    parser.add_argument("logs", nargs="*", default=["-"],
+                        help="client console logs (default: stdin)")
+    parser.add_argument("--json", action="store_true",
+                        help="print the merged percentiles as JSON")
+    args = parser.parse_args()
+
+    try:
+        merged = collect(args.logs)
+    except (ValueError, struct.error) as e:
+        sys.exit("ERROR: %s" % e)
+    if not merged:
+        sys.exit("ERROR: no histograms found; build with CONFIG_APP_HISTOGRAMS")
+
+    summaries = {name: h.summary() for name, h in merged.items()}
+    if args.json:
+        json.dump(summaries, sys.stdout, indent=2)
+        print()
+        return 0
+    for name, s in summaries.items():
+        print("%-12s %6d samples, min %u, %s, max %u us" % (
+            name, s["count"], s["min"],
+            ", ".join("p%g %u" % (pct, s["p%g" % pct])
+                      for pct in PERCENTILES), s["max"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,100 @@
+#!/bin/bash
+# ./scripts/impair.sh
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Network impairment emulator for local CoAP servers. Adds per-port delay,
+# jitter and loss (tc netem) to the traffic the servers send back, so each
+# local server can stand in for a near or far regional endpoint.
+
+set -e
+
+IFACE=""
+RULES=()
+DO_CLEAR=false
+
+usage() {
+    echo "Usage: $0 --iface <dev> --rule <port:delay[:jitter[:loss]]> [...]"
+    echo "       $0 --iface <dev> --clear"
+    echo ""
+    echo "Required:"
+    echo "  --iface <dev>                Interface the client is reached through"
+    echo ""
+    echo "Optional:"
+    echo "  --rule <spec>                Impair replies from a server port, e.g."
+    echo "                               5693:80ms:10ms:2% (repeatable)"
+    echo "  --clear                      Remove all impairments from <dev>"
+    echo ""
+    echo "Example:"
+    echo "  $0 --iface wlan0 --rule 5683:5ms --rule 5693:60ms:5ms \\"
+    echo "     --rule 5703:150ms:20ms:5%"
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --iface)
+            IFACE="$2"
+            shift 2
+            ;;
+        --rule)
+            RULES+=("$2")
+            shift 2
+            ;;
+        --clear)
+            DO_CLEAR=true
+            shift
+            ;;
+        -h|--help)
+            usage
+            exit 0
+            ;;
+        *)
+            echo "Unknown option: $1"
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+if [[ -z "$IFACE" ]]; then
+    echo "ERROR: --iface is required"
+    usage
+    exit 1
+fi
+
+sudo tc qdisc del dev "$IFACE" root 2>/dev/null || true
+
+if [ "$DO_CLEAR" = true ]; then
+    echo "Impairments cleared on $IFACE"
+    exit 0
+fi
+
+if [ ${#RULES[@]} -eq 0 ]; then
+    echo "ERROR: at least one --rule is required"
+    usage
+    exit 1
+fi
+
+# Bands 1-3 keep the default priomap for unmatched traffic, every rule gets
+# its own band with a netem child selected by the server's source port
+sudo tc qdisc add dev "$IFACE" root handle 1: prio bands $((3 + ${#RULES[@]}))
+
+band=4
+for rule in "${RULES[@]}"; do
+    IFS=':' read -r port delay jitter loss <<< "$rule"
+    netem=(delay "${delay:-0ms}")
+    if [ -n "$jitter" ]; then
+        netem+=("$jitter" distribution normal)
+    fi
+    if [ -n "$loss" ]; then
+        netem+=(loss "$loss")
+    fi
+
+    sudo tc qdisc add dev "$IFACE" parent 1:$band handle $((band * 10)): \
+        netem "${netem[@]}"
+    sudo tc filter add dev "$IFACE" parent 1:0 protocol ip prio 1 u32 \
+        match ip sport "$port" 0xffff flowid 1:$band
+    echo "Port $port on $IFACE: ${netem[*]}"
+    band=$((band + 1))
+done
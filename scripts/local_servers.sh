@@ -0,0 +1,106 @@
+#!/bin/bash
+# ./scripts/local_servers.sh
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Start (or stop) several local coap-server instances on consecutive ports,
+# e.g. to exercise the client's multi-endpoint selection
+
+set -e
+
+PROJECT_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+COAP_SERVER_BIN="${COAP_SERVER_BIN:-$PROJECT_ROOT/libcoap/build/bin/coap-server}"
+PID_FILE="/tmp/coap-local-servers.pids"
+
+# Defaults
+COUNT=3
+BASE_PORT=5683
+PORT_STEP=10
+USE_DTLS=false
+DO_STOP=false
+
+usage() {
+    echo "Usage: $0 [options]"
+    echo ""
+    echo "Optional:"
+    echo "  --count <n>                  Number of servers (default: 3)"
+    echo "  --base-port <port>           Port of the first server (default: 5683)"
+    echo "  --port-step <n>              Port distance between servers (default: 10)"
+    echo "  --use-dtls                   Also serve DTLS on port+1 (needs ./certs)"
+    echo "  --stop                       Stop the servers started by this script"
+    echo ""
+    echo "Example:"
+    echo "  $0 --count 3 && ./scripts/build.sh --backend mbedtls \\"
+    echo "     --coap-endpoints \"your_ip:5683,your_ip:5693,your_ip:5703\" ..."
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --count)
+            COUNT="$2"
+            shift 2
+            ;;
+        --base-port)
+            BASE_PORT="$2"
+            shift 2
+            ;;
+        --port-step)
+            PORT_STEP="$2"
+            shift 2
+            ;;
+        --use-dtls)
+            USE_DTLS=true
+            shift
+            ;;
+        --stop)
+            DO_STOP=true
+            shift
+            ;;
+        -h|--help)
+            usage
+            exit 0
+            ;;
+        *)
+            echo "Unknown option: $1"
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+stop_servers() {
+    if [ -f "$PID_FILE" ]; then
+        while read -r pid; do
+            kill "$pid" 2>/dev/null || true
+        done < "$PID_FILE"
+        rm -f "$PID_FILE"
+        echo "Local CoAP servers stopped"
+    fi
+}
+
+if [ "$DO_STOP" = true ]; then
+    stop_servers
+    exit 0
+fi
+
+if [ ! -x "$COAP_SERVER_BIN" ]; then
+    echo "ERROR: coap-server not found at $COAP_SERVER_BIN"
+    echo "Build libcoap first or set COAP_SERVER_BIN"
+    exit 1
+fi
+
+stop_servers
+
+DTLS_ARGS=()
+if [ "$USE_DTLS" = true ]; then
+    DTLS_ARGS=(-c "$PROJECT_ROOT/certs/server.crt" -j "$PROJECT_ROOT/certs/server.key" -n)
+fi
+
+for ((i = 0; i < COUNT; i++)); do
+    port=$((BASE_PORT + i * PORT_STEP))
+    "$COAP_SERVER_BIN" -A 0.0.0.0 -p "$port" "${DTLS_ARGS[@]}" -v 4 \
+        > "/tmp/coap-server-$port.log" 2>&1 &
+    echo $! >> "$PID_FILE"
+    echo "coap-server listening on port $port (log: /tmp/coap-server-$port.log)"
+done
@@ -0,0 +1,155 @@
+#!/bin/bash
+# ./scripts/log_latency.sh
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Cost of logging on the request path, on native_sim: the send-to-response
+# time of one request with the console output of old (immediate logging
+# and PDU dumps) against deferred logging without dumps, over repeated
+# runs against a local bench server
+
+set -e
+
+PROJECT_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BENCH_SERVER_BIN="${BENCH_SERVER_BIN:-$PROJECT_ROOT/bench/build/bench-server}"
+LOG_DIR="/tmp/coap-log-latency"
+
+# Defaults
+BACKEND=""
+RUNS=50
+PORT=5683
+USE_DTLS=false
+
+usage() {
+    echo "Usage: $0 --backend <wolfssl|mbedtls> [options]"
+    echo ""
+    echo "Required:"
+    echo "  --backend <wolfssl|mbedtls>  TLS backend to use"
+    echo ""
+    echo "Optional:"
+    echo "  --runs <n>                   Requests per variant, one run each (default: 50)"
+    echo "  --port <port>                Bench server port, DTLS on port+1 (default: 5683)"
+    echo "  --use-dtls                   Measure over DTLS (handshake included)"
+    echo ""
+    echo "Example:"
+    echo "  $0 --backend mbedtls --runs 100"
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --backend)
+            BACKEND="$2"
+            shift 2
+            ;;
+        --runs)
+            RUNS="$2"
+            shift 2
+            ;;
+        --port)
+            PORT="$2"
+            shift 2
+            ;;
+        --use-dtls)
+            USE_DTLS=true
+            shift
+            ;;
+        -h|--help)
+            usage
+            exit 0
+            ;;
+        *)
+            echo "Unknown option: $1"
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+if [[ "$BACKEND" != "wolfssl" && "$BACKEND" != "mbedtls" ]]; then
+    echo "ERROR: --backend must be 'wolfssl' or 'mbedtls'"
+    usage
+    exit 1
+fi
+
+if [ ! -x "$BENCH_SERVER_BIN" ]; then
+    echo "ERROR: bench server not found at $BENCH_SERVER_BIN"
+    echo "Run ./scripts/build_bench_server.sh first or set BENCH_SERVER_BIN"
+    exit 1
+fi
+
+TARGET=(--coap-path /echo --coap-port "$PORT")
+if [ "$USE_DTLS" = true ]; then
+    if [ ! -f "$PROJECT_ROOT/certs/server.crt" ]; then
+        echo "ERROR: no server certificate, run ./scripts/generate_certs.sh first"
+        exit 1
+    fi
+    TARGET=(--coap-path /echo --coap-port $((PORT + 1)) --use-dtls)
+fi
+
+mkdir -p "$LOG_DIR"
+SERVER_ARGS=(-A 127.0.0.1 -p "$PORT")
+if [ "$USE_DTLS" = true ]; then
+    SERVER_ARGS+=(-c "$PROJECT_ROOT/certs/server.crt"
+                  -j "$PROJECT_ROOT/certs/server.key" -n)
+fi
+"$BENCH_SERVER_BIN" "${SERVER_ARGS[@]}" > "$LOG_DIR/server.log" 2>&1 &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null || true' EXIT
+
+# Send to response in us, one line per run, from the "Send to response: N us"
+# log line of the app module
+measure() {
+    local variant=$1
+    shift
+
+    "$PROJECT_ROOT/scripts/build.sh" --backend "$BACKEND" --board native_sim \
+        --coap-ip 127.0.0.1 "${TARGET[@]}" "$@" --clean \
+        > "$LOG_DIR/build-$variant.log" 2>&1 || {
+        echo "Build failed, see $LOG_DIR/build-$variant.log" >&2
+        exit 1
+    }
+    : > "$LOG_DIR/samples-$variant.txt"
+    for ((i = 0; i < RUNS; i++)); do
+        "$PROJECT_ROOT/$BACKEND/build/zephyr/zephyr.exe" \
+            > "$LOG_DIR/run-$variant.log" 2>&1 || true
+        sed -n 's/.*Send to response: \([0-9]*\) us.*/\1/p' \
+            "$LOG_DIR/run-$variant.log" >> "$LOG_DIR/samples-$variant.txt"
+    done
+}
+
+# count, min, median, p90, mean of the samples of a variant
+summary() {
+    sort -n "$LOG_DIR/samples-$1.txt" | awk '
+        { v[NR] = $1; sum += $1 }
+        END {
+            if (NR == 0) { print "0 0 0 0 0"; exit }
+            printf "%d %d %d %d %d\n", NR, v[1], v[int((NR + 1) / 2)],
+                   v[int((NR * 9 + 9) / 10)], sum / NR
+        }'
+}
+
+echo "=== Log latency: $RUNS runs per variant ==="
+measure immediate --log-mode immediate --pdu-trace
+measure deferred --log-mode deferred
+
+read -r n_i min_i med_i p90_i mean_i <<< "$(summary immediate)"
+read -r n_d min_d med_d p90_d mean_d <<< "$(summary deferred)"
+
+echo ""
+echo "=== LOG LATENCY ($BACKEND) ==="
+printf "%-34s %5s %8s %8s %8s %8s\n" "Send to response (us)" "runs" \
+    "min" "median" "p90" "mean"
+printf "%-34s %5d %8d %8d %8d %8d\n" "immediate logging, PDU dumps" \
+    "$n_i" "$min_i" "$med_i" "$p90_i" "$mean_i"
+printf "%-34s %5d %8d %8d %8d %8d\n" "deferred logging, no dumps" \
+    "$n_d" "$min_d" "$med_d" "$p90_d" "$mean_d"
+printf "%-34s %5s %8d %8d %8d %8d\n" "difference" "" \
+    $((min_i - min_d)) $((med_i - med_d)) $((p90_i - p90_d)) \
+    $((mean_i - mean_d))
+echo "=== END LOG LATENCY ==="
+
+if [ "$n_i" -eq 0 ] || [ "$n_d" -eq 0 ]; then
+    echo "No samples, see $LOG_DIR/run-*.log"
+    exit 1
+fi
@@ -0,0 +1,287 @@
+#!/usr/bin/env python3
+# ./scripts/perf_gate.py
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Performance regression gate on native_sim. Builds the client once per
+# configuration (plain UDP, DTLS, Block2 transfers), runs each build
+# several times against a local bench server and reduces every metric
+# (latency percentiles from the histograms, throughput, heap peak, flash
+# size) to a mean with a 95% confidence interval. A metric regresses when
+# its whole interval is worse than the baseline in
+# <backend>/perf_baseline.json by more than the tolerance, so run-to-run
+# noise alone does not fail the gate. Exits with status 1 on a regression
+# or a failed build or run, 2 when a configuration has no baseline yet
+# (--update records one); at once when none of them has one.
+
+import argparse
+import json
+import math
+import os
+import re
+import subprocess
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import hist  # noqa: E402
+
+# Build arguments of each configuration, on top of the target
+CONFIGS = {
+    "udp": ["--coap-path", "/echo", "--swarm", "{clients}",
+            "--swarm-interval", "100", "--swarm-duration", "{duration}"],
+    "dtls": ["--coap-path", "/echo", "--use-dtls", "--coap-port", "{dtls_port}",
+             "--swarm", "{clients}", "--swarm-interval", "100",
+             "--swarm-duration", "{duration}"],
+    "block": ["--coap-path", "/size?n=65536", "--bulk-duration", "{duration}"],
+}
+
+# Metric: (report line, group of its tolerance, True if higher is better)
+REPORT = {
+    "requests_per_s": (re.compile(r"^Request rate: (\d+)/s"),
+                       "throughput", True),
+    "handshakes_per_s": (re.compile(r"^Handshakes: .*, (\d+)/s$"),
+                         "throughput", True),
+    "goodput_bps": (re.compile(r"^Goodput: (\d+) bytes/s"),
+                    "throughput", True),
+    "heap_peak_bytes": (re.compile(r"^libc heap: \d+ used, (\d+) peak"),
+                        "heap", False),
+    "session_peak_bytes": (re.compile(r"^Heap: \d+ bytes per session, "
+                                      r"(\d+) at peak"), "heap", False),
+}
+HISTOGRAMS = {"response": (50, 90, 99), "handshake": (50, 99)}
+HIGHER_IS_BETTER = {name: better for name, (_, _, better) in REPORT.items()}
+
+
+def group_of(metric):
+    if metric in REPORT:
+        return REPORT[metric][1]
+    return "flash" if metric == "flash_bytes" else "latency"
+
+
+# Two-sided 95% quantiles of Student's t for 1..30 degrees of freedom
+T95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+       2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+       2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+       2.048, 2.045, 2.042]
+
+
+def interval(samples):
+    """Mean and 95% confidence interval of the mean"""
+    n = len(samples)
+    mean = sum(samples) / n
+    if n < 2:
+        return mean, mean, mean
+    sd = math.sqrt(sum((x - mean) ** 2 for x in samples) / (n - 1))
+    half = (T95[n - 2] if n - 1 <= len(T95) else 1.96) * sd / math.sqrt(n)
+    return mean, mean - half, mean + half
+
+
+def parse_run(log):
+    """Metrics of one client run from its console output"""
+    metrics = {}
+    for line in log.splitlines():
+        for name, (pattern, _, _) in REPORT.items():
+            m = pattern.search(line.strip())
+            if m:
+                metrics[name] = int(m.group(1))
+        m = hist.LINE.search(line)
+        if m and m.group(1) in HISTOGRAMS:
+            h = hist.decode(bytes.fromhex(m.group(2)))
+            for pct in HISTOGRAMS[m.group(1)]:
+                metrics["%s_p%d_us" % (m.group(1), pct)] = h.percentile(pct)
+    return metrics
+
+
+def flash_size(exe):
+    """text + data of the executable, what would be in flash"""
+    out = subprocess.run(["size", exe], capture_output=True, text=True,
+                         check=True).stdout
+    text, data = out.splitlines()[1].split()[:2]
+    return int(text) + int(data)
+
+
+def measure(root, backend, config, args, log_dir):
+    build_log = os.path.join(log_dir, "build-%s.log" % config)
+    params = {"clients": args.clients, "duration": args.duration,
+              "dtls_port": args.port + 1}
+    cmd = [os.path.join(root, "scripts", "build.sh"), "--backend", backend,
+           "--board", "native_sim", "--coap-ip", "127.0.0.1",
+           "--coap-port", str(args.port), "--histograms", "--clean"]
+    cmd += [a.format(**params) for a in CONFIGS[config]]
+    with open(build_log, "w") as f:
+        if subprocess.run(cmd, stdout=f, stderr=subprocess.STDOUT).returncode:
+            return None, "build failed, see %s" % build_log
+
+    exe = os.path.join(root, backend, "build", "zephyr", "zephyr.exe")
+    samples = {"flash_bytes": [flash_size(exe)]}
+    for run in range(args.runs):
+        run_log = os.path.join(log_dir, "run-%s-%d.log" % (config, run + 1))
+        try:
+            out = subprocess.run([exe], capture_output=True, text=True,
+                                 errors="replace",
+                                 timeout=args.duration * 4 + 120).stdout
+        except subprocess.TimeoutExpired as e:
+            out = (e.stdout or b"").decode(errors="replace")
+        with open(run_log, "w") as f:
+            f.write(out)
+        metrics = parse_run(out)
+        if not metrics:
+            return None, "run %d has no report, see %s" % (run + 1, run_log)
+        for name, value in metrics.items():
+            samples.setdefault(name, []).append(value)
+    return samples, None
+
+
+def compare(config, samples, baseline, tolerance):
+    rows = {}
+    regressions = []
+    for name, values in sorted(samples.items()):
+        mean, low, high = interval(values)
+        row = {"mean": round(mean, 1), "ci95": [round(low, 1),
+                                                round(high, 1)],
+               "runs": len(values)}
+        base = baseline.get(name)
+        if base is not None:
+            tol = tolerance.get(group_of(name), tolerance.get("default", 10))
+            row["baseline"] = base
+            if HIGHER_IS_BETTER.get(name, False):
+                row["limit"] = round(base * (100 - tol) / 100, 1)
+                worse = high < row["limit"]
+            else:
+                row["limit"] = round(base * (100 + tol) / 100, 1)
+                worse = low > row["limit"]
+            if worse:
+                regressions.append({"config": config, "metric": name,
+                                    "mean": row["mean"], "ci95": row["ci95"],
+                                    "baseline": base, "limit": row["limit"]})
+        rows[name] = row
+    return rows, regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Performance regression gate on native_sim")
+    parser.add_argument("--backend", required=True,
+                        choices=["mbedtls", "wolfssl"])
+    parser.add_argument("--configs", default=",".join(CONFIGS),
+                        help="comma-separated subset of %s (default: all)"
+                             % ", ".join(CONFIGS))
+    parser.add_argument("--runs", type=int,
+                        help="runs per configuration (default: the "
+                             "baseline's, or 5)")
+    parser.add_argument("--duration", type=int, default=10,
+                        help="seconds of steady load per run (default: 10)")
+    parser.add_argument("--clients", type=int, default=20,
+                        help="swarm sessions of the udp and dtls "
+                             "configurations (default: 20)")
+    parser.add_argument("--port", type=int, default=5683,
+                        help="bench server port, DTLS on port+1 "
+                             "(default: 5683)")
+    parser.add_argument("--baseline",
+                        help="default: <backend>/perf_baseline.json")
+    parser.add_argument("--logs", default="/tmp/coap-perf",
+                        help="build and run logs (default: /tmp/coap-perf)")
+    parser.add_argument("--output", help="also write the JSON result here")
+    parser.add_argument("--update", action="store_true",
+                        help="record the measured means as the baseline")
+    args = parser.parse_args()
+
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    baseline_path = args.baseline or os.path.join(root, args.backend,
+                                                  "perf_baseline.json")
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+    args.runs = args.runs or baseline.get("runs", 5)
+    configs = args.configs.split(",")
+    for config in configs:
+        if config not in CONFIGS:
+            sys.exit("ERROR: unknown configuration '%s'" % config)
+    # Nothing to compare against: skip the builds and runs
+    if not args.update and not any(baseline.get("configs", {}).get(config)
+                                   for config in configs):
+        print("No baseline for %s in %s, record one with --update"
+              % (", ".join(configs), baseline_path), file=sys.stderr)
+        return 2
+
+    server_bin = os.environ.get("BENCH_SERVER_BIN", os.path.join(
+        root, "bench", "build", "bench-server"))
+    if not os.access(server_bin, os.X_OK):
+        sys.exit("ERROR: bench server not found at %s, run "
+                 "./scripts/build_bench_server.sh first" % server_bin)
+    certs = os.path.join(root, "certs")
+    if not os.path.exists(os.path.join(certs, "server.crt")):
+        sys.exit("ERROR: no server certificate, run "
+                 "./scripts/generate_certs.sh first")
+
+    os.makedirs(args.logs, exist_ok=True)
+    server_log = open(os.path.join(args.logs, "server.log"), "w")
+    server = subprocess.Popen(
+        [server_bin, "-A", "127.0.0.1", "-p", str(args.port),
+         "-c", os.path.join(certs, "server.crt"),
+         "-j", os.path.join(certs, "server.key"), "-n"],
+        stdout=server_log, stderr=subprocess.STDOUT)
+    time.sleep(1)
+
+    result = {"backend": args.backend, "runs": args.runs, "configs": {}}
+    failed = []
+    regressions = []
+    missing = []
+    tolerance = baseline.get("tolerance_pct", {})
+    try:
+        for config in configs:
+            print("=== Perf: %s (%d runs) ===" % (config, args.runs),
+                  file=sys.stderr)
+            samples, error = measure(root, args.backend, config, args,
+                                     args.logs)
+            if error:
+                failed.append({"config": config, "error": error})
+                continue
+            base = baseline.get("configs", {}).get(config)
+            if args.update:
+                base = {name: round(interval(values)[0], 1)
+                        for name, values in samples.items()}
+                baseline.setdefault("configs", {})[config] = base
+            if not base:
+                missing.append(config)
+            rows, worse = compare(config, samples, base or {}, tolerance)
+            result["configs"][config] = rows
+            regressions += worse
+    finally:
+        server.terminate()
+        server.wait()
+        server_log.close()
+
+    if args.update and not failed:
+        with open(baseline_path, "w") as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+            f.write("\n")
+
+    result["failed"] = failed
+    result["regressions"] = regressions
+    result["pass"] = not failed and not regressions and not missing
+
+    text = json.dumps(result, indent=2)
+    print(text)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+
+    for f in failed:
+        print("%s: %s" % (f["config"], f["error"]), file=sys.stderr)
+    for r in regressions:
+        print("%s %s: %.1f [%.1f, %.1f], baseline %.1f, limit %.1f" % (
+            r["config"], r["metric"], r["mean"], r["ci95"][0], r["ci95"][1],
+            r["baseline"], r["limit"]), file=sys.stderr)
+    if failed or regressions:
+        return 1
+    if missing:
+        print("No baseline for %s in %s, record one with --update"
+              % (", ".join(missing), baseline_path), file=sys.stderr)
+        return 2
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
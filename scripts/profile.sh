@@ -0,0 +1,192 @@
+#!/bin/bash
+# ./scripts/profile.sh
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# CPU flame graphs of the client on native_sim: build it for profiling
+# (--profile) once per workload, run it under perf against a local bench
+# server and fold the sampled stacks into an SVG with Brendan Gregg's
+# FlameGraph scripts. Workloads: a plain GET loop on one session, DTLS
+# handshakes (a swarm of clients, each opening a session) and Block2
+# transfers.
+
+set -e
+
+PROJECT_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BENCH_SERVER_BIN="${BENCH_SERVER_BIN:-$PROJECT_ROOT/bench/build/bench-server}"
+FLAMEGRAPH_DIR="${FLAMEGRAPH_DIR:-$PROJECT_ROOT/FlameGraph}"
+OUT_DIR="/tmp/coap-profile"
+
+# Defaults
+BACKEND=""
+WORKLOADS="get,handshake,block"
+DURATION=20
+FREQ=999
+CLIENTS=200
+BLOCK_SIZE=65536
+PORT=5683
+
+usage() {
+    echo "Usage: $0 --backend <wolfssl|mbedtls> [options]"
+    echo ""
+    echo "Required:"
+    echo "  --backend <wolfssl|mbedtls>  TLS backend to use"
+    echo ""
+    echo "Optional:"
+    echo "  --workloads <list>           Comma-separated subset of get, handshake, block"
+    echo "                               (default: all)"
+    echo "  --duration <seconds>         Length of the GET loop and block transfers"
+    echo "                               (default: 20)"
+    echo "  --clients <n>                Sessions opened by the handshake workload"
+    echo "                               (default: 200)"
+    echo "  --block-size <bytes>         Body of each block transfer (default: 65536)"
+    echo "  --freq <hz>                  perf sampling frequency (default: 999)"
+    echo "  --port <port>                Bench server port, DTLS on port+1 (default: 5683)"
+    echo "  --output <dir>               Flame graphs and perf data (default: $OUT_DIR)"
+    echo ""
+    echo "Needs perf and the FlameGraph scripts (\$FLAMEGRAPH_DIR, default ./FlameGraph:"
+    echo "git clone https://github.com/brendangregg/FlameGraph)."
+    echo ""
+    echo "Example:"
+    echo "  $0 --backend mbedtls --workloads get,handshake --duration 30"
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --backend)
+            BACKEND="$2"
+            shift 2
+            ;;
+        --workloads)
+            WORKLOADS="$2"
+            shift 2
+            ;;
+        --duration)
+            DURATION="$2"
+            shift 2
+            ;;
+        --clients)
+            CLIENTS="$2"
+            shift 2
+            ;;
+        --block-size)
+            BLOCK_SIZE="$2"
+            shift 2
+            ;;
+        --freq)
+            FREQ="$2"
+            shift 2
+            ;;
+        --port)
+            PORT="$2"
+            shift 2
+            ;;
+        --output)
+            OUT_DIR="$2"
+            shift 2
+            ;;
+        -h|--help)
+            usage
+            exit 0
+            ;;
+        *)
+            echo "Unknown option: $1"
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+if [[ "$BACKEND" != "wolfssl" && "$BACKEND" != "mbedtls" ]]; then
+    echo "ERROR: --backend must be 'wolfssl' or 'mbedtls'"
+    usage
+    exit 1
+fi
+
+if ! command -v perf > /dev/null; then
+    echo "ERROR: perf not found (linux-tools / linux-perf package)"
+    exit 1
+fi
+
+if [ ! -x "$FLAMEGRAPH_DIR/flamegraph.pl" ]; then
+    echo "ERROR: FlameGraph scripts not found in $FLAMEGRAPH_DIR"
+    echo "Clone https://github.com/brendangregg/FlameGraph or set FLAMEGRAPH_DIR"
+    exit 1
+fi
+
+if [ ! -x "$BENCH_SERVER_BIN" ]; then
+    echo "ERROR: bench server not found at $BENCH_SERVER_BIN"
+    echo "Run ./scripts/build_bench_server.sh first or set BENCH_SERVER_BIN"
+    exit 1
+fi
+
+if [ ! -f "$PROJECT_ROOT/certs/server.crt" ]; then
+    echo "ERROR: no server certificate, run ./scripts/generate_certs.sh first"
+    exit 1
+fi
+
+mkdir -p "$OUT_DIR"
+"$BENCH_SERVER_BIN" -A 127.0.0.1 -p "$PORT" \
+    -c "$PROJECT_ROOT/certs/server.crt" -j "$PROJECT_ROOT/certs/server.key" -n \
+    > "$OUT_DIR/server.log" 2>&1 &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null || true' EXIT
+
+FAILED=()
+IFS=',' read -ra WORKLOAD_LIST <<< "$WORKLOADS"
+for workload in "${WORKLOAD_LIST[@]}"; do
+    # Every workload is one build, with the report block that goes with it
+    case $workload in
+        get)
+            ARGS=(--coap-path /echo --bulk-duration "$DURATION")
+            REPORT="BULK TRANSFER"
+            ;;
+        handshake)
+            ARGS=(--coap-path /echo --use-dtls --coap-port $((PORT + 1))
+                  --swarm "$CLIENTS" --swarm-duration 1)
+            REPORT="SWARM"
+            ;;
+        block)
+            ARGS=(--coap-path "/size?n=$BLOCK_SIZE" --bulk-duration "$DURATION")
+            REPORT="BULK TRANSFER"
+            ;;
+        *)
+            echo "ERROR: unknown workload '$workload'"
+            exit 1
+            ;;
+    esac
+
+    echo "=== Profile: $workload ==="
+    "$PROJECT_ROOT/scripts/build.sh" --backend "$BACKEND" --board native_sim \
+        --coap-ip 127.0.0.1 --coap-port "$PORT" --profile "${ARGS[@]}" \
+        --clean > "$OUT_DIR/build-$workload.log" 2>&1 || {
+        echo "Build failed, see $OUT_DIR/build-$workload.log"
+        FAILED+=("$workload")
+        continue
+    }
+
+    # Call graphs from the frame pointers of the profiling build
+    if ! perf record -F "$FREQ" -g -o "$OUT_DIR/perf-$workload.data" -- \
+        "$PROJECT_ROOT/$BACKEND/build/zephyr/zephyr.exe" \
+        > "$OUT_DIR/run-$workload.log" 2>&1; then
+        echo "Run failed, see $OUT_DIR/run-$workload.log"
+        FAILED+=("$workload")
+        continue
+    fi
+    sed -n "/=== $REPORT ===/,/=== END $REPORT ===/p" \
+        "$OUT_DIR/run-$workload.log"
+
+    perf script -i "$OUT_DIR/perf-$workload.data" 2> /dev/null |
+        "$FLAMEGRAPH_DIR/stackcollapse-perf.pl" \
+        > "$OUT_DIR/$workload.folded"
+    "$FLAMEGRAPH_DIR/flamegraph.pl" \
+        --title "$BACKEND: $workload" > "$OUT_DIR/$workload.svg" \
+        < "$OUT_DIR/$workload.folded"
+    echo "Flame graph: $OUT_DIR/$workload.svg"
+done
+
+if [ ${#FAILED[@]} -gt 0 ]; then
+    echo "Profiling failed: ${FAILED[*]}"
+    exit 1
+fi
@@ -0,0 +1,140 @@
+#!/bin/bash
+# ./scripts/soak.sh
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Soak test on native_sim: build and run the client in soak mode against a
+# local bench server, once per mode, and fail if any run reports a leak,
+# heap fragmentation or too many failed cycles
+
+set -e
+
+PROJECT_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BENCH_SERVER_BIN="${BENCH_SERVER_BIN:-$PROJECT_ROOT/bench/build/bench-server}"
+LOG_DIR="/tmp/coap-soak"
+
+# Defaults
+BACKEND=""
+CYCLES=200000
+MODES="plain,dtls-request,dtls-persistent,blockwise"
+PORT=5683
+
+usage() {
+    echo "Usage: $0 --backend <wolfssl|mbedtls> [options]"
+    echo ""
+    echo "Required:"
+    echo "  --backend <wolfssl|mbedtls>  TLS backend to use"
+    echo ""
+    echo "Optional:"
+    echo "  --cycles <n>                 Request cycles per mode (default: 200000)"
+    echo "  --modes <list>               Comma-separated subset of plain, dtls-request,"
+    echo "                               dtls-persistent, blockwise (default: all)"
+    echo "  --port <port>                Bench server port, DTLS on port+1 (default: 5683)"
+    echo ""
+    echo "Example:"
+    echo "  $0 --backend mbedtls --cycles 500000 --modes dtls-request,blockwise"
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --backend)
+            BACKEND="$2"
+            shift 2
+            ;;
+        --cycles)
+            CYCLES="$2"
+            shift 2
+            ;;
+        --modes)
+            MODES="$2"
+            shift 2
+            ;;
+        --port)
+            PORT="$2"
+            shift 2
+            ;;
+        -h|--help)
+            usage
+            exit 0
+            ;;
+        *)
+            echo "Unknown option: $1"
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+if [[ "$BACKEND" != "wolfssl" && "$BACKEND" != "mbedtls" ]]; then
+    echo "ERROR: --backend must be 'wolfssl' or 'mbedtls'"
+    usage
+    exit 1
+fi
+
+if [ ! -x "$BENCH_SERVER_BIN" ]; then
+    echo "ERROR: bench server not found at $BENCH_SERVER_BIN"
+    echo "Run ./scripts/build_bench_server.sh first or set BENCH_SERVER_BIN"
+    exit 1
+fi
+
+if [ ! -f "$PROJECT_ROOT/certs/server.crt" ]; then
+    echo "ERROR: no server certificate, run ./scripts/generate_certs.sh first"
+    exit 1
+fi
+
+mkdir -p "$LOG_DIR"
+"$BENCH_SERVER_BIN" -A 127.0.0.1 -p "$PORT" \
+    -c "$PROJECT_ROOT/certs/server.crt" -j "$PROJECT_ROOT/certs/server.key" -n \
+    > "$LOG_DIR/server.log" 2>&1 &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null || true' EXIT
+
+FAILED=()
+IFS=',' read -ra MODE_LIST <<< "$MODES"
+for mode in "${MODE_LIST[@]}"; do
+    # Every mode is one build: transport, session reuse and resource
+    case $mode in
+        plain)
+            ARGS=(--coap-path /echo)
+            ;;
+        dtls-request)
+            ARGS=(--coap-path /echo --use-dtls --coap-port $((PORT + 1)))
+            ;;
+        dtls-persistent)
+            ARGS=(--coap-path /echo --use-dtls --coap-port $((PORT + 1))
+                  --soak-persistent)
+            ;;
+        blockwise)
+            ARGS=(--coap-path "/size?n=8192" --soak-persistent)
+            ;;
+        *)
+            echo "ERROR: unknown mode '$mode'"
+            exit 1
+            ;;
+    esac
+
+    echo "=== Soak: $mode, $CYCLES cycles ==="
+    "$PROJECT_ROOT/scripts/build.sh" --backend "$BACKEND" --board native_sim \
+        --coap-ip 127.0.0.1 --coap-port "$PORT" --soak "$CYCLES" \
+        "${ARGS[@]}" --clean > "$LOG_DIR/build-$mode.log" 2>&1 || {
+        echo "Build failed, see $LOG_DIR/build-$mode.log"
+        FAILED+=("$mode")
+        continue
+    }
+
+    if "$PROJECT_ROOT/$BACKEND/build/zephyr/zephyr.exe" \
+        > "$LOG_DIR/run-$mode.log" 2>&1; then
+        echo "PASSED (log: $LOG_DIR/run-$mode.log)"
+    else
+        FAILED+=("$mode")
+        echo "FAILED (log: $LOG_DIR/run-$mode.log)"
+    fi
+    sed -n '/=== SOAK ===/,/=== END SOAK ===/p' "$LOG_DIR/run-$mode.log"
+done
+
+if [ ${#FAILED[@]} -gt 0 ]; then
+    echo "Soak failed: ${FAILED[*]}"
+    exit 1
+fi
+echo "Soak passed: ${MODES}"
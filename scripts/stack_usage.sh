@@ -0,0 +1,116 @@
+#!/bin/bash
+# ./scripts/stack_usage.sh
+#
+# Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+# Author: Javier Blanco-Romero
+#
+# Summarise the -fstack-usage files of a --stack-report build: the largest
+# stack frames per module (app, libcoap, TLS, network/Wi-Fi, Zephyr), and
+# every function whose frame is dynamic (alloca, variable length arrays)
+
+set -e
+
+PROJECT_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+
+# Defaults
+BACKEND=""
+BUILD_DIR=""
+TOP=10
+
+usage() {
+    echo "Usage: $0 --backend <wolfssl|mbedtls> [options]"
+    echo ""
+    echo "Required:"
+    echo "  --backend <wolfssl|mbedtls>  Backend whose build is summarised"
+    echo ""
+    echo "Optional:"
+    echo "  --build-dir <dir>            Build directory (default: <backend>/build)"
+    echo "  --top <n>                    Largest frames listed per module (default: 10)"
+    echo ""
+    echo "Example:"
+    echo "  ./scripts/build.sh --backend mbedtls --stack-report ... && \\"
+    echo "     $0 --backend mbedtls --top 20"
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --backend)
+            BACKEND="$2"
+            shift 2
+            ;;
+        --build-dir)
+            BUILD_DIR="$2"
+            shift 2
+            ;;
+        --top)
+            TOP="$2"
+            shift 2
+            ;;
+        -h|--help)
+            usage
+            exit 0
+            ;;
+        *)
+            echo "Unknown option: $1"
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+if [[ "$BACKEND" != "wolfssl" && "$BACKEND" != "mbedtls" ]]; then
+    echo "ERROR: --backend must be 'wolfssl' or 'mbedtls'"
+    usage
+    exit 1
+fi
+BUILD_DIR="${BUILD_DIR:-$PROJECT_ROOT/$BACKEND/build}"
+
+SU_FILES=$(find "$BUILD_DIR" -name "*.su" 2>/dev/null)
+if [ -z "$SU_FILES" ]; then
+    echo "ERROR: no .su files in $BUILD_DIR, build with --stack-report first"
+    exit 1
+fi
+
+# One line per function: module, frame bytes, qualifiers, function, source.
+# The module comes from where the object was built, since the app
+# directories are themselves called mbedtls/ and wolfssl/.
+FRAMES=$(echo "$SU_FILES" | while read -r su; do
+    rel="${su#"$BUILD_DIR"/}"
+    case $rel in
+        CMakeFiles/app.dir/*) module=app ;;
+        modules/libcoap/*) module=libcoap ;;
+        modules/mbedtls/*|modules/wolfssl/*) module=tls ;;
+        zephyr/subsys/net/*|zephyr/drivers/wifi/*|modules/hal_espressif/*)
+            module=net ;;
+        *) module=zephyr ;;
+    esac
+    # file:line:column:function<TAB>bytes<TAB>qualifiers
+    awk -F'\t' -v module="$module" '{
+        n = split($1, loc, ":")
+        printf "%s\t%s\t%s\t%s\t%s:%s\n", module, $2, $3, loc[n], loc[1], loc[2]
+    }' "$su"
+done)
+
+echo "=== STACK USAGE ($BACKEND) ==="
+for module in app libcoap tls net zephyr; do
+    lines=$(echo "$FRAMES" | awk -F'\t' -v m="$module" '$1 == m')
+    if [ -z "$lines" ]; then
+        continue
+    fi
+    count=$(echo "$lines" | wc -l)
+    echo ""
+    echo "$module: $count functions, largest frames:"
+    echo "$lines" | sort -t$'\t' -k2,2nr | head -n "$TOP" | \
+        awk -F'\t' '{ printf "  %6d  %-15s %s (%s)\n", $2, $3, $4, $5 }'
+done
+
+dynamic=$(echo "$FRAMES" | awk -F'\t' '$3 ~ /dynamic/ && $3 !~ /bounded/')
+echo ""
+if [ -n "$dynamic" ]; then
+    echo "Unbounded dynamic frames (alloca/VLA):"
+    echo "$dynamic" | sort -t$'\t' -k2,2nr | \
+        awk -F'\t' '{ printf "  %6d+ %-7s %s (%s)\n", $2, $1, $4, $5 }'
+else
+    echo "No unbounded dynamic frames"
+fi
+echo "=== END STACK USAGE ==="
@@ -0,0 +1,25 @@
+/*
+ * wolfssl/include/client.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Helpers shared between the CoAP client main loop and its modules
+ */
+
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <coap3/coap.h>
+
+void cleanup_resources(coap_context_t *ctx, coap_session_t *session,
+                       coap_optlist_t *optlist);
+int setup_destination_address(coap_address_t *dst, const char *host,
+                              uint16_t port);
+int parse_host_port(const char *spec, size_t len, uint16_t default_port,
+                    char *host, size_t host_size, uint16_t *port);
+coap_session_t *open_session(coap_context_t *ctx, const coap_address_t *dst);
+/* libcoap session events for the modules that count them; a mode that
+ * registers its own event handler passes them on */
+int client_event(coap_session_t *session, const coap_event_t event);
+
+#endif /* CLIENT_H */
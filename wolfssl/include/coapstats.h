@@ -0,0 +1,40 @@
+/*
+ * wolfssl/include/coapstats.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Per-session libcoap statistics: retransmissions, NACKs, DTLS errors,
+ * session events, RTT and duplicate responses
+ */
+
+#ifndef COAPSTATS_H
+#define COAPSTATS_H
+
+#include <coap3/coap.h>
+
+/* Sessions tracked; sessions to the same peer over the same transport
+ * share one row, later peers go uncounted once all rows are taken */
+#ifndef COAPSTATS_SESSIONS
+#define COAPSTATS_SESSIONS 8
+#endif
+/* Requests per session whose send time is kept for the RTT */
+#define COAPSTATS_PENDING 8
+/* Answered tokens per session remembered to recognise duplicates */
+#define COAPSTATS_ANSWERED 8
+/* Serialised /stats document */
+#define COAPSTATS_DOC_SIZE 1536
+
+/* The /stats resource on ctx */
+void coapstats_init(coap_context_t *ctx);
+/* From the context's event handler */
+int coapstats_event(coap_session_t *session, const coap_event_t event);
+/* A request leaves through coap_send() */
+void coapstats_sent(coap_session_t *session, const coap_pdu_t *pdu);
+/* From the response handler, before any dispatch */
+void coapstats_response(coap_session_t *session, const coap_pdu_t *received);
+/* From the NACK handler */
+void coapstats_nack(coap_session_t *session, const coap_pdu_t *sent,
+                    coap_nack_reason_t reason);
+void coapstats_report(void);
+
+#endif /* COAPSTATS_H */
@@ -153,7 +153,9 @@ extern "C" {
 #define HAVE_HASHDRBG
 #define WC_RNG_SEED_CB
 
-/* Memory and stack optimization */
+/* Memory and stack optimization. WOLFSSL_SMALL_STACK already moves the
+ * large temporaries to the heap, so reduced-stack mode adds nothing
+ * here. */
 #define WOLFSSL_SMALL_STACK
 #define NO_BENCH
 #define WOLFSSL_NO_BENCH
@@ -174,6 +176,18 @@ extern "C" {
 /* Threading */
 #define SINGLE_THREADED
 
+/* Memory: TLS heap of the client (src/heaps.c) */
+#ifdef CONFIG_APP_HEAPS
+#include <stddef.h>
+void *heaps_tls_malloc(size_t size);
+void *heaps_tls_realloc(void *p, size_t size);
+void heaps_tls_free(void *p);
+#define XMALLOC_OVERRIDE
+#define XMALLOC(s, h, t) ((void)(h), (void)(t), heaps_tls_malloc((s)))
+#define XFREE(p, h, t) heaps_tls_free((p))
+#define XREALLOC(p, n, h, t) heaps_tls_realloc((p), (n))
+#endif
+
 /* Debugging - prevents redefinition warnings */
 #ifdef CONFIG_WOLFSSL_DEBUG
     #ifndef DEBUG_WOLFSSL
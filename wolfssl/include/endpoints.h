@@ -0,0 +1,51 @@
+/*
+ * wolfssl/include/endpoints.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Multi-server RTT probing and endpoint selection for CoAP client
+ */
+
+#ifndef ENDPOINTS_H
+#define ENDPOINTS_H
+
+#include <coap3/coap.h>
+
+/* Maximum number of endpoints accepted from COAP_SERVER_ENDPOINTS */
+#define ENDPOINTS_MAX 4
+
+/* Interval between two CoAP pings to the same endpoint */
+#define ENDPOINT_PROBE_INTERVAL_MS 5000
+/* Number of probe rounds run against every endpoint before selection */
+#define ENDPOINT_WARMUP_ROUNDS 5
+/* Interval between the initial probe rounds run before selection */
+#define ENDPOINT_WARMUP_INTERVAL_MS 250
+/* A probe with no Pong/RST after this time is counted as lost */
+#define ENDPOINT_PROBE_TIMEOUT_MS 2000
+
+/* EWMA weight for RTT and loss samples is 1/2^ENDPOINT_EWMA_SHIFT */
+#define ENDPOINT_EWMA_SHIFT 3
+/* Cost added to the RTT score for a 100% loss rate (one ACK_TIMEOUT) */
+#define ENDPOINT_LOSS_PENALTY_MS 2000
+
+/* Hysteresis: a candidate must beat the current endpoint by this margin... */
+#define ENDPOINT_SWITCH_MARGIN_PCT 20
+/* ...on this many consecutive evaluations before we switch to it */
+#define ENDPOINT_SWITCH_ROUNDS 3
+/* Consecutive lost probes after which an endpoint is considered down */
+#define ENDPOINT_DEAD_LOSSES 3
+
+int endpoints_init(coap_context_t *ctx, const char *list,
+                   uint16_t default_port);
+int endpoints_warmup(coap_context_t *ctx, int rounds);
+void endpoints_poll(void);
+int endpoints_handle_reply(coap_session_t *session, coap_mid_t mid);
+/* Endpoint for the next request: the best one after the warm-up, then
+ * moved by the probes with hysteresis, or at once when it goes down */
+int endpoints_select(void);
+coap_session_t *endpoints_session(int index);
+const coap_address_t *endpoints_address(int index);
+void endpoints_report(void);
+void endpoints_cleanup(void);
+
+#endif /* ENDPOINTS_H */
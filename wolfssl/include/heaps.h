@@ -0,0 +1,44 @@
+/*
+ * wolfssl/include/heaps.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Separate heaps for libcoap and the TLS library
+ */
+
+#ifndef HEAPS_H
+#define HEAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum heaps_id {
+    HEAPS_COAP,
+    HEAPS_TLS,
+    HEAPS_COUNT,
+};
+
+struct heaps_counters {
+    size_t size;
+    size_t current;         /* Bytes handed out, allocator overhead included */
+    size_t peak;
+    uint32_t failures;
+};
+
+const char *heaps_name(enum heaps_id id);
+void heaps_get(enum heaps_id id, struct heaps_counters *counters);
+/* Largest block that can still be allocated, the fragmentation probe */
+size_t heaps_largest_free(enum heaps_id id);
+
+/* libcoap allocations that are not served by a memory pool */
+void *heaps_coap_malloc(size_t size);
+void *heaps_coap_realloc(void *p, size_t size);
+void heaps_coap_free(void *p);
+
+/* Hooked into the TLS library by its configuration header */
+void *heaps_tls_malloc(size_t size);
+void *heaps_tls_calloc(size_t n, size_t size);
+void *heaps_tls_realloc(void *p, size_t size);
+void heaps_tls_free(void *p);
+
+#endif /* HEAPS_H */
@@ -0,0 +1,73 @@
+/*
+ * wolfssl/include/hist.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Fixed-memory log-linear latency histograms
+ */
+
+#ifndef HIST_H
+#define HIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 2^HIST_SUB_BITS linear buckets per power of two, so a value is known to
+ * within 1/2^HIST_SUB_BITS (12.5%); values of 2^HIST_MAX_BITS us (134 s)
+ * and more share the last bucket. Histograms only merge with the same
+ * geometry, which the snapshot carries. */
+#ifndef HIST_SUB_BITS
+#define HIST_SUB_BITS 3
+#endif
+#ifndef HIST_MAX_BITS
+#define HIST_MAX_BITS 27
+#endif
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+enum hist_id {
+    HIST_RESPONSE,          /* coap_send() to response */
+    HIST_HANDSHAKE,         /* Session opened to DTLS/TLS connected */
+    HIST_WIFI_CONNECT,      /* Connect request to association */
+    HIST_DHCP,              /* Association to IPv4 address */
+    HIST_COUNT,
+};
+
+struct hist {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[HIST_BUCKETS];
+};
+
+/* Samples in us, recorded in constant time; the macro leaves the call
+ * out of builds without CONFIG_APP_HISTOGRAMS */
+#ifdef CONFIG_APP_HISTOGRAMS
+#define HIST_RECORD(id, us) hist_record((id), (us))
+#else
+#define HIST_RECORD(id, us) \
+    do {                    \
+    } while (0)
+#endif
+
+void hist_record(enum hist_id id, uint32_t us);
+const char *hist_name(enum hist_id id);
+const struct hist *hist_get(enum hist_id id);
+void hist_merge(struct hist *into, const struct hist *from);
+/* Upper bound of the bucket holding the given share (in per mille) of
+ * the samples, capped at the largest sample; 0 without samples */
+uint32_t hist_percentile(const struct hist *h, uint32_t permille);
+
+/* Binary snapshot (little endian), decoded by scripts/hist.py:
+ *   "HST1", u8 sub_bits, u8 max_bits, u8 id, u8 0,
+ *   u32 count, u32 min, u32 max, u64 sum, u16 n,
+ *   n x (u16 bucket, u32 samples)  -- non-empty buckets only
+ * Returns the bytes written, 0 when size is too small. */
+size_t hist_snapshot(enum hist_id id, uint8_t *buf, size_t size);
+#define HIST_SNAPSHOT_MAX (30 + 6 * HIST_BUCKETS)
+
+/* Percentiles of each histogram with samples, and its snapshot in hex
+ * on a "hist <name> <hex>" line for the host */
+void hist_report(void);
+
+#endif /* HIST_H */
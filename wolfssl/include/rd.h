@@ -0,0 +1,48 @@
+/*
+ * wolfssl/include/rd.h
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Resource Directory (RFC 9176) registration client
+ */
+
+#ifndef RD_H
+#define RD_H
+
+#include <coap3/coap.h>
+
+/* Registration resource on the directory server */
+#ifndef RD_PATH
+#define RD_PATH "rd"
+#endif
+/* Registration lifetime (lt) in seconds, RFC 9176 default is 90000 */
+#ifndef RD_LIFETIME_S
+#define RD_LIFETIME_S 90000
+#endif
+/* Links registered for this endpoint */
+#ifndef RD_LINKS
+#define RD_LINKS "</sensors/temp>;rt=\"temperature-c\";if=\"sensor\""
+#endif
+
+/* Refresh once this fraction of the lifetime has passed */
+#define RD_REFRESH_PCT 75
+/* Longest location path kept, including the NUL */
+#define RD_LOCATION_MAX 48
+/* Time allowed for one registration or refresh exchange */
+#define RD_TIMEOUT_MS 10000
+
+/* Per-datagram IPv4/UDP overhead, plus the DTLS 1.2 record overhead of an
+ * AES-CCM-8 suite (13 byte header, 8 byte explicit nonce, 8 byte tag) */
+#ifdef USE_DTLS
+#define RD_DATAGRAM_OVERHEAD (28 + 29)
+#else
+#define RD_DATAGRAM_OVERHEAD 28
+#endif
+
+void rd_init(const char *ep);
+int rd_update(coap_context_t *ctx, coap_session_t *session);
+void rd_poll(coap_session_t *session);
+int rd_handle_response(const coap_pdu_t *received);
+void rd_report(void);
+
+#endif /* RD_H */
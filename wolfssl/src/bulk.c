@@ -0,0 +1,240 @@
+/*
+ * wolfssl/src/bulk.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Bulk transfer goodput measurement over the client session.
+ *
+ * iperf-style: back-to-back Block2 downloads of the target resource, or
+ * Block1 uploads to it with BULK_UPLOAD, for a fixed number of rounds or
+ * a fixed time. They run over the session the main request already
+ * opened, so connection setup and handshakes are paid once and the
+ * figures only reflect the transfer. Alongside goodput it reports what
+ * the transfer cost: retransmissions from the network statistics, CPU
+ * from the thread runtime stats and the heap high-water marks, so runs
+ * over every transport, security and block size combination (and under
+ * scripts/impair.sh) can be compared.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "bulk.h"
+#include "instr.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+static uint8_t token[8];
+static size_t token_len;
+static int pending;
+static size_t body_bytes;
+static int szx;
+
+#ifdef BULK_UPLOAD
+static uint8_t upload_body[BULK_BODY_SIZE];
+#endif
+
+static int completed;
+static int failed;
+static uint64_t total_bytes;
+static uint32_t min_ms = UINT32_MAX;
+static uint32_t max_ms;
+static uint32_t sum_ms;
+static struct instr_sample started;
+static struct instr_sample finished;
+
+int bulk_handle_response(const coap_pdu_t *received) {
+    coap_bin_const_t tok = coap_pdu_get_token(received);
+    coap_pdu_code_t code = coap_pdu_get_code(received);
+
+    if (!pending || tok.length != token_len ||
+        memcmp(tok.s, token, token_len)) {
+        return 0;
+    }
+
+    if (COAP_RESPONSE_CLASS(code) != 2) {
+        LOG_WRN("Bulk transfer failed: %d.%02d", COAP_RESPONSE_CLASS(code),
+                code & 0x1F);
+        pending = 0;
+        failed++;
+        return 1;
+    }
+
+#ifdef BULK_UPLOAD
+    /* Final response once libcoap has sent every Block1 */
+    body_bytes = BULK_BODY_SIZE;
+    pending = 0;
+#else
+    const uint8_t *data;
+    size_t len, offset, total;
+
+    if (!coap_get_data_large(received, &len, &data, &offset, &total)) {
+        /* Empty body */
+        pending = 0;
+        return 1;
+    }
+    body_bytes += len;
+    /* Whole body (single-body mode) or last block of it */
+    if (offset + len >= total) {
+        pending = 0;
+    }
+#endif
+    return 1;
+}
+
+static int send_request(coap_session_t *session, coap_optlist_t **optlist) {
+    uint8_t buf[4];
+    coap_pdu_t *pdu;
+    size_t len;
+#ifdef BULK_UPLOAD
+    coap_pdu_code_t method = COAP_REQUEST_CODE_PUT;
+    coap_option_num_t block = COAP_OPTION_BLOCK1;
+#else
+    coap_pdu_code_t method = COAP_REQUEST_CODE_GET;
+    coap_option_num_t block = COAP_OPTION_BLOCK2;
+#endif
+
+    pdu = coap_new_pdu(COAP_MESSAGE_CON, method, session);
+    if (!pdu) {
+        return 0;
+    }
+    coap_session_new_token(session, &token_len, token);
+    coap_add_token(pdu, token_len, token);
+
+    if (*optlist && coap_add_optlist_pdu(pdu, optlist) != 1) {
+        coap_delete_pdu(pdu);
+        return 0;
+    }
+    /* Block num 0, M 0: only the size exponent is set, libcoap keeps it
+     * for the rest of the transfer */
+    len = coap_encode_var_safe(buf, sizeof(buf), szx);
+    if (!coap_add_option(pdu, block, len, buf)) {
+        coap_delete_pdu(pdu);
+        return 0;
+    }
+#ifdef BULK_UPLOAD
+    if (!coap_add_data_large_request(session, pdu, sizeof(upload_body),
+                                     upload_body, NULL, NULL)) {
+        coap_delete_pdu(pdu);
+        return 0;
+    }
+#endif
+    return coap_send(session, pdu) != COAP_INVALID_MID;
+}
+
+static int keep_going(int round) {
+    if (BULK_ROUNDS > 0) {
+        return round < BULK_ROUNDS;
+    }
+    return k_uptime_get() - started.uptime_ms < BULK_DURATION_S * 1000LL;
+}
+
+int bulk_run(coap_context_t *ctx, coap_session_t *session,
+             coap_optlist_t **optlist) {
+#ifdef BULK_SZX
+    szx = BULK_SZX;
+#else
+    szx = COAP_PROTO_RELIABLE(coap_session_get_proto(session)) ? BULK_SZX_BERT
+                                                                : BULK_SZX_UDP;
+#endif
+#ifdef BULK_UPLOAD
+    for (size_t i = 0; i < sizeof(upload_body); i++) {
+        upload_body[i] = 'a' + i % 26;
+    }
+#endif
+
+    LOG_INF("Bulk %s: %d %s, SZX %d, max PDU %u",
+            IS_ENABLED(BULK_UPLOAD) ? "upload" : "download",
+            BULK_ROUNDS > 0 ? BULK_ROUNDS : BULK_DURATION_S,
+            BULK_ROUNDS > 0 ? "rounds" : "s", szx,
+            (unsigned)coap_session_max_pdu_size(session));
+
+    instr_sample(&started);
+    for (int i = 0; keep_going(i); i++) {
+        int64_t start = k_uptime_get();
+        uint32_t elapsed;
+
+        body_bytes = 0;
+        if (!send_request(session, optlist)) {
+            LOG_ERR("Cannot send bulk request");
+            failed++;
+            break;
+        }
+        pending = 1;
+        while (pending && k_uptime_get() - start < BULK_TIMEOUT_MS) {
+            coap_io_process(ctx, 100);
+        }
+        elapsed = (uint32_t)(k_uptime_get() - start);
+
+        if (pending) {
+            LOG_WRN("Bulk transfer %d timed out", i + 1);
+            pending = 0;
+            failed++;
+            continue;
+        }
+        if (!body_bytes) {
+            continue;
+        }
+        completed++;
+        total_bytes += body_bytes;
+        sum_ms += elapsed;
+        if (elapsed < min_ms) {
+            min_ms = elapsed;
+        }
+        if (elapsed > max_ms) {
+            max_ms = elapsed;
+        }
+    }
+    instr_sample(&finished);
+    return completed;
+}
+
+static void print_pct(const char *label, uint32_t permille) {
+    printf("%s%u.%u%%", label, (unsigned)(permille / 10),
+           (unsigned)(permille % 10));
+}
+
+void bulk_report(void) {
+    uint32_t test_ms = (uint32_t)(finished.uptime_ms - started.uptime_ms);
+    uint32_t udp_sent = finished.udp_sent - started.udp_sent;
+    uint32_t udp_recv = finished.udp_recv - started.udp_recv;
+    uint32_t tcp_sent = finished.tcp_sent - started.tcp_sent;
+    uint32_t tcp_rexmit = finished.tcp_rexmit - started.tcp_rexmit;
+
+    printf("\n=== BULK TRANSFER ===\n");
+    printf("Transfers: %d completed, %d failed in %u ms, blocks of %u%s\n",
+           completed, failed, (unsigned)test_ms,
+           szx == BULK_SZX_BERT ? 1024 : 16u << szx,
+           szx == BULK_SZX_BERT ? "xN (BERT)" : "");
+    if (completed) {
+        uint64_t goodput = test_ms ? total_bytes * 1000 / test_ms : 0;
+
+        printf("Body: %u bytes, time min/avg/max: %u/%u/%u ms\n",
+               (unsigned)(total_bytes / completed), (unsigned)min_ms,
+               (unsigned)(sum_ms / completed), (unsigned)max_ms);
+        printf("Goodput: %u bytes/s (%u kbit/s)\n", (unsigned)goodput,
+               (unsigned)(goodput * 8 / 1000));
+    }
+
+    /* Every CON request is answered once, so datagrams sent without a
+     * matching receive are retransmissions (or lost for good) */
+    if (udp_sent) {
+        uint32_t extra = udp_sent > udp_recv ? udp_sent - udp_recv : 0;
+
+        print_pct("Retransmissions: ", extra * 1000 / udp_sent);
+        printf(" (%u of %u datagrams)\n", (unsigned)extra, (unsigned)udp_sent);
+    } else if (tcp_sent) {
+        print_pct("Retransmissions: ", tcp_rexmit * 1000 / tcp_sent);
+        printf(" (%u of %u segments)\n", (unsigned)tcp_rexmit,
+               (unsigned)tcp_sent);
+    }
+
+    if (finished.cpu_total > started.cpu_total) {
+        print_pct("CPU: ", instr_cpu_busy(&started, &finished));
+        print_pct(" busy, ", instr_cpu_self(&started, &finished));
+        printf(" in the client thread\n");
+    }
+    instr_heap_report();
+    printf("=== END BULK TRANSFER ===\n");
+}
@@ -0,0 +1,537 @@
+/*
+ * wolfssl/src/discovery.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * /.well-known/core discovery and link-format index for CoAP client.
+ *
+ * The link-format document (RFC 6690) is parsed byte by byte as blocks
+ * arrive, so the body is never buffered as a whole. Only the target path
+ * and the rt, if, ct and sz attributes of each link are kept, in a fixed
+ * table that is also persisted with the settings subsystem. Until the
+ * index expires, resource type lookups are answered locally.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#ifdef CONFIG_SETTINGS
+#include <zephyr/settings/settings.h>
+#endif
+#include "discovery.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+#define DISCOVERY_INDEX_VERSION 1
+
+struct discovery_index {
+    uint8_t version;
+    uint8_t count;
+    uint32_t lifetime_s;
+    char server[24];
+    struct discovery_entry entries[DISCOVERY_MAX_ENTRIES];
+};
+
+enum lf_state {
+    LF_IDLE,
+    LF_TARGET,
+    LF_PARAMS,
+    LF_PNAME,
+    LF_PVALUE,
+    LF_PVALUE_QUOTED,
+    LF_SKIP_LINK,
+};
+
+/* Link-format parser state, kept across blocks */
+static struct {
+    enum lf_state state;
+    struct discovery_entry cur;
+    char pname[3];
+    uint8_t pname_len;
+    char *field;
+    size_t field_size;
+    size_t len;
+    uint32_t *num;
+    uint32_t num_value;
+    uint32_t ct_value;
+    uint8_t num_digits;
+    uint8_t num_done;
+    uint8_t overflow;
+    uint8_t escape;
+    uint8_t in_quotes;
+    uint8_t value_started;
+} lf;
+
+static struct discovery_index wkc_index;
+static int64_t expires_ms;
+static int have_index;
+static uint32_t links_seen;
+static uint32_t links_dropped;
+static uint32_t lookups;
+
+static uint8_t fetch_token[8];
+static size_t fetch_token_len;
+static int fetch_active;
+static int fetch_done;
+static int fetch_ok;
+static size_t fetch_bytes;
+
+/* When this run loaded or fetched the index */
+static int64_t index_since_ms;
+
+#ifdef CONFIG_SETTINGS
+/* The index is only written when fetched. What is left of its lifetime
+ * is a separate 4-byte entry, rewritten at the end of every run. */
+static struct discovery_index stored;
+static int stored_valid;
+static uint32_t stored_left_s;
+static int stored_left_valid;
+
+static int wkc_set(const char *name, size_t len, settings_read_cb read_cb,
+                   void *cb_arg) {
+    const char *next;
+    int rc;
+
+    if (settings_name_steq(name, "left", &next) && !next) {
+        if (len != sizeof(stored_left_s)) {
+            return -EINVAL;
+        }
+        rc = read_cb(cb_arg, &stored_left_s, sizeof(stored_left_s));
+        if (rc < 0) {
+            return rc;
+        }
+        stored_left_valid = 1;
+        return 0;
+    }
+    if (!settings_name_steq(name, "index", &next) || next) {
+        return -ENOENT;
+    }
+    if (len != sizeof(stored)) {
+        return -EINVAL;
+    }
+    rc = read_cb(cb_arg, &stored, sizeof(stored));
+    if (rc < 0) {
+        return rc;
+    }
+    stored_valid = stored.version == DISCOVERY_INDEX_VERSION;
+    return 0;
+}
+
+static void save_left(uint32_t left_s) {
+    if (settings_save_one("coap/wkc/left", &left_s, sizeof(left_s))) {
+        LOG_ERR("Cannot save discovery index lifetime");
+    }
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(coap_wkc, "coap/wkc", NULL, wkc_set, NULL,
+                               NULL);
+#endif
+
+static void lf_begin_field(char *field, size_t size) {
+    lf.field = field;
+    lf.field_size = size;
+    lf.len = 0;
+    lf.num = NULL;
+    lf.overflow = 0;
+    if (field) {
+        field[0] = '\0';
+    }
+}
+
+static void lf_begin_number(uint32_t *num) {
+    lf_begin_field(NULL, 0);
+    lf.num = num;
+    lf.num_value = 0;
+    lf.num_digits = 0;
+    lf.num_done = 0;
+}
+
+static void lf_append(char c) {
+    if (lf.num) {
+        /* ct="0 40" and the like: keep the first number only */
+        if (lf.num_done) {
+            return;
+        }
+        if (c >= '0' && c <= '9') {
+            lf.num_value = lf.num_value * 10 + (uint32_t)(c - '0');
+            lf.num_digits++;
+        } else if (lf.num_digits) {
+            lf.num_done = 1;
+        }
+        return;
+    }
+    if (!lf.field) {
+        return;
+    }
+    if (lf.len + 1 >= lf.field_size) {
+        lf.overflow = 1;
+        return;
+    }
+    lf.field[lf.len++] = c;
+    lf.field[lf.len] = '\0';
+}
+
+static void lf_end_value(void) {
+    if (lf.num) {
+        if (lf.num_digits) {
+            *lf.num = lf.num_value;
+        }
+        if (lf.num == &lf.ct_value && lf.ct_value < DISCOVERY_CT_NONE) {
+            lf.cur.ct = (uint16_t)lf.ct_value;
+        }
+    } else if (lf.field && lf.overflow) {
+        lf.field[0] = '\0';
+    }
+    lf_begin_field(NULL, 0);
+}
+
+static void lf_begin_value(void) {
+    lf.value_started = 0;
+    lf.escape = 0;
+
+    if (lf.pname_len == 2 && !memcmp(lf.pname, "rt", 2)) {
+        lf_begin_field(lf.cur.rt, sizeof(lf.cur.rt));
+    } else if (lf.pname_len == 2 && !memcmp(lf.pname, "if", 2)) {
+        lf_begin_field(lf.cur.if_, sizeof(lf.cur.if_));
+    } else if (lf.pname_len == 2 && !memcmp(lf.pname, "ct", 2)) {
+        lf.ct_value = DISCOVERY_CT_NONE;
+        lf_begin_number(&lf.ct_value);
+    } else if (lf.pname_len == 2 && !memcmp(lf.pname, "sz", 2)) {
+        lf_begin_number(&lf.cur.sz);
+    } else {
+        lf_begin_field(NULL, 0);
+    }
+}
+
+static void lf_commit(void) {
+    links_seen++;
+    if (wkc_index.count >= DISCOVERY_MAX_ENTRIES) {
+        links_dropped++;
+        return;
+    }
+    memcpy(&wkc_index.entries[wkc_index.count++], &lf.cur, sizeof(lf.cur));
+}
+
+static void lf_reset(void) {
+    memset(&lf, 0, sizeof(lf));
+    lf.state = LF_IDLE;
+}
+
+static void lf_feed(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = (char)data[i];
+
+        switch (lf.state) {
+        case LF_IDLE:
+            if (c == '<') {
+                memset(&lf.cur, 0, sizeof(lf.cur));
+                lf.cur.ct = DISCOVERY_CT_NONE;
+                lf_begin_field(lf.cur.path, sizeof(lf.cur.path));
+                lf.state = LF_TARGET;
+            } else if (c != ',' && c != ' ' && c != '\r' && c != '\n') {
+                lf.in_quotes = 0;
+                lf.state = LF_SKIP_LINK;
+            }
+            break;
+        case LF_TARGET:
+            if (c != '>') {
+                lf_append(c);
+                break;
+            }
+            /* Only local absolute paths can be requested on this server */
+            if (lf.overflow || lf.cur.path[0] != '/') {
+                links_seen++;
+                links_dropped++;
+                lf.in_quotes = 0;
+                lf.state = LF_SKIP_LINK;
+            } else {
+                lf_begin_field(NULL, 0);
+                lf.state = LF_PARAMS;
+            }
+            break;
+        case LF_PARAMS:
+            if (c == ';') {
+                lf.pname_len = 0;
+                lf.state = LF_PNAME;
+            } else if (c == ',') {
+                lf_commit();
+                lf.state = LF_IDLE;
+            }
+            break;
+        case LF_PNAME:
+            if (c == '=') {
+                lf_begin_value();
+                lf.state = LF_PVALUE;
+            } else if (c == ';') {
+                lf.pname_len = 0;
+            } else if (c == ',') {
+                lf_commit();
+                lf.state = LF_IDLE;
+            } else if (lf.pname_len < sizeof(lf.pname)) {
+                lf.pname[lf.pname_len++] = c;
+            }
+            break;
+        case LF_PVALUE:
+            if (c == '"' && !lf.value_started) {
+                lf.state = LF_PVALUE_QUOTED;
+            } else if (c == ';') {
+                lf_end_value();
+                lf.pname_len = 0;
+                lf.state = LF_PNAME;
+            } else if (c == ',') {
+                lf_end_value();
+                lf_commit();
+                lf.state = LF_IDLE;
+            } else {
+                lf_append(c);
+            }
+            lf.value_started = 1;
+            break;
+        case LF_PVALUE_QUOTED:
+            if (lf.escape) {
+                lf.escape = 0;
+                lf_append(c);
+            } else if (c == '\\') {
+                lf.escape = 1;
+            } else if (c == '"') {
+                lf_end_value();
+                lf.state = LF_PARAMS;
+            } else {
+                lf_append(c);
+            }
+            break;
+        case LF_SKIP_LINK:
+            if (lf.escape) {
+                lf.escape = 0;
+            } else if (c == '\\' && lf.in_quotes) {
+                lf.escape = 1;
+            } else if (c == '"') {
+                lf.in_quotes = !lf.in_quotes;
+            } else if (c == ',' && !lf.in_quotes) {
+                lf.state = LF_IDLE;
+            }
+            break;
+        }
+    }
+}
+
+static void lf_finish(void) {
+    switch (lf.state) {
+    case LF_PVALUE:
+    case LF_PVALUE_QUOTED:
+        lf_end_value();
+        /* fall through */
+    case LF_PARAMS:
+    case LF_PNAME:
+        lf_commit();
+        break;
+    default:
+        break;
+    }
+    lf_reset();
+}
+
+void discovery_init(const char *server) {
+    memset(&wkc_index, 0, sizeof(wkc_index));
+    have_index = 0;
+    snprintf(wkc_index.server, sizeof(wkc_index.server), "%s", server);
+
+#ifdef CONFIG_SETTINGS
+    if (settings_subsys_init() == 0 &&
+        settings_load_subtree("coap/wkc") == 0 && stored_valid &&
+        !strcmp(stored.server, wkc_index.server)) {
+        uint32_t left_s = stored_left_valid ? stored_left_s
+                                            : stored.lifetime_s;
+
+        if (left_s > 0) {
+            memcpy(&wkc_index, &stored, sizeof(wkc_index));
+            /* No RTC: what was left at the end of the last run counts
+             * down from boot */
+            index_since_ms = k_uptime_get();
+            expires_ms = index_since_ms + (int64_t)left_s * 1000;
+            have_index = 1;
+            LOG_INF("Discovery index loaded from settings: %u links, "
+                    "%u s left", wkc_index.count, (unsigned)left_s);
+        }
+    }
+#endif
+}
+
+int discovery_valid(void) {
+    return have_index && k_uptime_get() < expires_ms;
+}
+
+int discovery_handle_response(const coap_pdu_t *received) {
+    coap_bin_const_t token = coap_pdu_get_token(received);
+    const uint8_t *databuf;
+    size_t len, offset, total;
+
+    if (!fetch_active || token.length != fetch_token_len ||
+        memcmp(token.s, fetch_token, fetch_token_len)) {
+        return 0;
+    }
+
+    if (coap_pdu_get_code(received) != COAP_RESPONSE_CODE_CONTENT) {
+        LOG_WRN("Discovery failed: %d.%02d",
+                COAP_RESPONSE_CLASS(coap_pdu_get_code(received)),
+                coap_pdu_get_code(received) & 0x1F);
+        fetch_done = 1;
+        return 1;
+    }
+
+    if (!coap_get_data_large(received, &len, &databuf, &offset, &total)) {
+        len = 0;
+        offset = 0;
+        total = 0;
+    }
+    lf_feed(databuf, len);
+    fetch_bytes += len;
+
+    if (offset + len >= total) {
+        lf_finish();
+        fetch_ok = 1;
+        fetch_done = 1;
+    }
+    return 1;
+}
+
+int discovery_fetch(coap_context_t *ctx, coap_session_t *session) {
+    coap_pdu_t *pdu;
+    int64_t start;
+
+    pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET, session);
+    if (!pdu) {
+        return 0;
+    }
+    coap_session_new_token(session, &fetch_token_len, fetch_token);
+    coap_add_token(pdu, fetch_token_len, fetch_token);
+    coap_add_option(pdu, COAP_OPTION_URI_PATH, 11,
+                    (const uint8_t *)".well-known");
+    coap_add_option(pdu, COAP_OPTION_URI_PATH, 4, (const uint8_t *)"core");
+
+    wkc_index.count = 0;
+    links_seen = 0;
+    links_dropped = 0;
+    fetch_bytes = 0;
+    fetch_done = 0;
+    fetch_ok = 0;
+    lf_reset();
+
+    LOG_INF("Fetching /.well-known/core...");
+    start = k_uptime_get();
+    if (coap_send(session, pdu) == COAP_INVALID_MID) {
+        LOG_ERR("Cannot send discovery request");
+        return 0;
+    }
+
+    fetch_active = 1;
+    while (!fetch_done &&
+           k_uptime_get() - start < DISCOVERY_TIMEOUT_MS) {
+        coap_io_process(ctx, 100);
+    }
+    fetch_active = 0;
+
+    if (!fetch_ok) {
+        LOG_WRN("Discovery did not complete");
+        return 0;
+    }
+
+    wkc_index.version = DISCOVERY_INDEX_VERSION;
+    wkc_index.lifetime_s = DISCOVERY_TTL_S;
+    index_since_ms = k_uptime_get();
+    expires_ms = index_since_ms + (int64_t)DISCOVERY_TTL_S * 1000;
+    have_index = 1;
+    LOG_INF("Discovery done in %d ms: %u bytes, %u links, %u indexed",
+            (int)(k_uptime_get() - start), (unsigned)fetch_bytes,
+            (unsigned)links_seen, wkc_index.count);
+
+#ifdef CONFIG_SETTINGS
+    if (settings_save_one("coap/wkc/index", &wkc_index, sizeof(wkc_index))) {
+        LOG_ERR("Cannot save discovery index");
+    }
+    save_left(DISCOVERY_TTL_S);
+#endif
+    return 1;
+}
+
+void discovery_invalidate(void) {
+    have_index = 0;
+#ifdef CONFIG_SETTINGS
+    save_left(0);
+#endif
+}
+
+static int rt_matches(const char *rt_list, const char *rt) {
+    size_t rt_len = strlen(rt);
+    const char *p = rt_list;
+
+    /* rt may carry several space-separated types */
+    while (*p) {
+        const char *end = strchr(p, ' ');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+
+        if (len == rt_len && !memcmp(p, rt, len)) {
+            return 1;
+        }
+        if (!end) {
+            break;
+        }
+        p = end + 1;
+    }
+    return 0;
+}
+
+const struct discovery_entry *discovery_lookup_rt(const char *rt) {
+    if (!discovery_valid()) {
+        return NULL;
+    }
+
+    lookups++;
+    for (int i = 0; i < wkc_index.count; i++) {
+        if (rt_matches(wkc_index.entries[i].rt, rt)) {
+            return &wkc_index.entries[i];
+        }
+    }
+    return NULL;
+}
+
+void discovery_report(void) {
+    printf("\n%-3s | %-31s | %-23s | %-15s | %-5s | %s\n", "Num", "Path", "rt",
+           "if", "ct", "sz");
+
+    for (int i = 0; i < wkc_index.count; i++) {
+        const struct discovery_entry *e = &wkc_index.entries[i];
+
+        printf("%-3d | %-31s | %-23s | %-15s | ", i + 1, e->path, e->rt,
+               e->if_);
+        if (e->ct == DISCOVERY_CT_NONE) {
+            printf("%-5s | ", "-");
+        } else {
+            printf("%-5u | ", e->ct);
+        }
+        printf("%u\n", (unsigned)e->sz);
+    }
+    if (links_dropped) {
+        printf("(%u links not indexed)\n", (unsigned)links_dropped);
+    }
+    printf("Index lookups: %u, expires in %d s\n\n", (unsigned)lookups,
+           discovery_valid() ? (int)((expires_ms - k_uptime_get()) / 1000)
+                             : 0);
+}
+
+/* Charges the run against the lifetime: its uptime, but at least
+ * DISCOVERY_RUN_CHARGE_S, as the time the device was off is unknown */
+void discovery_save(void) {
+#ifdef CONFIG_SETTINGS
+    int64_t left_ms;
+
+    if (!have_index) {
+        return;
+    }
+    left_ms = expires_ms -
+              MAX(k_uptime_get(),
+                  index_since_ms + DISCOVERY_RUN_CHARGE_S * 1000LL);
+    save_left(left_ms > 0 ? (uint32_t)(left_ms / 1000) : 0);
+#endif
+}
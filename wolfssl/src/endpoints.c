@@ -0,0 +1,325 @@
+/*
+ * wolfssl/src/endpoints.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Multi-server RTT probing and endpoint selection for CoAP client.
+ *
+ * Every endpoint gets its own client session which is probed with CoAP
+ * pings (empty CON over UDP/DTLS, Ping signal over TCP). Replies feed an
+ * EWMA of the RTT and of the loss rate; the endpoint with the lowest
+ * combined score is used for new sessions, with hysteresis so that noise
+ * does not make the client flap between servers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "client.h"
+#include "endpoints.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+struct endpoint {
+    char host[16];
+    uint16_t port;
+    coap_address_t addr;
+    coap_session_t *session;
+    int64_t created_ms;
+    int64_t next_probe_ms;
+    int64_t probe_sent_ms;
+    coap_mid_t probe_mid;
+    /* EWMAs scaled by 2^ENDPOINT_EWMA_SHIFT, as TCP keeps its srtt, so
+     * that samples below that many ms still move them */
+    uint32_t srtt_scaled;  /* ms */
+    uint32_t loss_scaled;  /* per mille */
+    uint8_t consecutive_losses;
+    uint32_t sent;
+    uint32_t received;
+};
+
+static struct endpoint endpoints[ENDPOINTS_MAX];
+static int endpoint_count;
+static int current = -1;
+static int switch_candidate = -1;
+static int switch_streak;
+static uint32_t probe_interval_ms = ENDPOINT_PROBE_INTERVAL_MS;
+
+static uint32_t endpoint_srtt_ms(const struct endpoint *ep) {
+    return ep->srtt_scaled >> ENDPOINT_EWMA_SHIFT;
+}
+
+static uint32_t endpoint_loss_pm(const struct endpoint *ep) {
+    return ep->loss_scaled >> ENDPOINT_EWMA_SHIFT;
+}
+
+static uint32_t endpoint_score(const struct endpoint *ep) {
+    if (ep->received == 0) {
+        return UINT32_MAX;
+    }
+    return endpoint_srtt_ms(ep) +
+           (endpoint_loss_pm(ep) * ENDPOINT_LOSS_PENALTY_MS) / 1000;
+}
+
+static int endpoint_alive(const struct endpoint *ep) {
+    return ep->received > 0 && ep->consecutive_losses < ENDPOINT_DEAD_LOSSES;
+}
+
+static int best_endpoint(void) {
+    int best = -1;
+
+    for (int i = 0; i < endpoint_count; i++) {
+        if (!endpoint_alive(&endpoints[i])) {
+            continue;
+        }
+        if (best < 0 ||
+            endpoint_score(&endpoints[i]) < endpoint_score(&endpoints[best])) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/* Re-run the selection, only moving away from a live endpoint when a
+ * candidate has been clearly better for ENDPOINT_SWITCH_ROUNDS rounds. */
+static void reevaluate(void) {
+    int best = best_endpoint();
+
+    if (best < 0) {
+        return;
+    }
+
+    if (current < 0 || !endpoint_alive(&endpoints[current])) {
+        if (current != best) {
+            LOG_INF("Endpoint failover: %s:%u -> %s:%u",
+                    current < 0 ? "-" : endpoints[current].host,
+                    current < 0 ? 0 : endpoints[current].port,
+                    endpoints[best].host, endpoints[best].port);
+        }
+        current = best;
+        switch_candidate = -1;
+        switch_streak = 0;
+        return;
+    }
+
+    if (best == current ||
+        (uint64_t)endpoint_score(&endpoints[best]) * 100 >=
+            (uint64_t)endpoint_score(&endpoints[current]) *
+                (100 - ENDPOINT_SWITCH_MARGIN_PCT)) {
+        switch_candidate = -1;
+        switch_streak = 0;
+        return;
+    }
+
+    if (best != switch_candidate) {
+        switch_candidate = best;
+        switch_streak = 0;
+    }
+    if (++switch_streak >= ENDPOINT_SWITCH_ROUNDS) {
+        LOG_INF("Endpoint switch: %s:%u (%u ms) -> %s:%u (%u ms)",
+                endpoints[current].host, endpoints[current].port,
+                endpoint_score(&endpoints[current]), endpoints[best].host,
+                endpoints[best].port, endpoint_score(&endpoints[best]));
+        current = best;
+        switch_candidate = -1;
+        switch_streak = 0;
+    }
+}
+
+static void record_sample(struct endpoint *ep, int lost, uint32_t rtt_ms) {
+    ep->loss_scaled = ep->loss_scaled -
+                      (ep->loss_scaled >> ENDPOINT_EWMA_SHIFT) +
+                      (lost ? 1000 : 0);
+
+    if (lost) {
+        if (ep->consecutive_losses < UINT8_MAX) {
+            ep->consecutive_losses++;
+        }
+    } else {
+        ep->consecutive_losses = 0;
+        if (ep->received++ == 0) {
+            ep->srtt_scaled = rtt_ms << ENDPOINT_EWMA_SHIFT;
+        } else {
+            ep->srtt_scaled = ep->srtt_scaled -
+                              (ep->srtt_scaled >> ENDPOINT_EWMA_SHIFT) +
+                              rtt_ms;
+        }
+    }
+
+    /* Until the warm-up has picked an endpoint there is nothing to keep */
+    if (current >= 0 && (ep == &endpoints[current] || !endpoint_alive(ep))) {
+        reevaluate();
+    }
+}
+
+int endpoints_init(coap_context_t *ctx, const char *list,
+                   uint16_t default_port) {
+    const char *p = list;
+
+    memset(endpoints, 0, sizeof(endpoints));
+    endpoint_count = 0;
+    current = -1;
+    switch_candidate = -1;
+    switch_streak = 0;
+
+    while (*p && endpoint_count < ENDPOINTS_MAX) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        struct endpoint *ep = &endpoints[endpoint_count];
+
+        if (!parse_host_port(p, len, default_port, ep->host,
+                             sizeof(ep->host), &ep->port) ||
+            !setup_destination_address(&ep->addr, ep->host, ep->port)) {
+            LOG_ERR("Invalid endpoint: %.*s", (int)len, p);
+        } else if (!(ep->session = open_session(ctx, &ep->addr))) {
+            LOG_ERR("Cannot create session for endpoint %s:%u", ep->host,
+                    ep->port);
+        } else {
+            ep->probe_mid = COAP_INVALID_MID;
+            ep->created_ms = k_uptime_get();
+            endpoint_count++;
+        }
+
+        if (!end) {
+            break;
+        }
+        p = end + 1;
+    }
+
+    LOG_INF("Endpoints configured: %d", endpoint_count);
+    return endpoint_count;
+}
+
+void endpoints_poll(void) {
+    int64_t now = k_uptime_get();
+
+    for (int i = 0; i < endpoint_count; i++) {
+        struct endpoint *ep = &endpoints[i];
+
+        if (ep->probe_mid != COAP_INVALID_MID) {
+            if (now - ep->probe_sent_ms >= ENDPOINT_PROBE_TIMEOUT_MS) {
+                ep->probe_mid = COAP_INVALID_MID;
+                record_sample(ep, 1, 0);
+            }
+            continue;
+        }
+
+        if (now < ep->next_probe_ms) {
+            continue;
+        }
+        ep->next_probe_ms = now + probe_interval_ms;
+
+        /* (D)TLS handshake or TCP connect still running: a ping would only
+         * be queued behind it and measure the handshake, not the path */
+        if (coap_session_get_state(ep->session) !=
+            COAP_SESSION_STATE_ESTABLISHED) {
+            if (now - ep->created_ms >= ENDPOINT_PROBE_TIMEOUT_MS) {
+                ep->sent++;
+                record_sample(ep, 1, 0);
+            }
+            continue;
+        }
+
+        ep->sent++;
+        ep->probe_mid = coap_session_send_ping(ep->session);
+        if (ep->probe_mid == COAP_INVALID_MID) {
+            record_sample(ep, 1, 0);
+            continue;
+        }
+        ep->probe_sent_ms = now;
+    }
+}
+
+int endpoints_handle_reply(coap_session_t *session, coap_mid_t mid) {
+    for (int i = 0; i < endpoint_count; i++) {
+        struct endpoint *ep = &endpoints[i];
+
+        if (ep->session != session) {
+            continue;
+        }
+        if (ep->probe_mid == COAP_INVALID_MID || ep->probe_mid != mid) {
+            return 0;
+        }
+        ep->probe_mid = COAP_INVALID_MID;
+        record_sample(ep, 0, (uint32_t)(k_uptime_get() - ep->probe_sent_ms));
+        return 1;
+    }
+    return 0;
+}
+
+int endpoints_warmup(coap_context_t *ctx, int rounds) {
+    int done;
+
+    LOG_INF("Probing %d endpoints (%d rounds)...", endpoint_count, rounds);
+    probe_interval_ms = ENDPOINT_WARMUP_INTERVAL_MS;
+
+    do {
+        endpoints_poll();
+        coap_io_process(ctx, 50);
+
+        done = 1;
+        for (int i = 0; i < endpoint_count; i++) {
+            if (endpoints[i].sent < (uint32_t)rounds ||
+                endpoints[i].probe_mid != COAP_INVALID_MID) {
+                done = 0;
+                break;
+            }
+        }
+    } while (!done);
+
+    probe_interval_ms = ENDPOINT_PROBE_INTERVAL_MS;
+    current = best_endpoint();
+    endpoints_report();
+
+    return current;
+}
+
+/* Every probe sample re-runs the selection, so this only reads it */
+int endpoints_select(void) {
+    return current;
+}
+
+coap_session_t *endpoints_session(int index) {
+    if (index < 0 || index >= endpoint_count) {
+        return NULL;
+    }
+    return endpoints[index].session;
+}
+
+const coap_address_t *endpoints_address(int index) {
+    if (index < 0 || index >= endpoint_count) {
+        return NULL;
+    }
+    return &endpoints[index].addr;
+}
+
+void endpoints_report(void) {
+    printf("\n%-3s | %-21s | %-8s | %-6s | %-9s | %-8s\n", "Num", "Endpoint",
+           "SRTT ms", "Loss %", "Sent/Rcvd", "Score ms");
+
+    for (int i = 0; i < endpoint_count; i++) {
+        const struct endpoint *ep = &endpoints[i];
+        char name[24];
+
+        snprintf(name, sizeof(name), "%s:%u", ep->host, ep->port);
+        printf("%-3d | %-21s | %-8u | %3u.%u%% | %4u/%-4u | %-8d%s\n", i + 1,
+               name, endpoint_srtt_ms(ep), endpoint_loss_pm(ep) / 10,
+               endpoint_loss_pm(ep) % 10,
+               ep->sent, ep->received,
+               ep->received ? (int)endpoint_score(ep) : -1,
+               i == current ? " *" : "");
+    }
+    printf("\n");
+}
+
+void endpoints_cleanup(void) {
+    for (int i = 0; i < endpoint_count; i++) {
+        if (endpoints[i].session) {
+            coap_session_release(endpoints[i].session);
+            endpoints[i].session = NULL;
+        }
+    }
+    endpoint_count = 0;
+    current = -1;
+}
@@ -0,0 +1,235 @@
+/*
+ * wolfssl/src/failover.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Warm-standby backup session for CoAP client.
+ *
+ * A second session to the backup server is set up before the first
+ * request and kept alive with periodic CoAP pings, so its (D)TLS state and
+ * any NAT binding are ready when needed. When the primary session gives a
+ * request up (retransmissions exhausted), the request is duplicated with
+ * the same token onto the standby and answered through the usual
+ * response handler.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "client.h"
+#include "failover.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+static coap_session_t *primary;
+static coap_session_t *standby;
+static char standby_host[16];
+static uint16_t standby_port;
+
+static int64_t next_keepalive_ms;
+static int64_t keepalive_sent_ms;
+static coap_mid_t keepalive_mid = COAP_INVALID_MID;
+static uint32_t keepalive_rtt_ms;
+static uint32_t keepalives_missed;
+static uint8_t consecutive_missed;
+
+static int32_t connect_ms = -1;
+static int64_t replay_ms;
+static int32_t failover_ms = -1;
+static uint32_t replayed;
+static int exhausted;
+
+static void tune_session(coap_session_t *session) {
+    coap_fixed_point_t ack_timeout = {FAILOVER_ACK_TIMEOUT_S, 0};
+
+    coap_session_set_ack_timeout(session, ack_timeout);
+    coap_session_set_max_retransmit(session, FAILOVER_MAX_RETRANSMIT);
+}
+
+static void send_keepalive(int64_t now) {
+    next_keepalive_ms = now + FAILOVER_KEEPALIVE_MS;
+
+    if (coap_session_get_state(standby) != COAP_SESSION_STATE_ESTABLISHED) {
+        return;
+    }
+    keepalive_mid = coap_session_send_ping(standby);
+    keepalive_sent_ms = now;
+}
+
+int failover_init(coap_context_t *ctx, const char *backup,
+                  uint16_t default_port) {
+    coap_address_t addr;
+    int64_t start;
+
+    if (!parse_host_port(backup, strlen(backup), default_port, standby_host,
+                         sizeof(standby_host), &standby_port) ||
+        !setup_destination_address(&addr, standby_host, standby_port)) {
+        LOG_ERR("Invalid backup server: %s", backup);
+        return 0;
+    }
+
+    LOG_INF("Opening standby session to %s:%u...", standby_host,
+            standby_port);
+    start = k_uptime_get();
+    if (!(standby = open_session(ctx, &addr))) {
+        LOG_ERR("Cannot create standby session");
+        return 0;
+    }
+    tune_session(standby);
+
+    /* Pay the cold connect now: handshake plus a first keepalive round
+     * trip, which is also what a failover would otherwise cost */
+    while (k_uptime_get() - start < FAILOVER_CONNECT_TIMEOUT_MS) {
+        int64_t now = k_uptime_get();
+
+        if (keepalive_mid == COAP_INVALID_MID && keepalive_rtt_ms == 0 &&
+            now >= next_keepalive_ms) {
+            send_keepalive(now);
+            next_keepalive_ms = now + 250;
+        }
+        coap_io_process(ctx, 50);
+        if (keepalive_rtt_ms) {
+            connect_ms = (int32_t)(k_uptime_get() - start);
+            break;
+        }
+    }
+
+    if (connect_ms < 0) {
+        LOG_WRN("Standby did not answer within %d ms",
+                FAILOVER_CONNECT_TIMEOUT_MS);
+    } else {
+        LOG_INF("Standby ready after %d ms (cold connect)", connect_ms);
+    }
+    next_keepalive_ms = k_uptime_get() + FAILOVER_KEEPALIVE_MS;
+
+    return 1;
+}
+
+void failover_arm(coap_session_t *session) {
+    primary = session;
+    tune_session(primary);
+}
+
+void failover_poll(void) {
+    int64_t now;
+
+    if (!standby) {
+        return;
+    }
+
+    now = k_uptime_get();
+    if (keepalive_mid != COAP_INVALID_MID) {
+        if (now - keepalive_sent_ms >= FAILOVER_KEEPALIVE_TIMEOUT_MS) {
+            keepalive_mid = COAP_INVALID_MID;
+            keepalives_missed++;
+            if (++consecutive_missed == 3) {
+                LOG_WRN("Standby %s:%u not answering keepalives",
+                        standby_host, standby_port);
+            }
+        }
+    } else if (now >= next_keepalive_ms) {
+        send_keepalive(now);
+    }
+}
+
+int failover_handle_reply(coap_session_t *session, coap_mid_t mid) {
+    if (!standby || session != standby || mid != keepalive_mid) {
+        return 0;
+    }
+    keepalive_mid = COAP_INVALID_MID;
+    keepalive_rtt_ms = (uint32_t)(k_uptime_get() - keepalive_sent_ms);
+    if (keepalive_rtt_ms == 0) {
+        keepalive_rtt_ms = 1;
+    }
+    consecutive_missed = 0;
+    return 1;
+}
+
+int failover_handle_nack(coap_session_t *session, const coap_pdu_t *sent,
+                         coap_nack_reason_t reason) {
+    coap_opt_filter_t drop;
+    coap_bin_const_t token;
+    coap_pdu_t *pdu;
+
+    /* Pings are empty messages, only requests are worth replaying */
+    if (!standby || !sent || coap_pdu_get_code(sent) == COAP_EMPTY_CODE) {
+        return 0;
+    }
+
+    if (session == standby) {
+        if (reason != COAP_NACK_RST) {
+            exhausted = 1;
+        }
+        return 0;
+    }
+
+    if (session != primary || reason == COAP_NACK_RST) {
+        return 0;
+    }
+
+    LOG_WRN("Primary gave up (NACK %d), replaying request on standby",
+            reason);
+
+    /* Uri-Host/Uri-Port named the primary, the backup does not need them */
+    coap_option_filter_clear(&drop);
+    coap_option_filter_set(&drop, COAP_OPTION_URI_HOST);
+    coap_option_filter_set(&drop, COAP_OPTION_URI_PORT);
+
+    token = coap_pdu_get_token(sent);
+    pdu = coap_pdu_duplicate(sent, standby, token.length, token.s, &drop);
+    if (!pdu) {
+        LOG_ERR("Cannot duplicate request for standby");
+        exhausted = 1;
+        return 0;
+    }
+
+    replay_ms = k_uptime_get();
+    if (coap_send(standby, pdu) == COAP_INVALID_MID) {
+        LOG_ERR("Cannot send request on standby");
+        exhausted = 1;
+        return 0;
+    }
+    replayed++;
+    return 1;
+}
+
+void failover_handle_response(coap_session_t *session) {
+    if (standby && session == standby && replay_ms && failover_ms < 0) {
+        failover_ms = (int32_t)(k_uptime_get() - replay_ms);
+    }
+}
+
+int failover_exhausted(void) {
+    return exhausted;
+}
+
+void failover_report(void) {
+    if (!standby) {
+        return;
+    }
+
+    printf("\n=== Standby Session ===\n");
+    printf("Backup server: %s:%u\n", standby_host, standby_port);
+    printf("Cold connect: %d ms\n", connect_ms);
+    printf("Keepalive RTT: %u ms, missed: %u\n", (unsigned)keepalive_rtt_ms,
+           (unsigned)keepalives_missed);
+    printf("Requests replayed: %u\n", (unsigned)replayed);
+    if (failover_ms >= 0) {
+        printf("Failover (replay to response): %d ms", failover_ms);
+        if (connect_ms >= 0) {
+            printf(", %d ms saved against a cold connect",
+                   connect_ms - failover_ms);
+        }
+        printf("\n");
+    }
+    printf("=== End Standby Session ===\n\n");
+}
+
+void failover_cleanup(void) {
+    if (standby) {
+        coap_session_release(standby);
+        standby = NULL;
+    }
+    primary = NULL;
+}
@@ -0,0 +1,182 @@
+/*
+ * wolfssl/src/heaps.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Separate heaps for libcoap and the TLS library.
+ *
+ * With CONFIG_APP_HEAPS, libcoap (through the coap_malloc_type() link
+ * wrap) and the TLS library (through the allocator macros of its
+ * configuration header) each get their own sys_heap. What is left on
+ * the k_malloc() pool is then Wi-Fi and the kernel. With the mbedTLS
+ * backend the Wi-Fi supplicant is built with the same mbedTLS
+ * configuration, so its crypto lands on the TLS heap too and cannot be
+ * told apart from the CoAP sessions'. With wolfSSL, the supplicant's
+ * mbedTLS keeps its own CONFIG_MBEDTLS_HEAP_SIZE buffer. Each heap keeps
+ * current, peak and failure counters that instr_phase() samples at the
+ * phase boundaries of main(), so CONFIG_HEAP_MEM_POOL_SIZE and the two
+ * heap sizes can be set from measured peaks. A sys_heap has no lock of
+ * its own, so every call takes the heap's spinlock.
+ */
+
+#include <string.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/sys_heap.h>
+#include <coap3/coap.h>
+#include "heaps.h"
+
+struct heap {
+    const char *name;
+    struct sys_heap heap;
+    struct k_spinlock lock;
+    char *mem;
+    size_t size;
+    size_t current;
+    size_t peak;
+    uint32_t failures;
+};
+
+static char __aligned(8) coap_mem[CONFIG_APP_HEAP_COAP_SIZE];
+static char __aligned(8) tls_mem[CONFIG_APP_HEAP_TLS_SIZE];
+
+static struct heap heaps[HEAPS_COUNT] = {
+    [HEAPS_COAP] = {.name = "libcoap", .mem = coap_mem,
+                    .size = sizeof(coap_mem)},
+    [HEAPS_TLS] = {.name = "tls", .mem = tls_mem, .size = sizeof(tls_mem)},
+};
+
+static void *heap_realloc(struct heap *h, void *p, size_t size) {
+    k_spinlock_key_t key = k_spin_lock(&h->lock);
+    size_t before = p ? sys_heap_usable_size(&h->heap, p) : 0;
+    void *block = sys_heap_realloc(&h->heap, p, size);
+
+    if (block) {
+        h->current += sys_heap_usable_size(&h->heap, block) - before;
+        if (h->current > h->peak) {
+            h->peak = h->current;
+        }
+    } else if (size) {
+        h->failures++;
+    } else {
+        h->current -= before;
+    }
+    k_spin_unlock(&h->lock, key);
+    return block;
+}
+
+static void heap_free(struct heap *h, void *p) {
+    k_spinlock_key_t key;
+
+    if (!p) {
+        return;
+    }
+    key = k_spin_lock(&h->lock);
+    h->current -= sys_heap_usable_size(&h->heap, p);
+    sys_heap_free(&h->heap, p);
+    k_spin_unlock(&h->lock, key);
+}
+
+const char *heaps_name(enum heaps_id id) {
+    return heaps[id].name;
+}
+
+void heaps_get(enum heaps_id id, struct heaps_counters *counters) {
+    struct heap *h = &heaps[id];
+    k_spinlock_key_t key = k_spin_lock(&h->lock);
+
+    counters->size = h->size;
+    counters->current = h->current;
+    counters->peak = h->peak;
+    counters->failures = h->failures;
+    k_spin_unlock(&h->lock, key);
+}
+
+/* Bisection with real allocations under the lock, so the answer takes
+ * the allocator's bucket search into account. Meant for occasional
+ * samples, not for the data path. */
+size_t heaps_largest_free(enum heaps_id id) {
+    struct heap *h = &heaps[id];
+    k_spinlock_key_t key = k_spin_lock(&h->lock);
+    size_t lo = 0;
+    size_t hi = h->size - h->current;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo + 1) / 2;
+        void *p = sys_heap_alloc(&h->heap, mid);
+
+        if (p) {
+            sys_heap_free(&h->heap, p);
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    k_spin_unlock(&h->lock, key);
+    return lo;
+}
+
+void *heaps_coap_malloc(size_t size) {
+    return heap_realloc(&heaps[HEAPS_COAP], NULL, size);
+}
+
+void *heaps_coap_realloc(void *p, size_t size) {
+    return heap_realloc(&heaps[HEAPS_COAP], p, size);
+}
+
+void heaps_coap_free(void *p) {
+    heap_free(&heaps[HEAPS_COAP], p);
+}
+
+void *heaps_tls_malloc(size_t size) {
+    return heap_realloc(&heaps[HEAPS_TLS], NULL, size);
+}
+
+void *heaps_tls_calloc(size_t n, size_t size) {
+    void *p;
+
+    if (size && n > SIZE_MAX / size) {
+        return NULL;
+    }
+    p = heap_realloc(&heaps[HEAPS_TLS], NULL, n * size);
+    if (p) {
+        memset(p, 0, n * size);
+    }
+    return p;
+}
+
+void *heaps_tls_realloc(void *p, size_t size) {
+    return heap_realloc(&heaps[HEAPS_TLS], p, size);
+}
+
+void heaps_tls_free(void *p) {
+    heap_free(&heaps[HEAPS_TLS], p);
+}
+
+#ifndef CONFIG_APP_COAP_POOLS
+/* Without the pools, every libcoap allocation comes from its heap */
+void *__wrap_coap_malloc_type(coap_memory_tag_t type, size_t size) {
+    (void)type;
+    return heaps_coap_malloc(size);
+}
+
+void *__wrap_coap_realloc_type(coap_memory_tag_t type, void *p, size_t size) {
+    (void)type;
+    return heaps_coap_realloc(p, size);
+}
+
+void __wrap_coap_free_type(coap_memory_tag_t type, void *p) {
+    (void)type;
+    heaps_coap_free(p);
+}
+#endif
+
+/* Before anything that may allocate, the TLS library's own init included */
+static int heaps_init(void) {
+    for (int i = 0; i < HEAPS_COUNT; i++) {
+        sys_heap_init(&heaps[i].heap, heaps[i].mem, heaps[i].size);
+    }
+    return 0;
+}
+
+SYS_INIT(heaps_init, PRE_KERNEL_1, 0);
@@ -0,0 +1,173 @@
+/*
+ * wolfssl/src/hist.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Fixed-memory log-linear latency histograms.
+ *
+ * A min/avg/max does not say what p99 is, and keeping the samples does
+ * not fit on the device. Here each histogram is an array of counters in
+ * the layout of HdrHistogram: the first 2^HIST_SUB_BITS buckets are one
+ * microsecond wide, and after that every power of two is split into
+ * 2^HIST_SUB_BITS equal buckets, so the relative error is bounded and
+ * the whole range up to 2^HIST_MAX_BITS us takes HIST_BUCKETS counters.
+ * Recording finds the bucket from the highest set bit, in constant time
+ * and without allocating. Two histograms with the same geometry merge by
+ * adding their counters, which is how scripts/hist.py combines the
+ * snapshots of several runs or devices.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include "hist.h"
+
+#define SUB (1u << HIST_SUB_BITS)
+
+static struct hist hists[HIST_COUNT];
+
+static const char *const names[HIST_COUNT] = {
+    "response", "handshake", "wifi_connect", "dhcp",
+};
+
+static int bucket_of(uint32_t v) {
+    int msb;
+    int shift;
+
+    if (v < SUB) {
+        return v;
+    }
+    msb = 31 - __builtin_clz(v);
+    if (msb >= HIST_MAX_BITS) {
+        return HIST_BUCKETS - 1;
+    }
+    shift = msb - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) + (int)((v >> shift) - SUB);
+}
+
+/* Largest value that falls into bucket i */
+static uint32_t bucket_top(int i) {
+    int shift;
+
+    if (i < (int)SUB) {
+        return i;
+    }
+    shift = (i >> HIST_SUB_BITS) - 1;
+    return (((i & (SUB - 1)) | SUB) << shift) + ((1u << shift) - 1);
+}
+
+void hist_record(enum hist_id id, uint32_t us) {
+    struct hist *h = &hists[id];
+
+    if (!h->count || us < h->min) {
+        h->min = us;
+    }
+    h->max = MAX(h->max, us);
+    h->count++;
+    h->sum += us;
+    h->buckets[bucket_of(us)]++;
+}
+
+const char *hist_name(enum hist_id id) {
+    return names[id];
+}
+
+const struct hist *hist_get(enum hist_id id) {
+    return &hists[id];
+}
+
+void hist_merge(struct hist *into, const struct hist *from) {
+    if (!from->count) {
+        return;
+    }
+    if (!into->count || from->min < into->min) {
+        into->min = from->min;
+    }
+    into->max = MAX(into->max, from->max);
+    into->count += from->count;
+    into->sum += from->sum;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        into->buckets[i] += from->buckets[i];
+    }
+}
+
+uint32_t hist_percentile(const struct hist *h, uint32_t permille) {
+    uint64_t target;
+    uint64_t seen = 0;
+
+    if (!h->count) {
+        return 0;
+    }
+    target = MAX(((uint64_t)h->count * permille + 999) / 1000, 1);
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= target) {
+            return MIN(bucket_top(i), h->max);
+        }
+    }
+    return h->max;
+}
+
+static uint8_t *put_le(uint8_t *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *p++ = (uint8_t)(v >> (8 * i));
+    }
+    return p;
+}
+
+size_t hist_snapshot(enum hist_id id, uint8_t *buf, size_t size) {
+    const struct hist *h = &hists[id];
+    uint8_t *p = buf;
+    int used = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        used += h->buckets[i] != 0;
+    }
+    if (size < 30 + 6 * (size_t)used) {
+        return 0;
+    }
+    memcpy(p, "HST1", 4);
+    p += 4;
+    *p++ = HIST_SUB_BITS;
+    *p++ = HIST_MAX_BITS;
+    *p++ = (uint8_t)id;
+    *p++ = 0;
+    p = put_le(p, h->count, 4);
+    p = put_le(p, h->min, 4);
+    p = put_le(p, h->max, 4);
+    p = put_le(p, h->sum, 8);
+    p = put_le(p, used, 2);
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (h->buckets[i]) {
+            p = put_le(p, i, 2);
+            p = put_le(p, h->buckets[i], 4);
+        }
+    }
+    return p - buf;
+}
+
+void hist_report(void) {
+    static uint8_t snap[HIST_SNAPSHOT_MAX];
+
+    printf("\n=== HISTOGRAMS ===\n");
+    for (int id = 0; id < HIST_COUNT; id++) {
+        const struct hist *h = &hists[id];
+        size_t len;
+
+        if (!h->count) {
+            continue;
+        }
+        printf("%s: %u samples, min %u, p50 %u, p90 %u, p99 %u, max %u us\n",
+               names[id], (unsigned)h->count, (unsigned)h->min,
+               (unsigned)hist_percentile(h, 500),
+               (unsigned)hist_percentile(h, 900),
+               (unsigned)hist_percentile(h, 990), (unsigned)h->max);
+        len = hist_snapshot(id, snap, sizeof(snap));
+        printf("hist %s ", names[id]);
+        for (size_t i = 0; i < len; i++) {
+            printf("%02x", snap[i]);
+        }
+        printf("\n");
+    }
+    printf("=== END HISTOGRAMS ===\n");
+}
@@ -0,0 +1,166 @@
+/*
+ * wolfssl/src/hold.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Long-lived session after the request.
+ *
+ * A device keeps its session for hours: it fetches the resource again
+ * once the cached copy is past its Max-Age, refreshes its Resource
+ * Directory registration and, with CONFIG_APP_KEEPALIVE_S, has libcoap
+ * ping the server whenever the session has been idle that long (the NAT
+ * binding keepalive). This runs that phase for CONFIG_APP_HOLD_S over
+ * the session of the request, with the same I/O loop as the wait for
+ * the response; with an endpoint list every refetch goes to the
+ * endpoint the probes select by then. On native_sim with
+ * overlay-virtual-time.conf the clock skips over the idle periods, so a
+ * day is held in seconds.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "hold.h"
+#ifdef COAP_RD_EP
+#include "rd.h"
+#endif
+#ifdef COAP_SERVER_ENDPOINTS
+#include "endpoints.h"
+#endif
+#ifdef COAP_BACKUP_SERVER
+#include "failover.h"
+#endif
+#ifdef CONFIG_APP_METRICS
+#include "metrics.h"
+#endif
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+static uint8_t token[8];
+static size_t token_len;
+static int pending;
+static int64_t sent_ms;
+static int64_t expires_ms;
+static uint32_t max_age_s = HOLD_DEFAULT_MAX_AGE_S;
+
+static uint32_t refetches;
+static uint32_t failed;
+static uint32_t timeouts;
+static int64_t held_ms;
+
+void hold_cached(const coap_pdu_t *received) {
+    coap_opt_iterator_t it;
+    coap_opt_t *opt = coap_check_option(received, COAP_OPTION_MAXAGE, &it);
+
+    max_age_s = opt ? coap_decode_var_bytes(coap_opt_value(opt),
+                                            coap_opt_length(opt))
+                    : HOLD_DEFAULT_MAX_AGE_S;
+    /* Max-Age 0 (not cacheable) would refetch in a tight loop */
+    expires_ms = k_uptime_get() + MAX(max_age_s, 1) * 1000LL;
+}
+
+int hold_handle_response(const coap_pdu_t *received) {
+    coap_bin_const_t tok = coap_pdu_get_token(received);
+    coap_pdu_code_t code = coap_pdu_get_code(received);
+
+    if (!pending || tok.length != token_len ||
+        memcmp(tok.s, token, token_len)) {
+        return 0;
+    }
+    pending = 0;
+
+    if (COAP_RESPONSE_CLASS(code) != 2) {
+        LOG_WRN("Refetch failed: %d.%02d", COAP_RESPONSE_CLASS(code),
+                code & 0x1F);
+        failed++;
+        expires_ms = k_uptime_get() + HOLD_DEFAULT_MAX_AGE_S * 1000LL;
+        return 1;
+    }
+    refetches++;
+    hold_cached(received);
+    return 1;
+}
+
+static int send_request(coap_session_t *session, coap_optlist_t **optlist) {
+    coap_pdu_t *pdu;
+
+    pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET, session);
+    if (!pdu) {
+        return 0;
+    }
+    coap_session_new_token(session, &token_len, token);
+    coap_add_token(pdu, token_len, token);
+    if (*optlist && coap_add_optlist_pdu(pdu, optlist) != 1) {
+        coap_delete_pdu(pdu);
+        return 0;
+    }
+    return coap_send(session, pdu) != COAP_INVALID_MID;
+}
+
+int hold_run(coap_context_t *ctx, coap_session_t *session,
+             coap_optlist_t **optlist) {
+    int64_t start = k_uptime_get();
+    int64_t end = start + CONFIG_APP_HOLD_S * 1000LL;
+    int64_t now;
+
+    LOG_INF("Holding the session for %d s (Max-Age %u s)",
+            CONFIG_APP_HOLD_S, (unsigned)max_age_s);
+    while ((now = k_uptime_get()) < end) {
+        int64_t next = MIN(end, now + HOLD_POLL_MS);
+#ifdef COAP_SERVER_ENDPOINTS
+        /* Probe timeouts are only noticed here, as in the response wait */
+        next = MIN(next, now + 500);
+#endif
+
+        if (pending && now - sent_ms >= HOLD_TIMEOUT_MS) {
+            pending = 0;
+            timeouts++;
+            expires_ms = now;
+        }
+        if (!pending && now >= expires_ms) {
+#ifdef COAP_SERVER_ENDPOINTS
+            /* Each refetch from the endpoint the probes select by now */
+            session = endpoints_session(endpoints_select());
+#endif
+            if (send_request(session, optlist)) {
+                pending = 1;
+                sent_ms = now;
+            } else {
+                failed++;
+                expires_ms = now + HOLD_DEFAULT_MAX_AGE_S * 1000LL;
+            }
+        }
+        next = MIN(next, pending ? sent_ms + HOLD_TIMEOUT_MS : expires_ms);
+
+        /* A timeout of 0 would wait for traffic with no limit */
+        coap_io_process(ctx, (uint32_t)MAX(next - now, 1));
+#ifdef CONFIG_APP_METRICS
+        metrics_poll();
+#endif
+#ifdef COAP_SERVER_ENDPOINTS
+        endpoints_poll();
+#endif
+#ifdef COAP_RD_EP
+        rd_poll(session);
+#endif
+#ifdef COAP_BACKUP_SERVER
+        failover_poll();
+#endif
+    }
+
+    held_ms = now - start;
+    return failed == 0 && timeouts == 0;
+}
+
+void hold_report(void) {
+    printf("\n=== HOLD ===\n");
+    printf("Held: %u s\n", (unsigned)(held_ms / 1000));
+    printf("Refetches: %u on Max-Age expiry (%u s), %u failed, "
+           "%u timed out\n", (unsigned)refetches, (unsigned)max_age_s,
+           (unsigned)failed, (unsigned)timeouts);
+    if (CONFIG_APP_KEEPALIVE_S > 0) {
+        printf("Keepalive: ping after %d s idle\n", CONFIG_APP_KEEPALIVE_S);
+    }
+    printf("=== END HOLD ===\n");
+}
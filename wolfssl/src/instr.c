@@ -0,0 +1,259 @@
+/*
+ * wolfssl/src/instr.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * CPU, network and heap counters for the CoAP client benchmarks.
+ *
+ * Everything here reads counters Zephyr already keeps when the matching
+ * Kconfig options are on (overlay-stats.conf): thread runtime stats for
+ * CPU use, the network statistics for datagrams and segments, and the
+ * heap runtime stats for high-water marks. Without them the samples are
+ * zero and the benchmarks simply print less. With CONFIG_APP_HEAPS the
+ * phase samples also cover the libcoap and TLS heaps, and with painted
+ * stacks (overlay-stack.conf) the main thread's stack high-water mark.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#ifdef CONFIG_NET_STATISTICS_USER_API
+#include <zephyr/net/net_mgmt.h>
+#include <zephyr/net/net_stats.h>
+#endif
+#ifdef CONFIG_SYS_HEAP_RUNTIME_STATS
+#include <zephyr/sys/sys_heap.h>
+#endif
+#ifdef CONFIG_NEWLIB_LIBC
+#include <malloc.h>
+#endif
+#include "instr.h"
+#ifdef CONFIG_APP_HEAPS
+#include "heaps.h"
+#endif
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && CONFIG_HEAP_MEM_POOL_SIZE > 0
+#define SYSTEM_HEAP_STATS 1
+/* k_malloc() pool, not exported by a header */
+extern struct k_heap _system_heap;
+#endif
+#if defined(CONFIG_INIT_STACKS) && defined(CONFIG_THREAD_STACK_INFO)
+#define STACK_STATS 1
+#endif
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && defined(CONFIG_COMMON_LIBC_MALLOC)
+/* malloc() arena of the common libc, which picolibc (native_sim) uses */
+extern int malloc_runtime_stats_get(struct sys_memory_stats *stats);
+#endif
+
+void instr_sample(struct instr_sample *s) {
+    memset(s, 0, sizeof(*s));
+    s->uptime_ms = k_uptime_get();
+
+#ifdef CONFIG_SCHED_THREAD_USAGE_ALL
+    k_thread_runtime_stats_t all, self;
+
+    if (k_thread_runtime_stats_all_get(&all) == 0) {
+        s->cpu_total = all.execution_cycles;
+        s->cpu_idle = all.idle_cycles;
+    }
+    if (k_thread_runtime_stats_get(k_current_get(), &self) == 0) {
+        s->cpu_self = self.execution_cycles;
+    }
+#endif
+
+#ifdef CONFIG_NET_STATISTICS_USER_API
+    struct net_stats stats;
+
+    if (net_mgmt(NET_REQUEST_STATS_GET_ALL, NULL, &stats, sizeof(stats)) == 0) {
+#ifdef CONFIG_NET_STATISTICS_UDP
+        s->udp_sent = stats.udp.sent;
+        s->udp_recv = stats.udp.recv;
+#endif
+#ifdef CONFIG_NET_STATISTICS_TCP
+        s->tcp_sent = stats.tcp.sent;
+        s->tcp_rexmit = stats.tcp.rexmit;
+#endif
+    }
+#endif
+}
+
+static uint32_t share(uint64_t part, uint64_t whole) {
+    return whole ? (uint32_t)(part * 1000 / whole) : 0;
+}
+
+uint32_t instr_cpu_busy(const struct instr_sample *from,
+                        const struct instr_sample *to) {
+    uint64_t total = to->cpu_total - from->cpu_total;
+    uint64_t idle = to->cpu_idle - from->cpu_idle;
+
+    return share(total > idle ? total - idle : 0, total);
+}
+
+uint32_t instr_cpu_self(const struct instr_sample *from,
+                        const struct instr_sample *to) {
+    return share(to->cpu_self - from->cpu_self,
+                 to->cpu_total - from->cpu_total);
+}
+
+size_t instr_heap_used(void) {
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && defined(CONFIG_COMMON_LIBC_MALLOC)
+    struct sys_memory_stats stats;
+
+    return malloc_runtime_stats_get(&stats) == 0 ? stats.allocated_bytes : 0;
+#elif defined(CONFIG_NEWLIB_LIBC)
+    return mallinfo().uordblks;
+#else
+    return 0;
+#endif
+}
+
+void instr_heap_get(struct instr_heap *heap) {
+    memset(heap, 0, sizeof(*heap));
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && defined(CONFIG_COMMON_LIBC_MALLOC)
+    struct sys_memory_stats stats;
+
+    if (malloc_runtime_stats_get(&stats) == 0) {
+        heap->used = stats.allocated_bytes;
+        heap->peak = stats.max_allocated_bytes;
+        heap->free = stats.free_bytes;
+    }
+#elif defined(CONFIG_NEWLIB_LIBC)
+    struct mallinfo mi = mallinfo();
+
+    heap->used = mi.uordblks;
+    heap->peak = mi.arena;
+    heap->free = mi.fordblks;
+#endif
+}
+
+void instr_heap_report(void) {
+#ifdef SYSTEM_HEAP_STATS
+    struct sys_memory_stats stats;
+
+    if (sys_heap_runtime_stats_get(&_system_heap.heap, &stats) == 0) {
+        printf("k_malloc heap: %u used, %u peak, %u free\n",
+               (unsigned)stats.allocated_bytes,
+               (unsigned)stats.max_allocated_bytes,
+               (unsigned)stats.free_bytes);
+    }
+#endif
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && defined(CONFIG_COMMON_LIBC_MALLOC)
+    struct sys_memory_stats libc_stats;
+
+    if (malloc_runtime_stats_get(&libc_stats) == 0) {
+        printf("libc heap: %u used, %u peak, %u free\n",
+               (unsigned)libc_stats.allocated_bytes,
+               (unsigned)libc_stats.max_allocated_bytes,
+               (unsigned)libc_stats.free_bytes);
+    }
+#endif
+#ifdef CONFIG_NEWLIB_LIBC
+    /* The arena only shrinks when malloc trims its top chunk, so it is
+     * the peak in practice */
+    struct mallinfo mi = mallinfo();
+
+    printf("libc heap: %u used, %u arena\n", (unsigned)mi.uordblks,
+           (unsigned)mi.arena);
+#endif
+}
+
+struct phase_sample {
+    const char *name;
+    int64_t uptime_ms;          /* Since boot, so "startup" is the boot time */
+    size_t system_current;      /* k_malloc() pool */
+    size_t system_peak;
+    size_t libc_used;
+    size_t stack_peak;          /* Calling thread, deepest so far */
+#ifdef CONFIG_APP_HEAPS
+    struct heaps_counters heaps[HEAPS_COUNT];
+#endif
+};
+
+static struct phase_sample phases[INSTR_MAX_PHASES];
+static int phase_count;
+
+void instr_phase(const char *name) {
+    struct phase_sample *p;
+
+    if (phase_count == INSTR_MAX_PHASES) {
+        return;
+    }
+    p = &phases[phase_count++];
+    memset(p, 0, sizeof(*p));
+    p->name = name;
+    p->uptime_ms = k_uptime_get();
+
+#ifdef SYSTEM_HEAP_STATS
+    struct sys_memory_stats stats;
+
+    if (sys_heap_runtime_stats_get(&_system_heap.heap, &stats) == 0) {
+        p->system_current = stats.allocated_bytes;
+        p->system_peak = stats.max_allocated_bytes;
+    }
+#endif
+    p->libc_used = instr_heap_used();
+#ifdef STACK_STATS
+    size_t unused;
+
+    if (k_thread_stack_space_get(k_current_get(), &unused) == 0) {
+        p->stack_peak = k_current_get()->stack_info.size - unused;
+    }
+#endif
+#ifdef CONFIG_APP_HEAPS
+    for (int i = 0; i < HEAPS_COUNT; i++) {
+        heaps_get(i, &p->heaps[i]);
+    }
+#endif
+}
+
+void instr_phase_report(void) {
+    printf("\n=== HEAP PHASES ===\n");
+    printf("Uptime and bytes in use (and peak so far) at the end of each "
+           "phase\n");
+    for (int i = 0; i < phase_count; i++) {
+        const struct phase_sample *p = &phases[i];
+
+        printf("%-9s %6u ms, libc %u", p->name, (unsigned)p->uptime_ms,
+               (unsigned)p->libc_used);
+#ifdef STACK_STATS
+        printf(", stack %u", (unsigned)p->stack_peak);
+#endif
+#ifdef SYSTEM_HEAP_STATS
+        printf(", k_malloc %u/%u", (unsigned)p->system_current,
+               (unsigned)p->system_peak);
+#endif
+#ifdef CONFIG_APP_HEAPS
+        for (int h = 0; h < HEAPS_COUNT; h++) {
+            printf(", %s %u/%u", heaps_name(h),
+                   (unsigned)p->heaps[h].current, (unsigned)p->heaps[h].peak);
+        }
+#endif
+        printf("\n");
+    }
+
+#if defined(SYSTEM_HEAP_STATS) || defined(CONFIG_APP_HEAPS) || \
+    defined(STACK_STATS)
+    if (phase_count) {
+        const struct phase_sample *last = &phases[phase_count - 1];
+
+#ifdef STACK_STATS
+        printf("main stack: peak %u of %u\n", (unsigned)last->stack_peak,
+               (unsigned)k_current_get()->stack_info.size);
+#endif
+
+#ifdef SYSTEM_HEAP_STATS
+        printf("k_malloc pool: peak %u of %u\n", (unsigned)last->system_peak,
+               (unsigned)CONFIG_HEAP_MEM_POOL_SIZE);
+#endif
+#ifdef CONFIG_APP_HEAPS
+        for (int h = 0; h < HEAPS_COUNT; h++) {
+            printf("%s heap: peak %u of %u, %u failed allocations\n",
+                   heaps_name(h), (unsigned)last->heaps[h].peak,
+                   (unsigned)last->heaps[h].size,
+                   (unsigned)last->heaps[h].failures);
+        }
+#endif
+    }
+#endif
+    printf("=== END HEAP PHASES ===\n");
+}
@@ -0,0 +1,319 @@
+/*
+ * wolfssl/src/rd.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Resource Directory (RFC 9176) registration client.
+ *
+ * The full registration (POST /rd?ep=..&lt=.. with the link-format
+ * payload) is only sent when no registration is known. Its location is
+ * kept in RAM and in settings, and the registration is kept alive with
+ * the registration update of section 5.3.1: an empty POST to that
+ * location. Only a 4.04 on the update (the directory dropped us) leads
+ * to a new full registration.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#ifdef CONFIG_SETTINGS
+#include <zephyr/settings/settings.h>
+#endif
+#include "rd.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+enum rd_op {
+    RD_IDLE,
+    RD_REGISTER,
+    RD_REFRESH,
+};
+
+struct rd_state {
+    char ep[32];
+    char location[RD_LOCATION_MAX];
+};
+
+static struct rd_state rd;
+static enum rd_op pending = RD_IDLE;
+static coap_session_t *rd_session;
+static uint8_t token[8];
+static size_t token_len;
+static int64_t next_refresh_ms;
+static int last_ok;
+
+/* Wire sizes of the last exchange of each kind, request + response */
+static uint32_t register_bytes;
+static uint32_t refresh_bytes;
+static uint32_t registrations;
+static uint32_t refreshes;
+
+#ifdef CONFIG_SETTINGS
+static int rd_set(const char *name, size_t len, settings_read_cb read_cb,
+                  void *cb_arg) {
+    const char *next;
+    struct rd_state stored;
+
+    if (!settings_name_steq(name, "state", &next) || next) {
+        return -ENOENT;
+    }
+    if (len != sizeof(stored) || read_cb(cb_arg, &stored, len) < 0) {
+        return -EINVAL;
+    }
+    /* A location only belongs to the endpoint name it was created for */
+    if (!strcmp(stored.ep, rd.ep)) {
+        memcpy(rd.location, stored.location, sizeof(rd.location));
+    }
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(coap_rd, "coap/rd", NULL, rd_set, NULL, NULL);
+#endif
+
+static void rd_store(void) {
+#ifdef CONFIG_SETTINGS
+    if (settings_save_one("coap/rd/state", &rd, sizeof(rd))) {
+        LOG_ERR("Cannot save RD registration");
+    }
+#endif
+}
+
+/* On-air size of a CoAP message including the datagram overhead */
+static uint32_t pdu_wire_size(const coap_pdu_t *pdu) {
+    coap_opt_iterator_t it;
+    coap_opt_t *opt;
+    const uint8_t *data;
+    size_t data_len;
+    uint32_t size = 4 + coap_pdu_get_token(pdu).length;
+
+    coap_option_iterator_init(pdu, &it, COAP_OPT_ALL);
+    while ((opt = coap_option_next(&it))) {
+        size += coap_opt_size(opt);
+    }
+    if (coap_get_data(pdu, &data_len, &data)) {
+        size += 1 + data_len;
+    }
+    return size + RD_DATAGRAM_OVERHEAD;
+}
+
+static int add_path(coap_pdu_t *pdu, const char *path) {
+    const char *p = path;
+
+    while (*p) {
+        const char *end;
+        size_t len;
+
+        if (*p == '/') {
+            p++;
+            continue;
+        }
+        end = strchr(p, '/');
+        len = end ? (size_t)(end - p) : strlen(p);
+        if (!coap_add_option(pdu, COAP_OPTION_URI_PATH, len,
+                             (const uint8_t *)p)) {
+            return 0;
+        }
+        p += len;
+    }
+    return 1;
+}
+
+static int rd_send(enum rd_op op) {
+    uint8_t buf[48];
+    uint32_t size;
+    coap_pdu_t *pdu;
+    int ok;
+
+    pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_POST, rd_session);
+    if (!pdu) {
+        return 0;
+    }
+    coap_session_new_token(rd_session, &token_len, token);
+    coap_add_token(pdu, token_len, token);
+
+    if (op == RD_REGISTER) {
+        size_t len;
+
+        /* Options in ascending order: Uri-Path, Content-Format, Uri-Query */
+        ok = add_path(pdu, RD_PATH);
+        len = coap_encode_var_safe(buf, sizeof(buf),
+                                   COAP_MEDIATYPE_APPLICATION_LINK_FORMAT);
+        ok = ok && coap_add_option(pdu, COAP_OPTION_CONTENT_FORMAT, len, buf);
+        len = snprintf((char *)buf, sizeof(buf), "ep=%s", rd.ep);
+        ok = ok && coap_add_option(pdu, COAP_OPTION_URI_QUERY, len, buf);
+        len = snprintf((char *)buf, sizeof(buf), "lt=%u",
+                       (unsigned)RD_LIFETIME_S);
+        ok = ok && coap_add_option(pdu, COAP_OPTION_URI_QUERY, len, buf);
+        ok = ok && coap_add_data(pdu, sizeof(RD_LINKS) - 1,
+                                 (const uint8_t *)RD_LINKS);
+    } else {
+        /* Registration update: no payload, no query, lifetime unchanged */
+        ok = add_path(pdu, rd.location);
+    }
+
+    if (!ok) {
+        LOG_ERR("Cannot build RD request");
+        coap_delete_pdu(pdu);
+        return 0;
+    }
+
+    size = pdu_wire_size(pdu);
+    if (op == RD_REGISTER) {
+        register_bytes = size;
+    } else {
+        refresh_bytes = size;
+    }
+
+    if (coap_send(rd_session, pdu) == COAP_INVALID_MID) {
+        LOG_ERR("Cannot send RD request");
+        return 0;
+    }
+    pending = op;
+    return 1;
+}
+
+static void save_location(const coap_pdu_t *received) {
+    coap_opt_filter_t filter;
+    coap_opt_iterator_t it;
+    coap_opt_t *opt;
+    size_t used = 0;
+
+    coap_option_filter_clear(&filter);
+    coap_option_filter_set(&filter, COAP_OPTION_LOCATION_PATH);
+    coap_option_iterator_init(received, &it, &filter);
+
+    while ((opt = coap_option_next(&it))) {
+        size_t len = coap_opt_length(opt);
+
+        if (used + 1 + len >= sizeof(rd.location)) {
+            LOG_ERR("RD location too long");
+            rd.location[0] = '\0';
+            return;
+        }
+        rd.location[used++] = '/';
+        memcpy(&rd.location[used], coap_opt_value(opt), len);
+        used += len;
+    }
+    rd.location[used] = '\0';
+}
+
+int rd_handle_response(const coap_pdu_t *received) {
+    coap_bin_const_t tok = coap_pdu_get_token(received);
+    coap_pdu_code_t code = coap_pdu_get_code(received);
+    enum rd_op op = pending;
+
+    if (op == RD_IDLE || tok.length != token_len ||
+        memcmp(tok.s, token, token_len)) {
+        return 0;
+    }
+    pending = RD_IDLE;
+
+    if (op == RD_REGISTER) {
+        register_bytes += pdu_wire_size(received);
+        if (code != COAP_RESPONSE_CODE_CREATED) {
+            LOG_WRN("RD registration failed: %d.%02d",
+                    COAP_RESPONSE_CLASS(code), code & 0x1F);
+            last_ok = 0;
+            return 1;
+        }
+        save_location(received);
+        registrations++;
+        LOG_INF("RD registered at %s", rd.location);
+        rd_store();
+    } else {
+        refresh_bytes += pdu_wire_size(received);
+        if (code == COAP_RESPONSE_CODE_NOT_FOUND) {
+            /* Registration expired or was removed: start over */
+            LOG_INF("RD registration %s gone, registering again",
+                    rd.location);
+            rd.location[0] = '\0';
+            rd_send(RD_REGISTER);
+            return 1;
+        }
+        if (COAP_RESPONSE_CLASS(code) != 2) {
+            LOG_WRN("RD refresh failed: %d.%02d", COAP_RESPONSE_CLASS(code),
+                    code & 0x1F);
+            last_ok = 0;
+            return 1;
+        }
+        refreshes++;
+        LOG_INF("RD registration %s refreshed", rd.location);
+    }
+
+    last_ok = 1;
+    next_refresh_ms = k_uptime_get() +
+                      (int64_t)RD_LIFETIME_S * 1000 * RD_REFRESH_PCT / 100;
+    return 1;
+}
+
+void rd_init(const char *ep) {
+    memset(&rd, 0, sizeof(rd));
+    snprintf(rd.ep, sizeof(rd.ep), "%s", ep);
+
+#ifdef CONFIG_SETTINGS
+    if (settings_subsys_init() == 0) {
+        settings_load_subtree("coap/rd");
+    }
+#endif
+    if (rd.location[0]) {
+        LOG_INF("RD registration known: %s", rd.location);
+    }
+}
+
+int rd_update(coap_context_t *ctx, coap_session_t *session) {
+    int64_t start = k_uptime_get();
+
+    rd_session = session;
+    last_ok = 0;
+    if (!rd_send(rd.location[0] ? RD_REFRESH : RD_REGISTER)) {
+        return 0;
+    }
+
+    while (pending != RD_IDLE && k_uptime_get() - start < RD_TIMEOUT_MS) {
+        coap_io_process(ctx, 100);
+    }
+    if (pending != RD_IDLE) {
+        LOG_WRN("RD exchange timed out");
+        pending = RD_IDLE;
+        return 0;
+    }
+    return last_ok;
+}
+
+void rd_poll(coap_session_t *session) {
+    if (pending != RD_IDLE || !rd.location[0] ||
+        k_uptime_get() < next_refresh_ms) {
+        return;
+    }
+    rd_session = session;
+    rd_send(RD_REFRESH);
+}
+
+void rd_report(void) {
+    uint32_t interval_s = (uint32_t)RD_LIFETIME_S * RD_REFRESH_PCT / 100;
+
+    printf("\n=== Resource Directory ===\n");
+    printf("Endpoint: %s, location: %s\n", rd.ep,
+           rd.location[0] ? rd.location : "-");
+    printf("Registrations: %u, refreshes: %u\n", (unsigned)registrations,
+           (unsigned)refreshes);
+    if (register_bytes) {
+        printf("Full registration: %u bytes on air\n",
+               (unsigned)register_bytes);
+    }
+    if (refresh_bytes) {
+        printf("Refresh: %u bytes on air\n", (unsigned)refresh_bytes);
+    }
+    if (register_bytes && refresh_bytes && register_bytes > refresh_bytes) {
+        uint32_t saved = register_bytes - refresh_bytes;
+
+        /* Every refresh would otherwise have been a full registration */
+        printf("Saved per refresh: %u bytes, %u bytes/day (refresh every "
+               "%u s)\n",
+               (unsigned)saved,
+               (unsigned)((uint64_t)saved * 86400 / (interval_s ? interval_s : 1)),
+               (unsigned)interval_s);
+    }
+    printf("=== End Resource Directory ===\n\n");
+}
@@ -0,0 +1,92 @@
+/*
+ * wolfssl/src/reqtrace.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Request lifecycle trace events from inside libcoap.
+ *
+ * The events the client itself causes (PDU build, response dispatch,
+ * Wi-Fi and IP state) are emitted where they happen. The rest happen in
+ * libcoap, which has no hooks for them, so with CONFIG_APP_TRACING the
+ * linker redirects the libcoap functions they pass through here (--wrap):
+ * coap_send() for every request any part of the client sends,
+ * coap_retransmit() for every retransmission of a CON message, the
+ * datagram layer (coap_netif_dgrm_write/read) for the DTLS flights of a
+ * session still in its handshake, and coap_pdu_parse() for every
+ * incoming Block2 block, which libcoap otherwise reassembles out of
+ * sight. Each wrapper emits its event and calls the real function.
+ *
+ * CONFIG_APP_COAP_STATS needs the send time of every request too, so
+ * with it coap_send() alone is wrapped and hands the PDU to coapstats.c.
+ */
+
+#include <sys/types.h>
+#include <coap3/coap.h>
+#include "reqtrace.h"
+#ifdef CONFIG_APP_COAP_STATS
+#include "coapstats.h"
+#endif
+
+coap_mid_t __real_coap_send(coap_session_t *session, coap_pdu_t *pdu);
+
+coap_mid_t __wrap_coap_send(coap_session_t *session, coap_pdu_t *pdu) {
+    /* The PDU belongs to libcoap once sent, so read it first */
+    REQTRACE("coap_send", coap_pdu_get_mid(pdu), coap_pdu_get_code(pdu));
+#ifdef CONFIG_APP_COAP_STATS
+    coapstats_sent(session, pdu);
+#endif
+    return __real_coap_send(session, pdu);
+}
+
+#ifdef CONFIG_APP_TRACING
+coap_mid_t __real_coap_retransmit(coap_context_t *context, coap_queue_t *node);
+ssize_t __real_coap_netif_dgrm_write(coap_session_t *session,
+                                     const uint8_t *data, size_t datalen);
+ssize_t __real_coap_netif_dgrm_read(coap_session_t *session,
+                                    coap_packet_t *packet);
+int __real_coap_pdu_parse(coap_proto_t proto, const uint8_t *data,
+                          size_t length, coap_pdu_t *pdu);
+
+static int in_handshake(const coap_session_t *session) {
+    return coap_session_get_state(session) == COAP_SESSION_STATE_HANDSHAKE;
+}
+
+coap_mid_t __wrap_coap_retransmit(coap_context_t *context, coap_queue_t *node) {
+    coap_mid_t mid = __real_coap_retransmit(context, node);
+
+    /* The node is opaque here; the returned MID says which message went
+     * out again, COAP_INVALID_MID that it was given up */
+    REQTRACE("coap_retransmit", mid, 0);
+    return mid;
+}
+
+ssize_t __wrap_coap_netif_dgrm_write(coap_session_t *session,
+                                     const uint8_t *data, size_t datalen) {
+    if (in_handshake(session)) {
+        REQTRACE("dtls_flight_tx", datalen, 0);
+    }
+    return __real_coap_netif_dgrm_write(session, data, datalen);
+}
+
+ssize_t __wrap_coap_netif_dgrm_read(coap_session_t *session,
+                                    coap_packet_t *packet) {
+    ssize_t bytes = __real_coap_netif_dgrm_read(session, packet);
+
+    if (bytes > 0 && in_handshake(session)) {
+        REQTRACE("dtls_flight_rx", bytes, 0);
+    }
+    return bytes;
+}
+
+int __wrap_coap_pdu_parse(coap_proto_t proto, const uint8_t *data,
+                          size_t length, coap_pdu_t *pdu) {
+    int ok = __real_coap_pdu_parse(proto, data, length, pdu);
+    coap_block_t block;
+
+    if (ok && COAP_RESPONSE_CLASS(coap_pdu_get_code(pdu)) >= 2 &&
+        coap_get_block(pdu, COAP_OPTION_BLOCK2, &block)) {
+        REQTRACE("block_rx", block.num, (block.m << 3) | block.szx);
+    }
+    return ok;
+}
+#endif /* CONFIG_APP_TRACING */
@@ -0,0 +1,271 @@
+/*
+ * wolfssl/src/soak.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Soak test: a long run of request cycles that fails on memory growth.
+ *
+ * Each cycle sends one GET and waits for its answer. Without
+ * SOAK_PERSISTENT every cycle also opens and releases its own session,
+ * so with DTLS each one is a full handshake and close; with it one
+ * session carries the whole run. A block-wise resource in the URI makes
+ * every cycle a block-wise transfer. The libcoap and TLS heaps
+ * (CONFIG_APP_HEAPS) and the libc heap are sampled at evenly spaced
+ * cycles, with the largest free block of each subsystem heap as the
+ * fragmentation measure. After the warm-up, bytes in use that never
+ * went down and grew beyond SOAK_LEAK_TOLERANCE are a leak, a largest
+ * free block that never went up and shrank as much is fragmentation,
+ * and either one fails the run.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "client.h"
+#include "heaps.h"
+#include "instr.h"
+#include "soak.h"
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+enum soak_series {
+    SERIES_COAP_USED,
+    SERIES_TLS_USED,
+    SERIES_LIBC_USED,
+    SERIES_COAP_LARGEST,
+    SERIES_TLS_LARGEST,
+    SERIES_COUNT,
+};
+
+static const char *const series_names[SERIES_COUNT] = {
+    [SERIES_COAP_USED] = "libcoap heap in use",
+    [SERIES_TLS_USED] = "TLS heap in use",
+    [SERIES_LIBC_USED] = "libc heap in use",
+    [SERIES_COAP_LARGEST] = "libcoap largest free block",
+    [SERIES_TLS_LARGEST] = "TLS largest free block",
+};
+
+/* One more for the sample taken once everything is released */
+static size_t samples[SOAK_SAMPLES + 1][SERIES_COUNT];
+static int sample_count;
+static int measured;
+
+static coap_session_t *session;
+static coap_optlist_t *optlist;
+static uint8_t token[8];
+static size_t token_len;
+static int outstanding;
+static int answered_ok;
+
+static uint32_t cycles;
+static uint32_t failed;
+static uint32_t timeouts;
+static uint32_t sessions_opened;
+static uint64_t cycle_sum_us;
+static uint32_t cycle_max_us;
+static uint32_t run_ms;
+static int leaks;
+
+int soak_handle_response(const coap_pdu_t *received) {
+    coap_bin_const_t tok = coap_pdu_get_token(received);
+
+    if (!outstanding || tok.length != token_len ||
+        memcmp(tok.s, token, token_len)) {
+        return 0;
+    }
+    outstanding = 0;
+    answered_ok = COAP_RESPONSE_CLASS(coap_pdu_get_code(received)) == 2;
+    return 1;
+}
+
+static unsigned fragmentation_pct(size_t size, size_t used, size_t largest) {
+    size_t free_bytes = size - used;
+
+    return free_bytes ? (unsigned)(100 - largest * 100 / free_bytes) : 0;
+}
+
+static void sample(uint32_t cycle) {
+    struct heaps_counters coap;
+    struct heaps_counters tls;
+    size_t *s = samples[sample_count];
+
+    heaps_get(HEAPS_COAP, &coap);
+    heaps_get(HEAPS_TLS, &tls);
+    s[SERIES_COAP_USED] = coap.current;
+    s[SERIES_TLS_USED] = tls.current;
+    s[SERIES_LIBC_USED] = instr_heap_used();
+    s[SERIES_COAP_LARGEST] = heaps_largest_free(HEAPS_COAP);
+    s[SERIES_TLS_LARGEST] = heaps_largest_free(HEAPS_TLS);
+    sample_count++;
+
+    LOG_INF("Soak %7u: libcoap %6u (largest free %6u, %2u%% fragmented), "
+            "TLS %6u (largest free %6u, %2u%% fragmented), libc %7u, "
+            "%u failed", (unsigned)cycle, (unsigned)s[SERIES_COAP_USED],
+            (unsigned)s[SERIES_COAP_LARGEST],
+            fragmentation_pct(coap.size, coap.current, s[SERIES_COAP_LARGEST]),
+            (unsigned)s[SERIES_TLS_USED], (unsigned)s[SERIES_TLS_LARGEST],
+            fragmentation_pct(tls.size, tls.current, s[SERIES_TLS_LARGEST]),
+            (unsigned)s[SERIES_LIBC_USED], (unsigned)failed);
+}
+
+static int send_request(void) {
+    coap_pdu_t *pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET,
+                                   session);
+
+    if (!pdu) {
+        return 0;
+    }
+    coap_session_new_token(session, &token_len, token);
+    coap_add_token(pdu, token_len, token);
+    if (optlist && coap_add_optlist_pdu(pdu, &optlist) != 1) {
+        coap_delete_pdu(pdu);
+        return 0;
+    }
+    return coap_send(session, pdu) != COAP_INVALID_MID;
+}
+
+/* One request and its answer, the handshake included when the session
+ * is new */
+static int cycle(coap_context_t *ctx, const coap_address_t *dst) {
+    uint32_t start = k_cycle_get_32();
+    int64_t deadline = k_uptime_get() + SOAK_TIMEOUT_MS;
+    uint32_t us;
+    int ok;
+
+    if (!session) {
+        session = open_session(ctx, dst);
+        if (!session) {
+            return 0;
+        }
+        sessions_opened++;
+    }
+    answered_ok = 0;
+    outstanding = send_request();
+    while (outstanding && k_uptime_get() < deadline) {
+        coap_io_process(ctx, 100);
+    }
+    if (outstanding) {
+        outstanding = 0;
+        timeouts++;
+    }
+    ok = answered_ok;
+
+    us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+    cycle_sum_us += us;
+    if (us > cycle_max_us) {
+        cycle_max_us = us;
+    }
+
+#ifndef SOAK_PERSISTENT
+    coap_session_release(session);
+    session = NULL;
+#else
+    /* A broken session is replaced, not reused */
+    if (!ok) {
+        coap_session_release(session);
+        session = NULL;
+    }
+#endif
+    return ok;
+}
+
+static int too_many_failures(void) {
+    return (uint64_t)failed * 100 > (uint64_t)cycles * SOAK_MAX_FAIL_PCT;
+}
+
+/* Growth that never reverses: a used series that never went down, or a
+ * largest free block that never went up, and moved beyond the tolerance */
+static int steady_growth(int series, int first, int shrinking) {
+    size_t from = samples[first][series];
+    size_t to = samples[measured - 1][series];
+
+    for (int i = first + 1; i < measured; i++) {
+        size_t prev = samples[i - 1][series];
+        size_t cur = samples[i][series];
+
+        if (shrinking ? cur > prev : cur < prev) {
+            return 0;
+        }
+    }
+    return shrinking ? from > to + SOAK_LEAK_TOLERANCE
+                     : to > from + SOAK_LEAK_TOLERANCE;
+}
+
+int soak_run(coap_context_t *ctx, const coap_address_t *dst,
+             const coap_uri_t *uri) {
+    uint32_t every = MAX(COAP_SOAK_CYCLES / SOAK_SAMPLES, 1);
+    uint8_t scratch[100];
+    int64_t start;
+
+    if (coap_uri_into_options(uri, dst, &optlist, 1, scratch,
+                              sizeof(scratch))) {
+        LOG_ERR("Cannot build soak request options");
+        return 0;
+    }
+
+    LOG_INF("Soak: %d cycles, %s session, heap sample every %u cycles",
+            COAP_SOAK_CYCLES,
+            IS_ENABLED(SOAK_PERSISTENT) ? "one persistent" : "a new",
+            (unsigned)every);
+
+    start = k_uptime_get();
+    for (cycles = 0; cycles < COAP_SOAK_CYCLES; cycles++) {
+        if (cycles % every == 0 && sample_count < SOAK_SAMPLES) {
+            sample(cycles);
+        }
+        if (!cycle(ctx, dst)) {
+            failed++;
+        }
+    }
+    run_ms = (uint32_t)(k_uptime_get() - start);
+    measured = sample_count;
+
+    if (session) {
+        coap_session_release(session);
+        session = NULL;
+    }
+    coap_delete_optlist(optlist);
+    optlist = NULL;
+    /* Once more with everything released, for the log only: a
+     * persistent session would otherwise show up as a drop */
+    sample(cycles);
+
+    for (int i = 0; i < SERIES_COUNT; i++) {
+        int first = measured * SOAK_WARMUP_PCT / 100;
+
+        if (measured - first >= 3 &&
+            steady_growth(i, first, i >= SERIES_COAP_LARGEST)) {
+            leaks |= 1 << i;
+        }
+    }
+
+    return !leaks && !too_many_failures();
+}
+
+void soak_report(void) {
+    const size_t *first = samples[measured * SOAK_WARMUP_PCT / 100];
+    const size_t *last = samples[measured ? measured - 1 : 0];
+
+    printf("\n=== SOAK ===\n");
+    printf("Cycles: %u in %u ms, %u failed (%u timeouts), %u sessions "
+           "opened\n", (unsigned)cycles, (unsigned)run_ms, (unsigned)failed,
+           (unsigned)timeouts, (unsigned)sessions_opened);
+    if (cycles) {
+        printf("Cycle time avg/max: %u/%u us\n",
+               (unsigned)(cycle_sum_us / cycles), (unsigned)cycle_max_us);
+    }
+    for (int i = 0; i < SERIES_COUNT; i++) {
+        printf("%-27s %7u -> %7u bytes%s\n", series_names[i],
+               (unsigned)first[i], (unsigned)last[i],
+               leaks & (1 << i) ? (i >= SERIES_COAP_LARGEST
+                                       ? "  FRAGMENTING"
+                                       : "  LEAKING")
+                                : "");
+    }
+    printf("Result: %s\n",
+           leaks ? "FAILED, steady memory growth"
+           : too_many_failures() ? "FAILED, too many failed cycles"
+                                 : "PASSED");
+    printf("=== END SOAK ===\n");
+}
@@ -0,0 +1,422 @@
+/*
+ * wolfssl/src/swarm.c
+ *
+ * Copyright (C) 2024-2025 Javier Blanco-Romero @fj-blanco (UC3M, QURSA project)
+ *
+ * Swarm mode: many independent clients in one native_sim process.
+ *
+ * Each client is a small state machine with its own session, so its own
+ * socket, (D)TLS state and token space, and its own request schedule.
+ * All of them share the libcoap context and the coap_io_process() loop,
+ * which is how a single gateway process would drive many devices. The
+ * ramp opens the sessions with a bounded number of handshakes in flight
+ * and gives the handshake rate. The steady phase then has every client
+ * send a GET per interval and gives the request rate. Memory is measured
+ * on the malloc() heap, where libcoap and the (D)TLS library allocate,
+ * and a client is refused once the swarm outgrows its per-client budget,
+ * so the run ends with a sessions per GB figure instead of an
+ * allocation failure.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "client.h"
+#include "hist.h"
+#include "instr.h"
+#include "swarm.h"
+#ifdef CONFIG_APP_METRICS
+#include "metrics.h"
+#endif
+
+LOG_MODULE_DECLARE(app, CONFIG_APP_LOG_LEVEL);
+
+enum swarm_state {
+    SWARM_IDLE,
+    SWARM_CONNECTING,
+    SWARM_READY,
+    SWARM_FAILED,
+};
+
+struct swarm_client {
+    coap_session_t *session;
+    enum swarm_state state;
+    int outstanding;
+    uint8_t token[8];
+    size_t token_len;
+    uint32_t start_cyc;     /* Handshake or request start */
+    int64_t deadline_ms;
+    int64_t next_ms;
+};
+
+static struct swarm_client clients[COAP_SWARM_CLIENTS];
+static coap_optlist_t *optlist;
+static int connecting;
+
+static int admitted;
+static int refused;
+static int connected;
+static int handshake_failed;
+static int handshake_timeouts;
+static int dropped;
+static uint32_t hs_min_us = UINT32_MAX;
+static uint32_t hs_max_us;
+static uint64_t hs_sum_us;
+static int64_t last_connected_ms;
+static uint32_t ramp_ms;
+
+static uint32_t sent;
+static uint32_t answered;
+static uint32_t errors;
+static uint32_t timeouts;
+static uint64_t rsp_sum_us;
+static uint32_t rsp_max_us;
+static uint32_t steady_ms;
+
+static size_t heap_base;
+static size_t heap_peak;
+static size_t heap_steady;
+static struct instr_sample ramp_start;
+static struct instr_sample ramp_end;
+static struct instr_sample steady_end;
+
+static void print_ms(const char *prefix, uint32_t us) {
+    printf("%s%u.%03u", prefix, (unsigned)(us / 1000), (unsigned)(us % 1000));
+}
+
+static void print_pct(const char *label, uint32_t permille) {
+    printf("%s%u.%u%%", label, (unsigned)(permille / 10),
+           (unsigned)(permille % 10));
+}
+
+static void sample_heap(void) {
+    size_t used = instr_heap_used();
+
+    if (used > heap_peak) {
+        heap_peak = used;
+    }
+}
+
+static void client_connected(struct swarm_client *c) {
+    uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - c->start_cyc);
+
+    c->state = SWARM_READY;
+    last_connected_ms = k_uptime_get();
+    connecting--;
+    connected++;
+    hs_sum_us += us;
+    if (us < hs_min_us) {
+        hs_min_us = us;
+    }
+    if (us > hs_max_us) {
+        hs_max_us = us;
+    }
+}
+
+static void client_failed(struct swarm_client *c) {
+    if (c->state == SWARM_CONNECTING) {
+        connecting--;
+        handshake_failed++;
+    } else if (c->state == SWARM_READY) {
+        dropped++;
+    }
+    c->state = SWARM_FAILED;
+    c->outstanding = 0;
+}
+
+static int event_handler(coap_session_t *session, const coap_event_t event) {
+    struct swarm_client *c = coap_session_get_app_data(session);
+
+    /* This handler replaces the client's own */
+    client_event(session, event);
+    if (!c) {
+        return 0;
+    }
+    switch (event) {
+    case COAP_EVENT_DTLS_CONNECTED:
+    case COAP_EVENT_SESSION_CONNECTED:
+        /* TLS reports both, the second one after the CSM exchange */
+        if (c->state == SWARM_CONNECTING) {
+            client_connected(c);
+        }
+        break;
+    case COAP_EVENT_DTLS_CLOSED:
+    case COAP_EVENT_DTLS_ERROR:
+    case COAP_EVENT_TCP_CLOSED:
+    case COAP_EVENT_TCP_FAILED:
+    case COAP_EVENT_SESSION_CLOSED:
+    case COAP_EVENT_SESSION_FAILED:
+        client_failed(c);
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+int swarm_handle_response(coap_session_t *session, const coap_pdu_t *received) {
+    struct swarm_client *c = coap_session_get_app_data(session);
+    coap_bin_const_t tok = coap_pdu_get_token(received);
+    uint32_t us;
+
+    if (!c) {
+        return 0;
+    }
+    /* Late answers to timed out requests are dropped here as well */
+    if (!c->outstanding || tok.length != c->token_len ||
+        memcmp(tok.s, c->token, c->token_len)) {
+        return 1;
+    }
+
+    us = k_cyc_to_us_floor32(k_cycle_get_32() - c->start_cyc);
+    c->outstanding = 0;
+    if (COAP_RESPONSE_CLASS(coap_pdu_get_code(received)) != 2) {
+        errors++;
+        return 1;
+    }
+    answered++;
+    rsp_sum_us += us;
+    if (us > rsp_max_us) {
+        rsp_max_us = us;
+    }
+    HIST_RECORD(HIST_RESPONSE, us);
+#ifdef CONFIG_APP_METRICS
+    metrics_poll();
+#endif
+    return 1;
+}
+
+/* Admit the next client while the swarm stays within the budget of the
+ * clients admitted so far */
+static int within_budget(void) {
+    size_t used = instr_heap_used();
+
+    if (!heap_base || !used) {
+        return 1;
+    }
+    return used - heap_base <= (size_t)admitted * SWARM_CLIENT_BUDGET;
+}
+
+static void open_client(coap_context_t *ctx, const coap_address_t *dst,
+                        struct swarm_client *c) {
+    admitted++;
+    c->start_cyc = k_cycle_get_32();
+    c->deadline_ms = k_uptime_get() + SWARM_CONNECT_TIMEOUT_MS;
+    c->session = open_session(ctx, dst);
+    if (!c->session) {
+        c->state = SWARM_FAILED;
+        handshake_failed++;
+        return;
+    }
+    c->state = SWARM_CONNECTING;
+    connecting++;
+    coap_session_set_app_data(c->session, c);
+
+    /* Plain UDP has nothing to negotiate */
+    if (coap_session_get_state(c->session) == COAP_SESSION_STATE_ESTABLISHED) {
+        client_connected(c);
+    }
+}
+
+static void ramp(coap_context_t *ctx, const coap_address_t *dst) {
+    int64_t start = k_uptime_get();
+    int next = 0;
+
+    while (next < COAP_SWARM_CLIENTS || connecting) {
+        int64_t now;
+
+        while (next < COAP_SWARM_CLIENTS &&
+               connecting < SWARM_CONCURRENT_HANDSHAKES) {
+            if (!within_budget()) {
+                refused = COAP_SWARM_CLIENTS - next;
+                next = COAP_SWARM_CLIENTS;
+                break;
+            }
+            open_client(ctx, dst, &clients[next++]);
+        }
+
+        coap_io_process(ctx, 10);
+        sample_heap();
+
+        now = k_uptime_get();
+        for (int i = 0; i < next; i++) {
+            struct swarm_client *c = &clients[i];
+
+            if (c->state == SWARM_CONNECTING && now >= c->deadline_ms) {
+                connecting--;
+                handshake_timeouts++;
+                c->state = SWARM_FAILED;
+            }
+        }
+    }
+    ramp_ms = connected ? (uint32_t)(last_connected_ms - start) : 0;
+}
+
+static void send_request(struct swarm_client *c, int64_t now) {
+    coap_pdu_t *pdu = coap_new_pdu(COAP_MESSAGE_CON, COAP_REQUEST_CODE_GET,
+                                   c->session);
+
+    sent++;
+    if (!pdu) {
+        errors++;
+        return;
+    }
+    coap_session_new_token(c->session, &c->token_len, c->token);
+    coap_add_token(pdu, c->token_len, c->token);
+    if (optlist && coap_add_optlist_pdu(pdu, &optlist) != 1) {
+        coap_delete_pdu(pdu);
+        errors++;
+        return;
+    }
+    c->start_cyc = k_cycle_get_32();
+    if (coap_send(c->session, pdu) == COAP_INVALID_MID) {
+        errors++;
+        return;
+    }
+    c->outstanding = 1;
+    c->deadline_ms = now + SWARM_TIMEOUT_MS;
+}
+
+static void steady(coap_context_t *ctx) {
+    int64_t start = k_uptime_get();
+    int64_t end = start + SWARM_DURATION_S * 1000LL;
+    int64_t now = start;
+
+    for (int i = 0; i < COAP_SWARM_CLIENTS; i++) {
+        clients[i].next_ms =
+            start + (int64_t)i * SWARM_INTERVAL_MS / COAP_SWARM_CLIENTS;
+    }
+
+    while (now < end) {
+        int64_t wake = now + 50;
+
+        for (int i = 0; i < COAP_SWARM_CLIENTS; i++) {
+            struct swarm_client *c = &clients[i];
+
+            if (c->state != SWARM_READY) {
+                continue;
+            }
+            if (c->outstanding && now >= c->deadline_ms) {
+                c->outstanding = 0;
+                timeouts++;
+            }
+            if (now >= c->next_ms) {
+                /* One request at a time per client, a slow one just
+                 * skips its turn */
+                if (!c->outstanding) {
+                    send_request(c, now);
+                }
+                c->next_ms += SWARM_INTERVAL_MS;
+            }
+            if (c->next_ms < wake) {
+                wake = c->next_ms;
+            }
+        }
+
+        coap_io_process(ctx, (uint32_t)CLAMP(wake - now, 1, 50));
+        sample_heap();
+        now = k_uptime_get();
+    }
+    steady_ms = (uint32_t)(now - start);
+}
+
+int swarm_run(coap_context_t *ctx, const coap_address_t *dst,
+              const coap_uri_t *uri) {
+    uint8_t scratch[100];
+
+    if (coap_uri_into_options(uri, dst, &optlist, 1, scratch,
+                              sizeof(scratch))) {
+        LOG_ERR("Cannot build swarm request options");
+        return 0;
+    }
+    coap_register_event_handler(ctx, event_handler);
+
+    LOG_INF("Swarm: %d clients, one GET every %d ms each for %d s, "
+            "budget %d bytes per client", COAP_SWARM_CLIENTS,
+            SWARM_INTERVAL_MS, SWARM_DURATION_S, SWARM_CLIENT_BUDGET);
+
+    heap_base = instr_heap_used();
+    heap_peak = heap_base;
+
+    instr_sample(&ramp_start);
+    ramp(ctx, dst);
+    instr_sample(&ramp_end);
+    LOG_INF("Ramp done: %d of %d clients connected in %u ms", connected,
+            COAP_SWARM_CLIENTS, (unsigned)ramp_ms);
+
+    if (connected) {
+        steady(ctx);
+    }
+    instr_sample(&steady_end);
+    heap_steady = instr_heap_used();
+
+    for (int i = 0; i < COAP_SWARM_CLIENTS; i++) {
+        if (clients[i].session) {
+            /* No more events for a client that is going away */
+            coap_session_set_app_data(clients[i].session, NULL);
+            coap_session_release(clients[i].session);
+            clients[i].session = NULL;
+        }
+    }
+    coap_delete_optlist(optlist);
+    optlist = NULL;
+    return connected;
+}
+
+void swarm_report(void) {
+    printf("\n=== SWARM ===\n");
+    printf("Clients: %d requested, %d admitted, %d refused by the budget\n",
+           COAP_SWARM_CLIENTS, admitted, refused);
+    printf("Handshakes: %d ok, %d failed, %d timed out in %u ms", connected,
+           handshake_failed, handshake_timeouts, (unsigned)ramp_ms);
+    if (ramp_ms) {
+        printf(", %u/s", (unsigned)((uint64_t)connected * 1000 / ramp_ms));
+    }
+    printf("\n");
+    if (connected) {
+        print_ms("Handshake time min/avg/max: ", hs_min_us);
+        print_ms("/", (uint32_t)(hs_sum_us / connected));
+        print_ms("/", hs_max_us);
+        printf(" ms\n");
+    }
+
+    printf("Requests: %u sent, %u answered, %u errors, %u timeouts, "
+           "%d sessions dropped\n", (unsigned)sent, (unsigned)answered,
+           (unsigned)errors, (unsigned)timeouts, dropped);
+    if (steady_ms) {
+        printf("Request rate: %u/s", (unsigned)((uint64_t)answered * 1000 /
+                                                steady_ms));
+        if (answered) {
+            print_ms(", response time avg/max: ",
+                     (uint32_t)(rsp_sum_us / answered));
+            print_ms("/", rsp_max_us);
+            printf(" ms");
+        }
+        printf("\n");
+    }
+
+    /* Session memory as measured at the end of the steady phase, the peak
+     * includes the handshake buffers of the ramp */
+    if (heap_base && admitted) {
+        size_t per_session = (heap_steady - heap_base) / admitted;
+        size_t peak_per_session = (heap_peak - heap_base) / admitted;
+
+        printf("Heap: %u bytes per session, %u at peak (budget %d)\n",
+               (unsigned)per_session, (unsigned)peak_per_session,
+               SWARM_CLIENT_BUDGET);
+        if (per_session) {
+            printf("Sessions per GB: %u\n",
+                   (unsigned)((1ULL << 30) / per_session));
+        }
+    } else {
+        printf("Heap: no statistics (overlay-stats.conf)\n");
+    }
+
+    if (ramp_end.cpu_total > ramp_start.cpu_total) {
+        print_pct("CPU busy: ", instr_cpu_busy(&ramp_start, &ramp_end));
+        print_pct(" ramp, ", instr_cpu_busy(&ramp_end, &steady_end));
+        printf(" steady\n");
+    }
+    printf("=== END SWARM ===\n");
+}
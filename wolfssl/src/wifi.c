@@ -6,14 +6,18 @@
  * Wi-Fi management for CoAP client
  */
 
-#include <stdio.h>
+#include <zephyr/logging/log.h>
 #include <zephyr/net/net_event.h>
 #include <zephyr/net/net_if.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/net/wifi_mgmt.h>
 #include <zephyr/net/wifi_utils.h>
+#include "hist.h"
+#include "reqtrace.h"
 #include "wifi.h"
 
+LOG_MODULE_REGISTER(app_wifi, CONFIG_APP_WIFI_LOG_LEVEL);
+
 #ifndef WIFI_SSID
 #define WIFI_SSID "WIFI_SSID_NOT_SET"
 #endif
@@ -49,7 +53,16 @@ static union {
 
 static uint32_t scan_result;
 static bool wifi_connected = false;
+/* Association time, what /metrics reports as radio time */
+static int64_t assoc_since;
+static uint32_t assoc_ms;
+/* Start of the connect request and of the wait for an address, for the
+ * histograms; in ticks, since either can take longer than the cycle
+ * counter covers */
+static int64_t connect_ticks;
+static int64_t dhcp_ticks;
 static struct net_mgmt_event_callback wifi_event_cb;
+static struct net_mgmt_event_callback ipv4_event_cb;
 
 static void handle_wifi_scan_result(struct net_mgmt_event_callback *cb) {
     const struct wifi_scan_result *entry =
@@ -58,23 +71,23 @@ static void handle_wifi_scan_result(struct net_mgmt_event_callback *cb) {
     scan_result++;
 
     if (scan_result == 1) {
-        printf("\n%-4s | %-32s %-5s | %-4s | %-4s | %-5s\n", "Num", "SSID",
-               "(len)", "Chan", "RSSI", "Sec");
+        LOG_INF("%-4s | %-32s %-5s | %-4s | %-4s | %-5s", "Num", "SSID",
+                "(len)", "Chan", "RSSI", "Sec");
     }
 
-    printf("%-4d | %-32s %-5u | %-4u | %-4d | %-5s\n", scan_result, entry->ssid,
-           entry->ssid_length, entry->channel, entry->rssi,
-           (entry->security == WIFI_SECURITY_TYPE_PSK ? "WPA/WPA2" : "Open"));
+    LOG_INF("%-4d | %-32s %-5u | %-4u | %-4d | %-5s", scan_result, entry->ssid,
+            entry->ssid_length, entry->channel, entry->rssi,
+            (entry->security == WIFI_SECURITY_TYPE_PSK ? "WPA/WPA2" : "Open"));
 }
 
 static void handle_wifi_scan_done(struct net_mgmt_event_callback *cb) {
     const struct wifi_status *status = (const struct wifi_status *)cb->info;
 
     if (status->status) {
-        printf("\nWi-Fi scan request failed (%d)\n", status->status);
+        LOG_ERR("Wi-Fi scan request failed (%d)", status->status);
     } else {
-        printf("----------\n");
-        printf("Wi-Fi scan request done\n");
+        LOG_INF("----------");
+        LOG_INF("Wi-Fi scan request done");
     }
 
     scan_result = 0;
@@ -83,11 +96,19 @@ static void handle_wifi_scan_done(struct net_mgmt_event_callback *cb) {
 static void handle_wifi_connect_result(struct net_mgmt_event_callback *cb) {
     const struct wifi_status *status = (const struct wifi_status *)cb->info;
 
+    REQTRACE("wifi_connect", status->status, 0);
     if (status->status) {
-        printf("\nWi-Fi connection request failed (%d)\n", status->status);
+        LOG_ERR("Wi-Fi connection request failed (%d)", status->status);
     } else {
-        printf("\nWi-Fi connected\n");
+        LOG_INF("Wi-Fi connected");
         wifi_connected = true;
+        assoc_since = k_uptime_get();
+        dhcp_ticks = k_uptime_ticks();
+        if (connect_ticks) {
+            HIST_RECORD(HIST_WIFI_CONNECT,
+                        k_ticks_to_us_floor32(dhcp_ticks - connect_ticks));
+            connect_ticks = 0;
+        }
     }
 
     context.connecting = false;
@@ -96,12 +117,17 @@ static void handle_wifi_connect_result(struct net_mgmt_event_callback *cb) {
 static void handle_wifi_disconnect_result(struct net_mgmt_event_callback *cb) {
     const struct wifi_status *status = (const struct wifi_status *)cb->info;
 
+    REQTRACE("wifi_disconnect", status->status, context.disconnecting);
+    if (assoc_since) {
+        assoc_ms += (uint32_t)(k_uptime_get() - assoc_since);
+        assoc_since = 0;
+    }
     if (context.disconnecting) {
-        printf("\nWi-Fi disconnection request %s (%d)\n",
-               status->status ? "failed" : "done", status->status);
+        LOG_INF("Wi-Fi disconnection request %s (%d)",
+                status->status ? "failed" : "done", status->status);
         context.disconnecting = false;
     } else {
-        printf("\nWi-Fi Disconnected\n");
+        LOG_WRN("Wi-Fi Disconnected");
     }
 }
 
@@ -125,6 +151,27 @@ void wifi_mgmt_event_handler(struct net_mgmt_event_callback *cb,
     }
 }
 
+/* The address from DHCP (or a static one) is in place */
+static void ipv4_event_handler(struct net_mgmt_event_callback *cb,
+                               uint64_t mgmt_event, struct net_if *iface) {
+    const struct in_addr *addr = cb->info;
+    char buf[NET_IPV4_ADDR_LEN];
+
+    ARG_UNUSED(iface);
+
+    if (mgmt_event != NET_EVENT_IPV4_ADDR_ADD || !addr) {
+        return;
+    }
+    REQTRACE("ip_acquired", ntohl(addr->s_addr), 0);
+    if (dhcp_ticks) {
+        HIST_RECORD(HIST_DHCP,
+                    k_ticks_to_us_floor32(k_uptime_ticks() - dhcp_ticks));
+        dhcp_ticks = 0;
+    }
+    LOG_INF("IPv4 address acquired: %s",
+            net_addr_ntop(AF_INET, addr, buf, sizeof(buf)));
+}
+
 int wifi_init(struct device *unused) {
     ARG_UNUSED(unused);
 
@@ -134,9 +181,13 @@ int wifi_init(struct device *unused) {
     net_mgmt_init_event_callback(&wifi_event_cb, wifi_mgmt_event_handler,
                                  WIFI_SHELL_MGMT_EVENTS);
 
-    printf("Wi-Fi event callback initialized......\n");
+    LOG_INF("Wi-Fi event callback initialized......");
     net_mgmt_add_event_callback(&wifi_event_cb);
 
+    net_mgmt_init_event_callback(&ipv4_event_cb, ipv4_event_handler,
+                                 NET_EVENT_IPV4_ADDR_ADD);
+    net_mgmt_add_event_callback(&ipv4_event_cb);
+
     return 0;
 }
 
@@ -144,9 +195,9 @@ int shell_cmd_scan() {
     struct net_if *iface = net_if_get_default();
 
     if (net_mgmt(NET_REQUEST_WIFI_SCAN, iface, NULL, 0)) {
-        printf("Wi-Fi scan request failed\n");
+        LOG_ERR("Wi-Fi scan request failed");
     } else {
-        printf("Wi-Fi scan requested\n");
+        LOG_INF("Wi-Fi scan requested");
     }
 
     return 0;
@@ -161,13 +212,13 @@ int wait_for_wifi_connection(void) {
         timeout_count++;
 
         if (timeout_count >= max_timeout_count) {
-            printf("Wi-Fi connection timeout after %d ms\n",
-                   WIFI_CONNECTION_TIMEOUT_MS);
+            LOG_ERR("Wi-Fi connection timeout after %d ms",
+                    WIFI_CONNECTION_TIMEOUT_MS);
             return -ETIMEDOUT;
         }
     }
 
-    printf("Wi-Fi connected successfully\n");
+    LOG_INF("Wi-Fi connected successfully");
     return 0;
 }
 
@@ -175,30 +226,37 @@ void wifi_disconnect(void) {
     struct net_if *iface = net_if_get_default();
 
     if (net_mgmt(NET_REQUEST_WIFI_DISCONNECT, iface, NULL, 0)) {
-        printf("Wi-Fi Disconnection Request Failed\n");
+        LOG_ERR("Wi-Fi Disconnection Request Failed");
     } else {
-        printf("Wi-Fi Disconnection Requested\n");
+        LOG_INF("Wi-Fi Disconnection Requested");
     }
 }
 
+uint32_t wifi_radio_ms(void) {
+    int64_t since = assoc_since;
+
+    return assoc_ms + (since ? (uint32_t)(k_uptime_get() - since) : 0);
+}
+
 int connect_to_wifi() {
-    printf("Connecting to Wi-Fi network......\n");
+    LOG_INF("Connecting to Wi-Fi network......");
     int ret;
 
     struct net_if *iface = net_if_get_default();
 
     if (!iface) {
-        printf("Failed to get Wi-Fi device\n");
+        LOG_ERR("Failed to get Wi-Fi device");
         return -ENODEV;
     }
+    connect_ticks = k_uptime_ticks();
     ret = net_mgmt(NET_REQUEST_WIFI_CONNECT, iface, &wifi_params,
                    sizeof(struct wifi_connect_req_params));
 
     if (ret < 0) {
-        printf("Failed to connect to Wi-Fi network: %d\n", ret);
+        LOG_ERR("Failed to connect to Wi-Fi network: %d", ret);
         return ret;
     }
 
-    printf("Wi-Fi connection requested\n");
+    LOG_INF("Wi-Fi connection requested");
     return ret;
 }
\ No newline at end of file